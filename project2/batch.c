@@ -0,0 +1,590 @@
+/** implementation file for the batch component.  The main thread reads
+    puzzles into a fixed window of jobs, and worker threads take them in
+    order and print each answer into a buffer of its own.  Whichever
+    thread finishes the oldest job writes out every finished job from the
+    front of the window, so the answers come out in the order the puzzles
+    came in.  Each worker solves on its own stack, with no state shared
+    with the others, and the time each puzzle took is kept for the
+    latency report.
+    @file batch.c
+    @author Vivekanand Ganapathy Nagarajan
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "batch.h"
+#include "validate.h"
+#include "dlx.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/** Number of puzzles allowed in flight for each worker thread. */
+#define PUZZLES_PER_THREAD 64
+
+/** Longest word read from the input, a one-line puzzle of the largest
+    size fits. */
+#define WORD_FORMAT "%1023s"
+#define WORD_SIZE 1024
+
+/** Most digits in the size before a grid, longer words are one-line
+    puzzles. */
+#define SIZE_DIGITS 2
+
+/** Ways a puzzle read from the input can be wrong. */
+#define PUZZLE_OK 0
+#define PUZZLE_INVALID_SIZE 1
+#define PUZZLE_INVALID_INPUT 2
+
+/** Percentiles of the latencies reported. */
+#define MEDIAN 50
+#define TAIL 99
+
+/** Nanoseconds in a second, and in a microsecond. */
+#define NANOS_PER_SECOND 1e9
+#define NANOS_PER_MICRO 1e3
+
+/** Initial capacity of the growable arrays. */
+#define INIT_CAPACITY 1024
+
+/** Growth factor for the growable arrays. */
+#define MULTIPLY_FACTOR 2
+
+/** A puzzle read from the input. */
+typedef struct {
+  /** The size of the grid. */
+  int size;
+  /** True if it was written on one line. */
+  bool oneLine;
+  /** PUZZLE_OK, or what was wrong with it. */
+  int error;
+  /** The value in every cell, row by row. */
+  unsigned char cells[SIZE_HIGH * SIZE_HIGH];
+} Puzzle;
+
+/** A puzzle to solve on one of the threads. */
+typedef struct {
+  /** Room for the puzzle, when it's read as it's queued. */
+  Puzzle own;
+  /** The puzzle to solve. */
+  Puzzle const *puzzle;
+  /** The answer printed for the puzzle. */
+  char *output;
+  /** Size of output. */
+  size_t outputSize;
+  /** Nanoseconds it took to solve. */
+  double nanos;
+  /** True once the puzzle has been solved. */
+  bool done;
+} Job;
+
+/** State shared by the main thread and the workers. */
+typedef struct {
+  /** True to solve with dancing links. */
+  bool useDlx;
+  /** Stream the answers are written to, or NULL to drop them. */
+  FILE *out;
+  /** Lock for everything below. */
+  pthread_mutex_t lock;
+  /** Signaled when a job is queued, or when no more are coming. */
+  pthread_cond_t ready;
+  /** Signaled when jobs leave the window, once it's down to half full. */
+  pthread_cond_t room;
+  /** Jobs in flight, job number seq is at window[ seq % windowSize ]. */
+  Job *window;
+  int windowSize;
+  /** Number of jobs queued, taken by a worker and written out so far. */
+  long queued;
+  long taken;
+  long written;
+  /** True once the main thread has queued every job. */
+  bool finished;
+  /** Nanoseconds every puzzle written out took, in order. */
+  double *latencies;
+  long latencyCapacity;
+} Pool;
+
+/** Check if a puzzle can have the given size.
+  * @param size The size to check.
+  * @return true, if a puzzle can have that size.
+*/
+bool validSize(int size)
+{
+  int n = 1;
+  while (n * n < size){
+    n++;
+  }
+  return size >= SIZE_LOW && size <= SIZE_HIGH && n * n == size;
+}
+
+/** Get the value of a cell of a one-line puzzle.
+  * @param ch The character for the cell.
+  * @return the value, 0 for a blank, or -1 if it isn't a digit.
+*/
+static int cellValue(char ch)
+{
+  if (ch == '.'){
+    return 0;
+  }
+  if (ch >= '0' && ch <= '9'){
+    return ch - '0';
+  }
+  if (ch >= 'A' && ch <= 'Z'){
+    return ch - 'A' + 10;
+  }
+  if (ch >= 'a' && ch <= 'z'){
+    return ch - 'a' + 10;
+  }
+  return -1;
+}
+
+/** Get the character for a value in a one-line puzzle.
+  * @param value The value, from 1 to size.
+  * @return the character.
+*/
+static char cellChar(int value)
+{
+  return value < 10 ? '0' + value : 'A' + value - 10;
+}
+
+/**  Print the grid values in case the grid can be solved.
+    @param out The stream to print to.
+    @param size The size of the grid.
+    @param grid The puzzle represented as a grid.
+*/
+static void printGrid(FILE *out, int size, int grid[][size])
+{
+  for (int row=0; row<size; row++){
+    fprintf(out, " ");
+    for (int col=0; col<size; col++){
+      if (col == size-1){
+        fprintf(out, "%2d", grid[row][col]);
+      } else{
+        fprintf(out, "%2d ", grid[row][col]);
+      }
+    }
+    fprintf(out, "\n");
+  }
+}
+
+/** Check a puzzle and print the answer.
+  * @param n The square root of size of the grid.
+  * @param size The size of the grid.
+  * @param grid The puzzle represented as a grid, solved in place.
+  * @param oneLine true to print the solution on one line.
+  * @param useDlx true to solve with dancing links.
+  * @param threads The number of threads for the bitmask search, or 0.
+  * @param out The stream to print the answer to.
+  * @param stats The counters, set to the solver's work.
+*/
+void answerPuzzle(int n, int size, int grid[size][size], bool oneLine, bool useDlx,
+                  int threads, FILE *out, SolveStats *stats)
+{
+  stats->nodes = 0;
+  stats->backtracks = 0;
+  bool isSpacePuzzle = false;
+  for (int row=0; row<size; row++){
+    for (int col=0; col<size; col++){
+      if (grid[row][col] == 0){
+        isSpacePuzzle = true;
+      }
+    }
+  }
+  //check if puzzle has no spaces, so puzzle is complete and validate if it is valid
+  if (!isSpacePuzzle){
+    bool success = validateRows(size, grid) && validateCols(size, grid)
+                   && validateSquares(n, size, grid);
+    fprintf(out, success ? "Valid\n" : "Invalid\n");
+    return;
+  }
+  //puzzle has blankspaces
+  bool success = validateRowsWithSpaces(size, grid) && validateColsWithSpaces(size, grid)
+                 && validateSquaresWithSpaces(n, size, grid);
+  if (success){
+    if (useDlx){
+      success = dlxSolve(n, size, grid, 1, stats) > 0;
+    } else if (threads > 0){
+      success = solveParallel(n, size, grid, threads, false, stats) > 0;
+    } else{
+      success = solveWithStats(n, size, grid, stats);
+    }
+  }
+  if (!success){
+    fprintf(out, "Invalid\n");
+  } else if (oneLine){
+    for (int row=0; row<size; row++){
+      for (int col=0; col<size; col++){
+        fputc(cellChar(grid[row][col]), out);
+      }
+    }
+    fputc('\n', out);
+  } else{
+    printGrid(out, size, grid);
+  }
+}
+
+/** Read the next puzzle from a stream.
+  * @param in The stream to read from.
+  * @param puzzle Filled in with the puzzle.
+  * @return false at the end of the input.
+*/
+static bool readPuzzle(FILE *in, Puzzle *puzzle)
+{
+  char word[WORD_SIZE];
+  if (fscanf(in, WORD_FORMAT, word) != 1){
+    return false;
+  }
+  puzzle->error = PUZZLE_OK;
+  int len = strlen(word);
+  if (len > SIZE_DIGITS){
+    // a one-line puzzle, a character for every cell
+    puzzle->oneLine = true;
+    int size = 1;
+    while (size * size < len){
+      size++;
+    }
+    puzzle->size = size;
+    if (size * size != len || !validSize(size)){
+      puzzle->error = PUZZLE_INVALID_SIZE;
+      return true;
+    }
+    for (int i=0; i<len; i++){
+      int value = cellValue(word[i]);
+      if (value < 0 || value > size){
+        puzzle->error = PUZZLE_INVALID_INPUT;
+        return true;
+      }
+      puzzle->cells[i] = value;
+    }
+    return true;
+  }
+
+  // the size, and then the grid of numbers
+  puzzle->oneLine = false;
+  char *end;
+  puzzle->size = strtol(word, &end, 10);
+  if (*end){
+    puzzle->error = PUZZLE_INVALID_INPUT;
+    return true;
+  }
+  if (!validSize(puzzle->size)){
+    puzzle->error = PUZZLE_INVALID_SIZE;
+    return true;
+  }
+  for (int i=0; i<puzzle->size*puzzle->size; i++){
+    int value;
+    if (fscanf(in, "%d", &value) != 1 || value < 0 || value > puzzle->size){
+      puzzle->error = PUZZLE_INVALID_INPUT;
+      return true;
+    }
+    puzzle->cells[i] = value;
+  }
+  return true;
+}
+
+/** Check if reading can go on after a puzzle.  A grid that's cut short or
+  * has the wrong size leaves no way to tell where the next one starts.
+  * @param puzzle The puzzle read last.
+  * @return true, if the next puzzle can be read.
+*/
+static bool canReadOn(Puzzle const *puzzle)
+{
+  return puzzle->oneLine || puzzle->error == PUZZLE_OK;
+}
+
+/** Solve the puzzle of a job, printing the answer into the job's buffer.
+  * @param useDlx true to solve with dancing links.
+  * @param job The job to run.
+*/
+static void runJob(bool useDlx, Job *job)
+{
+  Puzzle const *puzzle = job->puzzle;
+  FILE *out = open_memstream(&job->output, &job->outputSize);
+  struct timespec start, end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  if (puzzle->error == PUZZLE_INVALID_SIZE){
+    fprintf(out, "Invalid size\n");
+  } else if (puzzle->error == PUZZLE_INVALID_INPUT){
+    fprintf(out, "Invalid input\n");
+  } else{
+    int size = puzzle->size;
+    int n = 1;
+    while (n * n < size){
+      n++;
+    }
+    int grid[size][size];
+    for (int i=0; i<size*size; i++){
+      grid[i / size][i % size] = puzzle->cells[i];
+    }
+    SolveStats stats;
+    // the pool already keeps every core busy, one puzzle to a thread
+    answerPuzzle(n, size, grid, puzzle->oneLine, useDlx, 0, out, &stats);
+  }
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  job->nanos = (end.tv_sec - start.tv_sec) * NANOS_PER_SECOND
+               + (end.tv_nsec - start.tv_nsec);
+  fclose(out);
+}
+
+/** Write out finished jobs from the front of the window, in order.  The
+  * pool must be locked.
+  * @param pool The pool to write from.
+*/
+static void writeFinishedJobs(Pool *pool)
+{
+  while (pool->written < pool->taken){
+    Job *job = pool->window + pool->written % pool->windowSize;
+    if (!job->done){
+      break;
+    }
+    if (pool->out){
+      fwrite(job->output, 1, job->outputSize, pool->out);
+    }
+    free(job->output);
+    if (pool->written >= pool->latencyCapacity){
+      pool->latencyCapacity *= MULTIPLY_FACTOR;
+      pool->latencies = (double *) realloc(pool->latencies,
+                                           pool->latencyCapacity * sizeof(double));
+    }
+    pool->latencies[pool->written++] = job->nanos;
+    if (pool->queued - pool->written <= pool->windowSize / 2){
+      pthread_cond_broadcast(&pool->room);
+    }
+  }
+}
+
+/** Body of a worker thread, taking jobs in order until there are none left.
+  * @param arg The pool.
+  * @return NULL
+*/
+static void *worker(void *arg)
+{
+  Pool *pool = (Pool *) arg;
+  pthread_mutex_lock(&pool->lock);
+  while (true){
+    while (pool->taken == pool->queued && !pool->finished){
+      pthread_cond_wait(&pool->ready, &pool->lock);
+    }
+    if (pool->taken == pool->queued){
+      break;
+    }
+    Job *job = pool->window + pool->taken++ % pool->windowSize;
+    pthread_mutex_unlock(&pool->lock);
+
+    runJob(pool->useDlx, job);
+
+    pthread_mutex_lock(&pool->lock);
+    job->done = true;
+    writeFinishedJobs(pool);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+/** Get the next free job in the window, waiting for room if it's full.
+  * @param pool The pool to queue in.
+  * @return the job, to fill in and pass to queueJob().
+*/
+static Job *nextJob(Pool *pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  while (pool->queued - pool->written >= pool->windowSize){
+    pthread_cond_wait(&pool->room, &pool->lock);
+  }
+  Job *job = pool->window + pool->queued % pool->windowSize;
+  pthread_mutex_unlock(&pool->lock);
+  return job;
+}
+
+/** Queue the job got from nextJob().
+  * @param pool The pool to queue in.
+  * @param job The job, with its puzzle filled in.
+*/
+static void queueJob(Pool *pool, Job *job)
+{
+  job->output = NULL;
+  job->outputSize = 0;
+  job->done = false;
+  pthread_mutex_lock(&pool->lock);
+  pool->queued++;
+  pthread_cond_signal(&pool->ready);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/** Get the number of threads to use.
+  * @param threads The number asked for, or 0 for one per core.
+  * @return the number of threads.
+*/
+static int threadCount(int threads)
+{
+  if (threads <= 0){
+    threads = sysconf(_SC_NPROCESSORS_ONLN);
+  }
+  return threads < 1 ? 1 : threads;
+}
+
+/** Solve puzzles on a pool of threads, either read from a stream as they
+  * go or already in memory.
+  * @param pool The pool, with its engine and output set.
+  * @param threads The number of worker threads.
+  * @param in The stream to read puzzles from, or NULL.
+  * @param puzzles The puzzles to solve, if there's no stream.
+  * @param count The number of puzzles.
+  * @return true, if every puzzle could be read.
+*/
+static bool runPool(Pool *pool, int threads, FILE *in, Puzzle const *puzzles, long count)
+{
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->ready, NULL);
+  pthread_cond_init(&pool->room, NULL);
+  pool->windowSize = threads * PUZZLES_PER_THREAD;
+  pool->window = (Job *) malloc(pool->windowSize * sizeof(Job));
+  pool->queued = pool->taken = pool->written = 0;
+  pool->finished = false;
+  pool->latencyCapacity = INIT_CAPACITY;
+  pool->latencies = (double *) malloc(pool->latencyCapacity * sizeof(double));
+
+  pthread_t workers[threads];
+  for (int i=0; i<threads; i++){
+    pthread_create(workers + i, NULL, worker, pool);
+  }
+  bool readAll = true;
+  for (long i=0; in || i<count; i++){
+    Job *job = nextJob(pool);
+    if (in){
+      if (!readPuzzle(in, &job->own)){
+        break;
+      }
+      job->puzzle = &job->own;
+    } else{
+      job->puzzle = puzzles + i;
+    }
+    queueJob(pool, job);
+    if (!canReadOn(job->puzzle)){
+      readAll = false;
+      break;
+    }
+  }
+
+  pthread_mutex_lock(&pool->lock);
+  pool->finished = true;
+  pthread_cond_broadcast(&pool->ready);
+  pthread_mutex_unlock(&pool->lock);
+  for (int i=0; i<threads; i++){
+    pthread_join(workers[i], NULL);
+  }
+  free(pool->window);
+  pthread_cond_destroy(&pool->room);
+  pthread_cond_destroy(&pool->ready);
+  pthread_mutex_destroy(&pool->lock);
+  return readAll;
+}
+
+// Comparison function for sorting latencies.
+static int compareLatencies(void const *a, void const *b)
+{
+  double x = *(double const *) a;
+  double y = *(double const *) b;
+  return x < y ? -1 : x > y;
+}
+
+/** Get the seconds since an earlier time.
+  * @param start The earlier time.
+  * @return the seconds since then.
+*/
+static double secondsSince(struct timespec const *start)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec - start->tv_sec + (now.tv_nsec - start->tv_nsec) / NANOS_PER_SECOND;
+}
+
+/** Get a percentile of the latencies of the puzzles solved by a pool.
+  * @param pool The pool, its latencies sorted.
+  * @param percent The percentile.
+  * @return the latency in microseconds.
+*/
+static double percentile(Pool const *pool, int percent)
+{
+  if (pool->written == 0){
+    return 0;
+  }
+  return pool->latencies[(pool->written - 1) * percent / 100] / NANOS_PER_MICRO;
+}
+
+/** Solve every puzzle in a stream on a pool of threads.
+  * @param in The stream to read puzzles from.
+  * @param threads The number of worker threads, or 0 for one per core.
+  * @param useDlx true to solve with dancing links.
+  * @return true, if every puzzle could be read.
+*/
+bool solveBatch(FILE *in, int threads, bool useDlx)
+{
+  threads = threadCount(threads);
+  Pool pool;
+  pool.useDlx = useDlx;
+  pool.out = stdout;
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  bool readAll = runPool(&pool, threads, in, NULL, 0);
+  double seconds = secondsSince(&start);
+
+  qsort(pool.latencies, pool.written, sizeof(double), compareLatencies);
+  fprintf(stderr, "puzzles: %ld\n", pool.written);
+  fprintf(stderr, "threads: %d\n", threads);
+  fprintf(stderr, "seconds: %.3f\n", seconds);
+  fprintf(stderr, "puzzles/sec: %.0f\n", seconds > 0 ? pool.written / seconds : 0);
+  fprintf(stderr, "p%d latency: %.1f us\n", MEDIAN, percentile(&pool, MEDIAN));
+  fprintf(stderr, "p%d latency: %.1f us\n", TAIL, percentile(&pool, TAIL));
+  free(pool.latencies);
+  return readAll;
+}
+
+/** Read every puzzle in a stream and time solving them all on more and
+  * more threads.
+  * @param in The stream to read puzzles from.
+  * @param threads The most worker threads to use, or 0 for one per core.
+  * @param useDlx true to solve with dancing links.
+  * @return true, if every puzzle could be read.
+*/
+bool measureScaling(FILE *in, int threads, bool useDlx)
+{
+  threads = threadCount(threads);
+  long count = 0;
+  long capacity = INIT_CAPACITY;
+  Puzzle *puzzles = (Puzzle *) malloc(capacity * sizeof(Puzzle));
+  bool readAll = true;
+  while (readAll && readPuzzle(in, puzzles + count)){
+    readAll = canReadOn(puzzles + count++);
+    if (count == capacity){
+      capacity *= MULTIPLY_FACTOR;
+      puzzles = (Puzzle *) realloc(puzzles, capacity * sizeof(Puzzle));
+    }
+  }
+
+  double baseline = 0;
+  for (int t=1; t<=threads; t=(t == threads || t * 2 < threads) ? t * 2 : threads){
+    Pool pool;
+    pool.useDlx = useDlx;
+    pool.out = NULL;
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    runPool(&pool, t, NULL, puzzles, count);
+    double seconds = secondsSince(&start);
+    double rate = seconds > 0 ? count / seconds : 0;
+    if (t == 1){
+      baseline = rate;
+    }
+    qsort(pool.latencies, pool.written, sizeof(double), compareLatencies);
+    fprintf(stderr, "threads: %d puzzles/sec: %.0f p%d: %.1f us p%d: %.1f us speedup: %.2f\n",
+            t, rate, MEDIAN, percentile(&pool, MEDIAN), TAIL, percentile(&pool, TAIL),
+            baseline > 0 ? rate / baseline : 0);
+    free(pool.latencies);
+  }
+  free(puzzles);
+  return readAll;
+}
@@ -0,0 +1,65 @@
+/** header file for the batch component, which checks and solves puzzles
+    and prints the answers, either one puzzle at a time or a whole stream
+    of them on a pool of worker threads.
+    @file batch.h
+    @author Vivekanand Ganapathy Nagarajan
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "solve.h"
+
+/** Constants for lower and upper size limit**/
+#define SIZE_LOW 4
+#define SIZE_HIGH 25
+
+/** Check if a puzzle can have the given size, a perfect square within
+  * the limits.
+  * @param size The size to check.
+  * @return true, if a puzzle can have that size.
+*/
+bool validSize(int size);
+
+/** Check a puzzle and print the answer, Valid or Invalid for a complete
+  * grid, and the solution or Invalid for one with blank spaces.
+  * @param n The square root of size of the grid.
+  * @param size The size of the grid.
+  * @param grid The puzzle represented as a grid, solved in place.
+  * @param oneLine true to print the solution on one line, a character for
+  *        every cell, rather than as a grid.
+  * @param useDlx true to solve with dancing links, false for the bitmask
+  *        search.
+  * @param threads The number of threads for the bitmask search, or 0 to
+  *        search on the calling thread.
+  * @param out The stream to print the answer to.
+  * @param stats The counters, set to the solver's work.
+*/
+void answerPuzzle(int n, int size, int grid[size][size], bool oneLine, bool useDlx,
+                  int threads, FILE *out, SolveStats *stats);
+
+/** Solve every puzzle in a stream on a pool of threads, printing the
+  * answers in input order to standard output, and the throughput and
+  * latency to standard error.  A puzzle is either the usual size and
+  * grid of numbers, or a single word with a character for every cell,
+  * '.' or '0' for a blank and letters for the digits past 9.
+  * @param in The stream to read puzzles from.
+  * @param threads The number of worker threads, or 0 for one per core.
+  * @param useDlx true to solve with dancing links.
+  * @return true, if every puzzle could be read.
+*/
+bool solveBatch(FILE *in, int threads, bool useDlx);
+
+/** Read every puzzle in a stream and time solving them all, first on one
+  * thread and then on more, doubling up to the given number, reporting
+  * the throughput, latency and speedup of each run to standard error.
+  * @param in The stream to read puzzles from.
+  * @param threads The most worker threads to use, or 0 for one per core.
+  * @param useDlx true to solve with dancing links.
+  * @return true, if every puzzle could be read.
+*/
+bool measureScaling(FILE *in, int threads, bool useDlx);
+
+#endif
@@ -0,0 +1,298 @@
+/** implementation file for the dancing links component.  Every blank
+    cell and digit that could go there is a row of an exact cover matrix,
+    covering four constraints: the cell is filled, and the row, column and
+    square each have the digit.  Constraints the givens already meet are
+    left out.  The matrix is kept as circular doubly linked lists in one
+    array of nodes, linked by index, and the search picks the column with
+    the fewest rows each time.  It runs in a loop with a stack of the rows
+    chosen, so its depth is bounded by the number of blank cells.
+    @file dlx.c
+    @author Vivekanand Ganapathy Nagarajan
+*/
+
+#include "dlx.h"
+#include <stdbool.h>
+#include <stdlib.h>
+
+/** Kinds of constraint, each one holds for every cell or every unit and
+    digit. */
+#define CONSTRAINT_KINDS 4
+
+/** Index of the root node, the header of the list of column headers. */
+#define ROOT 0
+
+/** A node of the matrix, or the header of a column. */
+typedef struct {
+  /** Neighbours in the node's row, or the neighbouring column headers. */
+  int left;
+  int right;
+  /** Neighbours in the node's column. */
+  int up;
+  int down;
+  /** Header of the node's column, a header is its own. */
+  int col;
+  /** For a node, the matrix row it's in.  For a header, the number of
+      nodes in the column. */
+  int row;
+} Node;
+
+/** The exact cover matrix for a puzzle. */
+typedef struct {
+  /** All the nodes, the root first and then the column headers. */
+  Node *nodes;
+  /** Number of nodes so far. */
+  int count;
+  /** Cell and digit of every matrix row. */
+  int *rowCell;
+  int *rowDigit;
+} Links;
+
+/** Take a column out of the header list, and every row crossing it out of
+  * the other columns.
+  * @param links The matrix.
+  * @param col The header of the column.
+*/
+static void cover(Links *links, int col)
+{
+  Node *nodes = links->nodes;
+  nodes[nodes[col].right].left = nodes[col].left;
+  nodes[nodes[col].left].right = nodes[col].right;
+  for (int i=nodes[col].down; i!=col; i=nodes[i].down){
+    for (int j=nodes[i].right; j!=i; j=nodes[j].right){
+      nodes[nodes[j].down].up = nodes[j].up;
+      nodes[nodes[j].up].down = nodes[j].down;
+      nodes[nodes[j].col].row--;
+    }
+  }
+}
+
+/** Put back a column taken out by cover(), in the reverse order.
+  * @param links The matrix.
+  * @param col The header of the column.
+*/
+static void uncover(Links *links, int col)
+{
+  Node *nodes = links->nodes;
+  for (int i=nodes[col].up; i!=col; i=nodes[i].up){
+    for (int j=nodes[i].left; j!=i; j=nodes[j].left){
+      nodes[nodes[j].col].row++;
+      nodes[nodes[j].down].up = j;
+      nodes[nodes[j].up].down = j;
+    }
+  }
+  nodes[nodes[col].right].left = col;
+  nodes[nodes[col].left].right = col;
+}
+
+/** Add a node to the bottom of a column.
+  * @param links The matrix.
+  * @param col The header of the column.
+  * @param row The matrix row the node is in.
+  * @return the index of the node.
+*/
+static int addNode(Links *links, int col, int row)
+{
+  Node *nodes = links->nodes;
+  int node = links->count++;
+  nodes[node].col = col;
+  nodes[node].row = row;
+  nodes[node].down = col;
+  nodes[node].up = nodes[col].up;
+  nodes[nodes[col].up].down = node;
+  nodes[col].up = node;
+  nodes[col].row++;
+  return node;
+}
+
+/** Get the column with the fewest rows left.
+  * @param links The matrix, it must have a column left.
+  * @return the header of the column.
+*/
+static int smallestColumn(Links const *links)
+{
+  Node const *nodes = links->nodes;
+  int best = nodes[ROOT].right;
+  for (int col=nodes[best].right; col!=ROOT && nodes[best].row>0; col=nodes[col].right){
+    if (nodes[col].row < nodes[best].row){
+      best = col;
+    }
+  }
+  return best;
+}
+
+/** Private function to run Algorithm X, choosing rows until every column
+  * is covered and going back to try other rows.
+  * @param links The matrix.
+  * @param chosen Room for a chosen node for every blank cell.
+  * @param limit The most solutions to look for, or 0 to count them all.
+  * @param stats The counters to add the search's work to.
+  * @param solution Filled in with the chosen nodes of the first solution.
+  * @return the number of solutions found.
+*/
+static long search(Links *links, int chosen[], long limit, SolveStats *stats, int solution[])
+{
+  Node *nodes = links->nodes;
+  long found = 0;
+  int level = 0;
+  bool descend = true;
+  while (true){
+    if (descend){
+      if (nodes[ROOT].right == ROOT){
+        // every constraint is met
+        if (found++ == 0){
+          for (int i=0; i<level; i++){
+            solution[i] = chosen[i];
+          }
+        }
+        if (found == limit){
+          return found;
+        }
+        descend = false;
+      } else{
+        int col = smallestColumn(links);
+        if (nodes[col].row == 0){
+          stats->backtracks++;
+          descend = false;
+        } else{
+          cover(links, col);
+          chosen[level] = nodes[col].down;
+        }
+      }
+    }
+    if (!descend){
+      // go back to the row chosen at the level above, and on to the next one
+      if (level == 0){
+        return found;
+      }
+      int node = chosen[--level];
+      for (int j=nodes[node].left; j!=node; j=nodes[j].left){
+        uncover(links, nodes[j].col);
+      }
+      chosen[level] = nodes[node].down;
+    }
+    int node = chosen[level];
+    int col = nodes[node].col;
+    if (node == col){
+      // every row of the column has been tried
+      uncover(links, col);
+      descend = false;
+      continue;
+    }
+    for (int j=nodes[node].right; j!=node; j=nodes[j].right){
+      cover(links, nodes[j].col);
+    }
+    stats->nodes++;
+    level++;
+    descend = true;
+  }
+}
+
+/** Solves the Sudoku puzzle represented by the grid with dancing links,
+  * counting its solutions up to a limit.
+  * @param n The square root of size of the grid.
+  * @param size The size of the grid.
+  * @param grid The puzzle represented as a grid.
+  * @param limit The most solutions to look for, or 0 to count them all.
+  * @param stats The counters, set to the search's work.
+  * @return the number of solutions found, 0 if the puzzle cannot be solved.
+*/
+long dlxSolve(int n, int size, int grid[size][size], long limit, SolveStats *stats)
+{
+  stats->nodes = 0;
+  stats->backtracks = 0;
+  int cells = size * size;
+  // constraint k of cell c is numbered k * cells + c, the other kinds by
+  // unit * size + digit - 1 in place of the cell
+  int constraints = CONSTRAINT_KINDS * cells;
+  bool *met = (bool *) calloc(constraints, sizeof(bool));
+  int spaceCount = 0;
+  for (int row=0; row<size; row++){
+    for (int col=0; col<size; col++){
+      int value = grid[row][col];
+      if (value == 0){
+        spaceCount++;
+      } else{
+        int square = row / n * n + col / n;
+        met[row * size + col] = true;
+        met[cells + row * size + value - 1] = true;
+        met[2 * cells + col * size + value - 1] = true;
+        met[3 * cells + square * size + value - 1] = true;
+      }
+    }
+  }
+
+  // the headers, linked in order after the root
+  Links links;
+  int rows = spaceCount * size;
+  links.nodes = (Node *) malloc((1 + constraints + CONSTRAINT_KINDS * rows) * sizeof(Node));
+  links.rowCell = (int *) malloc((rows + 1) * sizeof(int));
+  links.rowDigit = (int *) malloc((rows + 1) * sizeof(int));
+  int *header = (int *) malloc(constraints * sizeof(int));
+  Node *nodes = links.nodes;
+  nodes[ROOT].left = nodes[ROOT].right = ROOT;
+  links.count = 1;
+  for (int k=0; k<constraints; k++){
+    if (!met[k]){
+      int col = links.count++;
+      nodes[col].col = col;
+      nodes[col].row = 0;
+      nodes[col].up = nodes[col].down = col;
+      nodes[col].right = ROOT;
+      nodes[col].left = nodes[ROOT].left;
+      nodes[nodes[ROOT].left].right = col;
+      nodes[ROOT].left = col;
+      header[k] = col;
+    }
+  }
+
+  // a row for every blank cell and digit the givens allow there
+  int row = 0;
+  for (int r=0; r<size; r++){
+    for (int c=0; c<size; c++){
+      if (grid[r][c] != 0){
+        continue;
+      }
+      int square = r / n * n + c / n;
+      for (int digit=1; digit<=size; digit++){
+        int k[CONSTRAINT_KINDS] = { r * size + c, cells + r * size + digit - 1,
+                                    2 * cells + c * size + digit - 1,
+                                    3 * cells + square * size + digit - 1 };
+        if (met[k[1]] || met[k[2]] || met[k[3]]){
+          continue;
+        }
+        int first = -1;
+        for (int i=0; i<CONSTRAINT_KINDS; i++){
+          int node = addNode(&links, header[k[i]], row);
+          if (first < 0){
+            first = node;
+            nodes[node].left = nodes[node].right = node;
+          } else{
+            nodes[node].right = first;
+            nodes[node].left = nodes[first].left;
+            nodes[nodes[first].left].right = node;
+            nodes[first].left = node;
+          }
+        }
+        links.rowCell[row] = r * size + c;
+        links.rowDigit[row++] = digit;
+      }
+    }
+  }
+
+  // every chosen row fills a blank cell, so the depth stays in bounds
+  int chosen[spaceCount + 1];
+  int solution[spaceCount + 1];
+  long found = search(&links, chosen, limit, stats, solution);
+  if (found > 0){
+    for (int i=0; i<spaceCount; i++){
+      int cell = links.rowCell[nodes[solution[i]].row];
+      grid[cell / size][cell % size] = links.rowDigit[nodes[solution[i]].row];
+    }
+  }
+  free(header);
+  free(links.rowDigit);
+  free(links.rowCell);
+  free(links.nodes);
+  free(met);
+  return found;
+}
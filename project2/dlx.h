@@ -0,0 +1,26 @@
+/** header file for the dancing links component, which solves a Sudoku
+    puzzle as an exact cover problem with Knuth's Algorithm X, and can
+    count every solution of a puzzle.
+    @file dlx.h
+    @author Vivekanand Ganapathy Nagarajan
+*/
+
+#ifndef DLX_H
+#define DLX_H
+
+#include "solve.h"
+#include <stdbool.h>
+
+/** Solves the Sudoku puzzle represented by the grid with dancing links,
+  * counting its solutions up to a limit.  The grid is filled in with the
+  * first solution found.
+  * @param n The square root of size of the grid.
+  * @param size The size of the grid.
+  * @param grid The puzzle represented as a grid.
+  * @param limit The most solutions to look for, or 0 to count them all.
+  * @param stats The counters, set to the search's work.
+  * @return the number of solutions found, 0 if the puzzle cannot be solved.
+*/
+long dlxSolve(int n, int size, int grid[size][size], long limit, SolveStats *stats);
+
+#endif
@@ -1,114 +1,682 @@
 /** implementation file for the component that solves a Sudoku puzzle or
-    determines that it cannot be solved.
+    determines that it cannot be solved.  The solver keeps a bitmask of the
+    digits used in every row, column and square, so the digits a blank cell
+    can still take are found with a few bitwise operations instead of
+    validating the whole grid again.  Cells that have only one candidate
+    (naked singles) and digits that fit in only one cell of a row, column
+    or square (hidden singles) are filled in before guessing, and each
+    guess is made in the blank cell with the fewest candidates.  The search
+    runs in a loop with its own stack of guesses, and every digit placed is
+    recorded on a trail so a failed guess is undone by popping the trail.
+    Both hold at most one entry for each blank cell, so the memory used is
+    bounded by the number of blanks however long the search runs.
+
+    A hard puzzle can also be searched on a pool of threads.  Each thread
+    has a deque of tasks, the board at a node of the search tree, and runs
+    the newest task of its own or steals the oldest of another thread's.
+    The whole puzzle starts as one task, and while a thread is idle with
+    nothing to steal, the busy ones hand over the untried candidates of
+    their shallowest guess as new tasks, so the tree is split at the top
+    levels as it's searched.  Once a solution is found the others stop at
+    their next step, or in counting mode every subtree is searched and the
+    solutions added up.
     @file solve.c
     @author Vivekanand Ganapathy Nagarajan
 */
 
 #include "solve.h"
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
 
+/** Largest size of grid the solver can hold, one bit for every digit. */
+#define MAX_SIZE 32
 
-/** Get the number of blank spaces in the grid.
-  * @param size The size of the grid.
-  * @param grid The puzzle represented as a grid.
+/** Kinds of unit, each holds every digit exactly once. */
+#define UNIT_KINDS 3
+
+/** Initial capacity of a thread's deque of tasks. */
+#define INIT_CAPACITY 16
+
+/** Growth factor for a deque of tasks. */
+#define MULTIPLY_FACTOR 2
+
+/** A set of digits, digit d is bit d-1. */
+typedef unsigned int DigitSet;
+
+/** State of a puzzle being solved. */
+typedef struct {
+  /** The square root of size of the grid. */
+  int n;
+  /** The size of the grid. */
+  int size;
+  /** The digits every row, column and square must hold. */
+  DigitSet all;
+  /** Number of blank cells left. */
+  int blanks;
+  /** The cells filled in so far, in order, so they can be undone. */
+  int *trail;
+  /** Number of cells on the trail. */
+  int trailSize;
+  /** The digit in every cell, row by row, 0 for a blank. */
+  unsigned char cells[MAX_SIZE * MAX_SIZE];
+  /** Digits used in every row, column and square. */
+  DigitSet rows[MAX_SIZE];
+  DigitSet cols[MAX_SIZE];
+  DigitSet squares[MAX_SIZE];
+} Board;
+
+/** Get the set holding just the given digit.
+  * @param digit The digit, from 1 to size.
+  * @return the set.
 */
-int getSpaceCount(int size, int grid[size][size])
+static DigitSet digitBit(int digit)
 {
-  int count = 0;
-  for (int row=0; row<size; row++){
-    for (int col=0; col<size; col++){
-      if (grid[row][col] == 0){
-        count++;
+  return 1u << (digit - 1);
+}
+
+/** Get the index of the square the given cell is in.
+  * @param board The puzzle being solved.
+  * @param row The row of the cell.
+  * @param col The column of the cell.
+  * @return the index of the square.
+*/
+static int squareOf(Board const *board, int row, int col)
+{
+  return row / board->n * board->n + col / board->n;
+}
+
+/** Get the digits a blank cell can still take.
+  * @param board The puzzle being solved.
+  * @param cell The index of the cell, row by row.
+  * @return the candidate digits.
+*/
+static DigitSet candidates(Board const *board, int cell)
+{
+  int row = cell / board->size;
+  int col = cell % board->size;
+  return board->all & ~(board->rows[row] | board->cols[col]
+                        | board->squares[squareOf(board, row, col)]);
+}
+
+/** Put a digit in a blank cell.
+  * @param board The puzzle being solved.
+  * @param cell The index of the cell, row by row.
+  * @param digit The digit to put there.
+*/
+static void place(Board *board, int cell, int digit)
+{
+  int row = cell / board->size;
+  int col = cell % board->size;
+  DigitSet bit = digitBit(digit);
+  board->cells[cell] = digit;
+  board->rows[row] |= bit;
+  board->cols[col] |= bit;
+  board->squares[squareOf(board, row, col)] |= bit;
+  board->blanks--;
+  board->trail[board->trailSize++] = cell;
+}
+
+/** Take the digits placed after a point on the trail back out.
+  * @param board The puzzle being solved.
+  * @param mark The trail size to go back to.
+*/
+static void undo(Board *board, int mark)
+{
+  while (board->trailSize > mark){
+    int cell = board->trail[--board->trailSize];
+    int row = cell / board->size;
+    int col = cell % board->size;
+    DigitSet bit = digitBit(board->cells[cell]);
+    board->cells[cell] = 0;
+    board->rows[row] &= ~bit;
+    board->cols[col] &= ~bit;
+    board->squares[squareOf(board, row, col)] &= ~bit;
+    board->blanks++;
+  }
+}
+
+/** Get the cell at a position in a row, column or square.  Units 0 to
+  * size-1 are the rows, then the columns, then the squares.
+  * @param board The puzzle being solved.
+  * @param unit The index of the unit.
+  * @param i The position in the unit.
+  * @return the index of the cell, row by row.
+*/
+static int unitCell(Board const *board, int unit, int i)
+{
+  int size = board->size;
+  int n = board->n;
+  if (unit < size){
+    return unit * size + i;
+  }
+  if (unit < 2 * size){
+    return i * size + unit - size;
+  }
+  int square = unit - 2 * size;
+  int row = square / n * n + i / n;
+  int col = square % n * n + i % n;
+  return row * size + col;
+}
+
+/** Fill in every naked single and hidden single, over and over until
+  * there are none left.
+  * @param board The puzzle being solved.
+  * @return false if the puzzle turned out to have no solution.
+*/
+static bool propagate(Board *board)
+{
+  int size = board->size;
+  bool changed = true;
+  while (changed){
+    changed = false;
+    // naked singles, blank cells with one candidate
+    for (int cell=0; cell<size*size; cell++){
+      if (board->cells[cell] == 0){
+        DigitSet cand = candidates(board, cell);
+        if (cand == 0){
+          return false;
+        }
+        if ((cand & (cand - 1)) == 0){
+          place(board, cell, __builtin_ctz(cand) + 1);
+          changed = true;
+        }
+      }
+    }
+    // hidden singles, digits with one place in a unit
+    for (int unit=0; unit<UNIT_KINDS*size; unit++){
+      DigitSet used = 0;
+      DigitSet once = 0;
+      DigitSet twice = 0;
+      for (int i=0; i<size; i++){
+        int cell = unitCell(board, unit, i);
+        if (board->cells[cell] != 0){
+          used |= digitBit(board->cells[cell]);
+        } else{
+          DigitSet cand = candidates(board, cell);
+          twice |= once & cand;
+          once |= cand;
+        }
+      }
+      if ((used | once) != board->all){
+        // a digit has nowhere to go in this unit
+        return false;
+      }
+      DigitSet hidden = once & ~twice;
+      while (hidden){
+        int digit = __builtin_ctz(hidden) + 1;
+        hidden &= hidden - 1;
+        int cell = -1;
+        for (int i=0; i<size && cell<0; i++){
+          int other = unitCell(board, unit, i);
+          if (board->cells[other] == 0 && (candidates(board, other) & digitBit(digit))){
+            cell = other;
+          }
+        }
+        if (cell < 0){
+          // an earlier single in this unit took its only place
+          return false;
+        }
+        place(board, cell, digit);
+        changed = true;
+      }
+    }
+  }
+  return true;
+}
+
+/** Get the blank cell with the fewest candidates, the minimum remaining
+  * values heuristic.
+  * @param board The puzzle being solved, it must have a blank cell.
+  * @return the index of the cell.
+*/
+static int fewestCandidates(Board const *board)
+{
+  int best = -1;
+  int bestCount = board->size + 1;
+  for (int cell=0; cell<board->size*board->size && bestCount>2; cell++){
+    if (board->cells[cell] == 0){
+      int count = __builtin_popcount(candidates(board, cell));
+      if (count < bestCount){
+        best = cell;
+        bestCount = count;
+      }
+    }
+  }
+  return best;
+}
+
+/** A guess on the search stack. */
+typedef struct {
+  /** The cell guessed at. */
+  int cell;
+  /** Candidates of the cell not tried yet. */
+  DigitSet untried;
+  /** Trail size before the guess, to undo it. */
+  int mark;
+} Guess;
+
+/** A node of the search tree left for a thread to search. */
+typedef struct {
+  /** The digit in every cell, row by row, 0 for a blank. */
+  unsigned char cells[MAX_SIZE * MAX_SIZE];
+} Task;
+
+/** The tasks of one thread, it takes the newest and others steal the oldest. */
+typedef struct {
+  /** The tasks, the ones from head up to tail are waiting. */
+  Task *tasks;
+  int head;
+  int tail;
+  /** Room in tasks. */
+  int capacity;
+} Deque;
+
+/** State shared by the threads searching a puzzle. */
+typedef struct {
+  /** The square root of size of the grid. */
+  int n;
+  /** The size of the grid. */
+  int size;
+  /** True to search every subtree and count the solutions. */
+  bool countAll;
+  /** Lock for everything below, other than the counters read without it. */
+  pthread_mutex_t lock;
+  /** Signaled when tasks are queued, or when the search is over. */
+  pthread_cond_t work;
+  /** A deque for every thread. */
+  Deque *deques;
+  int threads;
+  /** Number of tasks waiting in the deques, read without the lock. */
+  int queued;
+  /** Number of threads waiting for a task, read without the lock. */
+  int idle;
+  /** Number of threads running a task. */
+  int busy;
+  /** Set once a solution is found, unless counting, read without the lock. */
+  int stop;
+  /** Number of solutions found. */
+  long found;
+  /** The first solution found. */
+  unsigned char solution[MAX_SIZE * MAX_SIZE];
+  /** The work done by the threads that are finished. */
+  SolveStats stats;
+} Pool;
+
+/** Add a task to the newest end of a deque.  The pool must be locked.
+  * @param pool The pool the deque is in.
+  * @param deque The deque.
+  * @return the task, to fill in.
+*/
+static Task *pushTask(Pool *pool, Deque *deque)
+{
+  if (deque->head == deque->tail){
+    deque->head = deque->tail = 0;
+  }
+  if (deque->tail == deque->capacity){
+    deque->capacity *= MULTIPLY_FACTOR;
+    deque->tasks = (Task *) realloc(deque->tasks, deque->capacity * sizeof(Task));
+  }
+  __atomic_store_n(&pool->queued, pool->queued + 1, __ATOMIC_RELAXED);
+  return deque->tasks + deque->tail++;
+}
+
+/** Take a task for a thread, its own newest one or the oldest one of
+  * another thread.  The pool must be locked.
+  * @param pool The pool to take from.
+  * @param self The index of the thread.
+  * @param task Filled in with the task.
+  * @return false if there's no task left, or the search is over.
+*/
+static bool takeTask(Pool *pool, int self, Task *task)
+{
+  if (pool->stop){
+    return false;
+  }
+  Deque *own = pool->deques + self;
+  if (own->head < own->tail){
+    *task = own->tasks[--own->tail];
+    __atomic_store_n(&pool->queued, pool->queued - 1, __ATOMIC_RELAXED);
+    return true;
+  }
+  for (int i=1; i<pool->threads; i++){
+    Deque *victim = pool->deques + (self + i) % pool->threads;
+    if (victim->head < victim->tail){
+      *task = victim->tasks[victim->head++];
+      __atomic_store_n(&pool->queued, pool->queued - 1, __ATOMIC_RELAXED);
+      return true;
+    }
+  }
+  return false;
+}
+
+/** Hand the untried candidates of the shallowest guess over to the pool
+  * as new tasks, for the idle threads to steal.
+  * @param pool The pool to hand them to.
+  * @param self The index of the thread searching.
+  * @param board The puzzle being solved.
+  * @param guesses The search stack.
+  * @param depth The number of guesses on the stack.
+*/
+static void shareWork(Pool *pool, int self, Board const *board, Guess guesses[], int depth)
+{
+  int i = 0;
+  while (i < depth && guesses[i].untried == 0){
+    i++;
+  }
+  if (i == depth){
+    return;
+  }
+  Guess *guess = guesses + i;
+  // the board at the guess, before it put a digit in its cell
+  unsigned char cells[MAX_SIZE * MAX_SIZE];
+  int size = board->size;
+  memcpy(cells, board->cells, size * size);
+  for (int t=guess->mark; t<board->trailSize; t++){
+    cells[board->trail[t]] = 0;
+  }
+  DigitSet shared = guess->untried;
+  if (board->trailSize == guess->mark){
+    // nothing has been tried at the guess yet, keep a candidate to go on with
+    shared &= shared - 1;
+  }
+  guess->untried &= ~shared;
+
+  pthread_mutex_lock(&pool->lock);
+  while (shared){
+    Task *task = pushTask(pool, pool->deques + self);
+    memcpy(task->cells, cells, size * size);
+    task->cells[guess->cell] = __builtin_ctz(shared) + 1;
+    shared &= shared - 1;
+  }
+  pthread_cond_broadcast(&pool->work);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/** Private function to solve the puzzle, filling in the singles and then
+  * trying each candidate of the blank cell with the fewest, backtracking
+  * when a guess leads to a contradiction.
+  * @param board The puzzle being solved, it holds the solution on success.
+  * @param guesses Room for a guess for every blank cell.
+  * @param pool The pool of threads searching the puzzle, or NULL if this
+  *        is the only one.
+  * @param self The index of the thread in the pool.
+  * @param stats The counters to add the search's work to.
+  * @return the number of solutions found, at most one unless the pool is
+  *         counting them all.
+*/
+static long search(Board *board, Guess guesses[], Pool *pool, int self, SolveStats *stats)
+{
+  long found = 0;
+  int depth = 0;
+  bool consistent = propagate(board);
+  while (true){
+    if (pool && __atomic_load_n(&pool->stop, __ATOMIC_RELAXED)){
+      // another thread found a solution
+      return found;
+    }
+    if (consistent && board->blanks == 0){
+      if (pool == NULL || !pool->countAll){
+        return 1;
       }
+      // count it and go on with the next candidate
+      found++;
+    } else if (consistent){
+      // every guess fills in at least one blank, so depth stays in bounds
+      Guess *guess = guesses + depth++;
+      guess->cell = fewestCandidates(board);
+      guess->untried = candidates(board, guess->cell);
+      guess->mark = board->trailSize;
+    } else{
+      stats->backtracks++;
+    }
+    if (pool && __atomic_load_n(&pool->idle, __ATOMIC_RELAXED) > 0
+        && __atomic_load_n(&pool->queued, __ATOMIC_RELAXED) == 0){
+      shareWork(pool, self, board, guesses, depth);
+    }
+    // go back to the latest guess with a candidate left to try
+    while (depth > 0 && guesses[depth-1].untried == 0){
+      depth--;
+    }
+    if (depth == 0){
+      return found;
     }
+    Guess *guess = guesses + depth - 1;
+    undo(board, guess->mark);
+    int digit = __builtin_ctz(guess->untried) + 1;
+    guess->untried &= guess->untried - 1;
+    place(board, guess->cell, digit);
+    stats->nodes++;
+    consistent = propagate(board);
   }
-  return count;
 }
 
-/** Update the blank space grid to capture position of blank spaces in the grid.
-  * @param spaceCount The number of blank spaces in the grid.
-  * @param spaceGrid The blank spaces in the grid caputred in space grid.
+/** Set up a board for a puzzle.  The givens stay put, so they don't go
+  * on the trail.
+  * @param board The board to set up.
+  * @param n The square root of size of the grid.
   * @param size The size of the grid.
-  * @param grid The puzzle represented as a grid.
+  * @param cells The digit in every cell, row by row, 0 for a blank.
+  * @param trail Room for every blank cell.
 */
-void updateBlankSpaceGrid(int spaceCount, int spaceGrid[spaceCount], int size, int grid[size][size])
+static void initBoard(Board *board, int n, int size, unsigned char const cells[], int trail[])
 {
-  int index = 0;
-  int posCounter = 0;
+  board->trail = trail;
+  board->n = n;
+  board->size = size;
+  board->all = size == MAX_SIZE ? ~0u : digitBit(size + 1) - 1;
+  board->blanks = 0;
+  for (int i=0; i<size; i++){
+    board->rows[i] = board->cols[i] = board->squares[i] = 0;
+  }
+  board->trailSize = 0;
   for (int row=0; row<size; row++){
     for (int col=0; col<size; col++){
-      posCounter++;
-      if (grid[row][col] == 0){
-        spaceGrid[index++] = posCounter;
+      int cell = row * size + col;
+      board->cells[cell] = cells[cell];
+      if (cells[cell] == 0){
+        board->blanks++;
+      } else{
+        DigitSet bit = digitBit(cells[cell]);
+        board->rows[row] |= bit;
+        board->cols[col] |= bit;
+        board->squares[squareOf(board, row, col)] |= bit;
       }
     }
   }
 }
 
-/** Compute the row and columnn based on the given position which is
-  * stored in the space grid.
+/** Count the blank cells of a puzzle.
   * @param size The size of the grid.
-  * @param index The index of the space grid.
-  * @param spaceCount The number of blank spaces in the grid.
-  * @param spaceGrid The blank spaces in the grid caputred in space grid.
-  * @param rowCol The 2 element array which stores the row in index 0 and
-                  column in index 1.
+  * @param cells The digit in every cell, row by row, 0 for a blank.
+  * @return the number of blank cells.
 */
-void getRowCol(int size, int index, int spaceCount, int spaceGrid[spaceCount], int rowCol[2])
+static int countSpaces(int size, unsigned char const cells[])
 {
-  int position = spaceGrid[index];
-  int row = (position-1)/size;
-  int col = (position-1)%size;
-  rowCol[0] = row;
-  rowCol[1] = col;
+  int spaceCount = 0;
+  for (int cell=0; cell<size*size; cell++){
+    if (cells[cell] == 0){
+      spaceCount++;
+    }
+  }
+  return spaceCount;
+}
+
+/** Search the subtree of a task, and record what it found.
+  * @param pool The pool running the task.
+  * @param self The index of the thread running it.
+  * @param task The task.
+  * @param stats The counters to add the search's work to.
+*/
+static void runTask(Pool *pool, int self, Task const *task, SolveStats *stats)
+{
+  // the trail and the guesses never hold more than one entry per blank
+  int spaceCount = countSpaces(pool->size, task->cells);
+  int trail[spaceCount + 1];
+  Guess guesses[spaceCount + 1];
+  Board board;
+  initBoard(&board, pool->n, pool->size, task->cells, trail);
+  long found = search(&board, guesses, pool, self, stats);
+  if (found > 0){
+    pthread_mutex_lock(&pool->lock);
+    if (pool->found == 0){
+      memcpy(pool->solution, board.cells, pool->size * pool->size);
+    }
+    pool->found += found;
+    if (!pool->countAll){
+      __atomic_store_n(&pool->stop, 1, __ATOMIC_RELAXED);
+      pthread_cond_broadcast(&pool->work);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
 }
 
-/** Private recursive function to solve the Sudoku puzzle represented as grid.
+/** The index of a thread in a pool. */
+typedef struct {
+  /** The pool. */
+  Pool *pool;
+  /** The index of the thread, and of its deque. */
+  int self;
+} Worker;
+
+/** Body of a searching thread, running its own tasks and stealing others'
+  * until none are left and no thread is busy, or a solution is found.
+  * @param arg The Worker for the thread.
+  * @return NULL
+*/
+static void *worker(void *arg)
+{
+  Pool *pool = ((Worker *) arg)->pool;
+  int self = ((Worker *) arg)->self;
+  SolveStats stats = { 0, 0 };
+  Task task;
+  pthread_mutex_lock(&pool->lock);
+  while (true){
+    if (takeTask(pool, self, &task)){
+      pool->busy++;
+      pthread_mutex_unlock(&pool->lock);
+      runTask(pool, self, &task, &stats);
+      pthread_mutex_lock(&pool->lock);
+      pool->busy--;
+    } else if (pool->stop || pool->busy == 0){
+      break;
+    } else{
+      __atomic_store_n(&pool->idle, pool->idle + 1, __ATOMIC_RELAXED);
+      pthread_cond_wait(&pool->work, &pool->lock);
+      __atomic_store_n(&pool->idle, pool->idle - 1, __ATOMIC_RELAXED);
+    }
+  }
+  // wake the others, there's nothing left for them either
+  pthread_cond_broadcast(&pool->work);
+  pool->stats.nodes += stats.nodes;
+  pool->stats.backtracks += stats.backtracks;
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+/** Solves the Sudoku puzzle represented by the grid, counting the work
+  * done by the search.
   * @param n The square root of size of the grid.
   * @param size The size of the grid.
   * @param grid The puzzle represented as a grid.
-  * @param index The position of the blank space in the spaceGrid.
-  * @param spaceCount The number of blank spaces in the grid.
-  * @param spaceGrid The position of blank spaces in the puzzle.
+  * @param stats The counters, set to the search's work.
   * @return true, if successful in solving the puzzle, false otherwise.
 */
-bool recursiveSolve(int n, int size, int grid[size][size], int index, int spaceCount, int spaceGrid[spaceCount])
+bool solveWithStats(int n, int size, int grid[size][size], SolveStats *stats)
 {
-  //base case
-  if (index < 0){
+  unsigned char cells[MAX_SIZE * MAX_SIZE];
+  for (int row=0; row<size; row++){
+    for (int col=0; col<size; col++){
+      cells[row * size + col] = grid[row][col];
+    }
+  }
+  // the trail and the guesses never hold more than one entry per blank
+  int spaceCount = countSpaces(size, cells);
+  int trail[spaceCount + 1];
+  Guess guesses[spaceCount + 1];
+  stats->nodes = 0;
+  stats->backtracks = 0;
+
+  Board board;
+  initBoard(&board, n, size, cells, trail);
+  if (search(&board, guesses, NULL, 0, stats) == 0){
     return false;
   }
-  if (index >= spaceCount){
-    //satisfied all blankSpacces
-    return true;
+  for (int row=0; row<size; row++){
+    for (int col=0; col<size; col++){
+      grid[row][col] = board.cells[row * size + col];
+    }
   }
-  int rowCol[2];
-  getRowCol(size, index, spaceCount, spaceGrid, rowCol);
-  int row = rowCol[0];
-  int col = rowCol[1];
-  int value = grid[row][col];
-  if (value == size){
-      // values entered at current index do not satisfy condition
-      return false;
-  }
-  grid[row][col] = value+1;
-  // there are more blankspaces
-  if (validateRowsWithSpaces(size, grid) && validateColsWithSpaces(size, grid) && validateSquaresWithSpaces(n, size, grid)){
-      // value does not violate condition, so proceed to next blankspace
-      return recursiveSolve(n, size, grid, index+1, spaceCount, spaceGrid);
-  } else{
-      //enter the next value in the same blankSpace
-      bool check =  recursiveSolve(n, size, grid, index, spaceCount, spaceGrid);
-      if (check){
-        //next value satisfied, so go to next blankspace
-        //return recursiveSolve(n, size, grid, index+1, spaceCount, spaceGrid);
-        return true;
+  return true;
+}
+
+/** Solves the Sudoku puzzle represented by the grid on a pool of threads
+  * that steal subtrees of the search from each other.
+  * @param n The square root of size of the grid.
+  * @param size The size of the grid.
+  * @param grid The puzzle represented as a grid, filled in with the first
+  *        solution found.
+  * @param threads The number of threads to search with.
+  * @param countAll true to search the whole tree and count every solution,
+  *        false to stop at the first.
+  * @param stats The counters, set to the work of all the threads.
+  * @return the number of solutions found, 0 if the puzzle cannot be solved.
+*/
+long solveParallel(int n, int size, int grid[size][size], int threads, bool countAll,
+                   SolveStats *stats)
+{
+  Pool pool;
+  pool.n = n;
+  pool.size = size;
+  pool.countAll = countAll;
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.work, NULL);
+  pool.threads = threads;
+  pool.deques = (Deque *) malloc(threads * sizeof(Deque));
+  for (int i=0; i<threads; i++){
+    pool.deques[i].capacity = INIT_CAPACITY;
+    pool.deques[i].tasks = (Task *) malloc(INIT_CAPACITY * sizeof(Task));
+    pool.deques[i].head = pool.deques[i].tail = 0;
+  }
+  pool.queued = pool.idle = pool.busy = pool.stop = 0;
+  pool.found = 0;
+  pool.stats.nodes = 0;
+  pool.stats.backtracks = 0;
+
+  // the whole puzzle is the first task, the others split off from it
+  Task *root = pushTask(&pool, pool.deques);
+  for (int row=0; row<size; row++){
+    for (int col=0; col<size; col++){
+      root->cells[row * size + col] = grid[row][col];
+    }
+  }
+  pthread_t ids[threads];
+  Worker workers[threads];
+  for (int i=0; i<threads; i++){
+    workers[i].pool = &pool;
+    workers[i].self = i;
+    pthread_create(ids + i, NULL, worker, workers + i);
+  }
+  for (int i=0; i<threads; i++){
+    pthread_join(ids[i], NULL);
+  }
+
+  if (pool.found > 0){
+    for (int row=0; row<size; row++){
+      for (int col=0; col<size; col++){
+        grid[row][col] = pool.solution[row * size + col];
       }
-      //backtrack since all values cannot be satisfied at that index so reset at index
-      grid[row][col] = 0;
-      //go back to previous blankspace
-      return recursiveSolve(n, size, grid, index-1, spaceCount, spaceGrid);
+    }
+  }
+  *stats = pool.stats;
+  for (int i=0; i<threads; i++){
+    free(pool.deques[i].tasks);
   }
+  free(pool.deques);
+  pthread_cond_destroy(&pool.work);
+  pthread_mutex_destroy(&pool.lock);
+  return pool.found;
 }
 
 /** Solves the Sudoku puzzle represented by the grid.
@@ -119,8 +687,6 @@ bool recursiveSolve(int n, int size, int grid[size][size], int index, int spaceC
 */
 bool solve(int n, int size, int grid[size][size])
 {
-  int spaceCount = getSpaceCount(size, grid);
-  int spaceGrid[spaceCount];
-  updateBlankSpaceGrid(spaceCount, spaceGrid, size, grid);
-  return recursiveSolve(n, size, grid, 0, spaceCount, spaceGrid);
+  SolveStats stats;
+  return solveWithStats(n, size, grid, &stats);
 }
@@ -4,9 +4,20 @@
     @author Vivekanand Ganapathy Nagarajan
 */
 
+#ifndef SOLVE_H
+#define SOLVE_H
+
 #include "validate.h"
 #include <stdbool.h>
 
+/** Counters for the work done by the solver, for profiling. */
+typedef struct {
+  /** Number of guesses made, the nodes of the search tree. */
+  long nodes;
+  /** Number of times a guess led to a contradiction and was undone. */
+  long backtracks;
+} SolveStats;
+
 /** Solves the Sudoku puzzle represented by the grid.
   * @param n The square root of size of the grid.
   * @param size The size of the grid
@@ -14,3 +25,32 @@
   * @return true, if successful in solving the puzzle, false otherwise.
 */
 bool solve(int n, int size, int grid[size][size]);
+
+/** Solves the Sudoku puzzle represented by the grid, counting the work
+  * done by the search.  The memory it uses is bounded by the number of
+  * blank cells.
+  * @param n The square root of size of the grid.
+  * @param size The size of the grid
+  * @param grid The puzzle represented as a grid.
+  * @param stats The counters, set to the search's work.
+  * @return true, if successful in solving the puzzle, false otherwise.
+*/
+bool solveWithStats(int n, int size, int grid[size][size], SolveStats *stats);
+
+/** Solves the Sudoku puzzle represented by the grid on a pool of threads.
+  * The search tree is split into subtrees as it goes, which idle threads
+  * steal from busy ones, and the threads stop once any of them finds a
+  * solution, or search every subtree and add up the solutions they find.
+  * @param n The square root of size of the grid.
+  * @param size The size of the grid
+  * @param grid The puzzle represented as a grid, filled in with the first
+  *        solution found.
+  * @param threads The number of threads to search with.
+  * @param countAll true to count every solution, false to stop at the first.
+  * @param stats The counters, set to the work of all the threads.
+  * @return the number of solutions found, 0 if the puzzle cannot be solved.
+*/
+long solveParallel(int n, int size, int grid[size][size], int threads, bool countAll,
+                   SolveStats *stats);
+
+#endif
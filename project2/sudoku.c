@@ -5,57 +5,87 @@
 
 #include "validate.h"
 #include "solve.h"
+#include "dlx.h"
+#include "batch.h"
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <math.h>
+#include <string.h>
 
-/** Constants for lower and upper size limit**/
-#define SIZE_LOW 4
-#define SIZE_HIGH 16
+/** Option for printing the solver's counters to standard error **/
+#define STATS_OPTION "--stats"
 
-/**  Check if given number is a perfect square.
-    @param number The number to check.
-    @param true, if number is perfect square, false otherwise.
-*/
-static bool isPerfectSquare(int number)
-{
-    int iVar;
-    float fVar;
+/** Options for choosing the solver, the bitmask search or dancing links **/
+#define BITMASK_OPTION "--engine=bitmask"
+#define DLX_OPTION "--engine=dlx"
 
-    fVar=sqrt((double)number);
-    iVar=fVar;
+/** Option for printing the number of solutions instead of one of them **/
+#define COUNT_OPTION "--count"
 
-    if (iVar==fVar)
-        return true;
-    else
-        return false;
-}
+/** Options for solving a stream of puzzles on a pool of threads, the
+    number of threads, and timing the pool at more and more threads **/
+#define BATCH_OPTION "--batch"
+#define THREADS_OPTION "--threads="
+#define SCALING_OPTION "--scaling"
 
-/**  Print the grid values in case the grid can be solved.
-    @param size The size of the grid.
-    @param grid The puzzle represented as a grid.
+/** Print the usage message.
+  * @return the exit status for a bad command line.
 */
-static void printGrid(int size, int grid[][size])
+static int usage()
 {
-  for (int row=0; row<size; row++){
-    printf(" ");
-    for (int col=0; col<size; col++){
-      if (col == size-1){
-        printf("%2d", grid[row][col]);
-      } else{
-        printf("%2d ", grid[row][col]);
-      }
-    }
-    printf("\n");
-  }
+  fprintf(stderr, "usage: sudoku [%s] [%s | %s] [%s | %s | %s] [%sN]\n", STATS_OPTION,
+          BITMASK_OPTION, DLX_OPTION, COUNT_OPTION, BATCH_OPTION, SCALING_OPTION,
+          THREADS_OPTION);
+  return EXIT_FAILURE;
 }
 
 /** Starting point of the program.
+  * @param argc Number of command-line arguments.
+  * @param argv List of command-line arguments.
   * @return The exit status.
   */
-int main()
+int main(int argc, char *argv[])
 {
+  bool printStats = false;
+  bool useDlx = false;
+  bool countAll = false;
+  bool batch = false;
+  bool scaling = false;
+  int threads = 0;
+  for (int arg=1; arg<argc; arg++){
+    if (strcmp(argv[arg], STATS_OPTION) == 0){
+      printStats = true;
+    } else if (strcmp(argv[arg], BITMASK_OPTION) == 0){
+      useDlx = false;
+    } else if (strcmp(argv[arg], DLX_OPTION) == 0){
+      useDlx = true;
+    } else if (strcmp(argv[arg], COUNT_OPTION) == 0){
+      countAll = true;
+    } else if (strcmp(argv[arg], BATCH_OPTION) == 0){
+      batch = true;
+    } else if (strcmp(argv[arg], SCALING_OPTION) == 0){
+      batch = true;
+      scaling = true;
+    } else if (strncmp(argv[arg], THREADS_OPTION, strlen(THREADS_OPTION)) == 0){
+      char *end;
+      threads = strtol(argv[arg] + strlen(THREADS_OPTION), &end, 10);
+      if (*end || threads < 1){
+        return usage();
+      }
+    } else{
+      return usage();
+    }
+  }
+  // in single mode the threads split the bitmask search between them
+  if ((batch && countAll) || (!batch && threads > 0 && useDlx)){
+    return usage();
+  }
+  if (batch){
+    bool readAll = scaling ? measureScaling(stdin, threads, useDlx)
+                           : solveBatch(stdin, threads, useDlx);
+    return readAll ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
   // size of the puzzle
   int size;
   int gridValue;
@@ -65,7 +95,7 @@ int main()
      return EXIT_FAILURE;
   }
   // check for invalid input in size
-  if (size < SIZE_LOW || size > SIZE_HIGH || !isPerfectSquare(size)){
+  if (!validSize(size)){
      printf("Invalid size\n");
      return EXIT_FAILURE;
   }
@@ -91,15 +121,19 @@ int main()
       grid[row][col] = gridValue;
     }
   }
+  SolveStats stats;
+  if (!countAll){
+    answerPuzzle(n, size, grid, false, useDlx, threads, stdout, &stats);
+    if (printStats && isSpacePuzzle){
+      fprintf(stderr, "nodes: %ld\nbacktracks: %ld\n", stats.nodes, stats.backtracks);
+    }
+    return EXIT_SUCCESS;
+  }
   //check if puzzle has no spaces, so puzzle is complete and validate if it is valid
   if (!isSpacePuzzle){
     bool success = validateRows(size, grid) && validateCols(size, grid)
                    && validateSquares(n, size, grid);
-    if (!success){
-      printf("Invalid\n");
-      return EXIT_SUCCESS;
-    }
-    printf("Valid\n");
+    printf(success ? "Valid\n" : "Invalid\n");
     return EXIT_SUCCESS;
   }
   //puzzle has blankspaces
@@ -109,11 +143,13 @@ int main()
     printf("Invalid\n");
     return EXIT_SUCCESS;
   }
-  success = solve(n, size, grid);
-  if (!success){
-    printf("Invalid\n");
-    return EXIT_SUCCESS;
+  // counting needs every solution, which dancing links can enumerate, or
+  // the bitmask search split between threads
+  long solutions = threads > 0 ? solveParallel(n, size, grid, threads, true, &stats)
+                               : dlxSolve(n, size, grid, 0, &stats);
+  if (printStats){
+    fprintf(stderr, "nodes: %ld\nbacktracks: %ld\n", stats.nodes, stats.backtracks);
   }
-  printGrid(size, grid);
+  printf("Solutions: %ld\n", solutions);
   return EXIT_SUCCESS;
 }
@@ -2,14 +2,16 @@
 FAIL=0
 
 # Function to run a test and check its output and exit status against expected.
+# Any arguments after the first two are passed on to the program.
 runTest() {
   TESTNO=$1
   ESTATUS=$2
+  shift 2
 
   rm -f output.html
 
-  echo "Test $TESTNO: ./sudoku < input-$TESTNO.txt > output.txt"
-  ./sudoku < input-$TESTNO.txt > output.txt
+  echo "Test $TESTNO: ./sudoku $@ < input-$TESTNO.txt > output.txt"
+  ./sudoku "$@" < input-$TESTNO.txt > output.txt
   STATUS=$?
 
   # Make sure the program exited with the right exit status.
@@ -52,6 +54,11 @@ if [ -x sudoku ] ; then
     runTest 14 1
     runTest 15 1
     runTest 16 1
+    runTest 17 0
+    runTest 18 0 --count
+    runTest 19 0 --batch --threads=2
+    runTest 20 0 --threads=2
+    runTest 21 0 --count --threads=3
 
 else
     echo "**** The sudoku program didn't compile successfully"
@@ -32,7 +32,7 @@ static bool validateRowsColumnsWithSpacesOrNot(int size, int grid[][size], bool
   // 1-1 mapping between value and index
   bool digitsUsed[size+1];
   //initialize array check to false
-  initializeArray(size+1, digitsUsed);
+  initializeArray(size, digitsUsed);
 
   // i - used for outer loop iteration
   // j - used for inner loop iteration
@@ -56,7 +56,7 @@ static bool validateRowsColumnsWithSpacesOrNot(int size, int grid[][size], bool
         digitsUsed[value] = true;
      }
      // reset array check for next row validation
-     initializeArray(size+1, digitsUsed);
+     initializeArray(size, digitsUsed);
   }
   return true;
 }
@@ -103,7 +103,7 @@ static bool validateSquaresHelper(int n, int size, int grid[][size], bool isSpac
       // 1-1 mapping between value and index
       bool digitsUsed[size+1];
       //initialize array check to false
-      initializeArray(size+1, digitsUsed);
+      initializeArray(size, digitsUsed);
       for (int r2=r1; r2<r1+n; r2++){
         for (int c2=c1; c2<c1+n; c2++){
           int value = grid[r2][c2];
@@ -121,7 +121,7 @@ static bool validateSquaresHelper(int n, int size, int grid[][size], bool isSpac
         }
       }
       // reset digitsUsedArray
-      initializeArray(size+1, digitsUsed);
+      initializeArray(size, digitsUsed);
     }
   }
   return true;
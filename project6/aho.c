@@ -0,0 +1,452 @@
+/**
+  Implementation of the aho component.  The words are put in a trie,
+  and each state gets a failure link to the longest proper suffix of
+  its string that's also in the trie, so the search never backs up in
+  the input.  States are numbered in breadth-first order, and the
+  shallow ones, where the search spends nearly all its time, get a full
+  transition table over the bytes the words use.  Edges out of the
+  deeper states are kept in one hash table, so the automaton stays
+  small with thousands of words.
+
+  @file aho.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#include "aho.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of possible byte values.
+#define BYTES 256
+
+// Marks an empty slot of the edge table, or no state or word.
+#define NONE -1
+
+// Smallest size of the edge table.
+#define MIN_EDGE_TABLE 16
+
+// Most entries in the full transition table.
+#define DENSE_BUDGET (1 << 20)
+
+/** Representation of the automaton. */
+struct AhoCorasickStruct {
+  /** Number of states, state 0 is the start state. */
+  int count;
+  /** Number of words. */
+  int words;
+  /** Class of each byte, 0 for bytes in no word and one for each other byte. */
+  int byteClass[ BYTES ];
+  /** Number of byte classes. */
+  int classes;
+  /** States below this have a row in delta. */
+  int dense;
+  /** State after each class of byte, following failure links, for the dense states. */
+  int *delta;
+  /** Keys of the trie edges, state * BYTES + byte, or NONE for an empty slot. */
+  int *edgeKey;
+  /** State each edge goes to. */
+  int *edgeTo;
+  /** Size of the edge table minus one, the size is a power of two. */
+  unsigned edgeMask;
+  /** State for the longest proper suffix of each state's string. */
+  int *fail;
+  /** First word ending at each state, or NONE. */
+  int *first;
+  /** Nearest state along the failure links where a word ends, or NONE. */
+  int *outLink;
+  /** Next word ending at the same state as each word, or NONE. */
+  int *next;
+  /** True if the arrays are in memory the automaton doesn't own. */
+  bool mapped;
+};
+
+/** Sizes at the start of an automaton written to a file, before its arrays. */
+typedef struct {
+  /** Number of states. */
+  int count;
+  /** Number of words. */
+  int words;
+  /** Number of byte classes. */
+  int classes;
+  /** Number of dense states. */
+  int dense;
+  /** Size of the edge table minus one. */
+  unsigned edgeMask;
+  /** Class of each byte. */
+  int byteClass[ BYTES ];
+} AhoImage;
+
+/** Representation of a record of the words found. */
+struct AhoHitsStruct {
+  /** Automaton searched with. */
+  AhoCorasick const *ac;
+  /** Search each state was last reported in, so it's reported once. */
+  int *seen;
+  /** Current search. */
+  int step;
+  /** Words found by the last search. */
+  int *found;
+};
+
+/**
+  Find the slot of the edge table for an edge, or the empty slot where
+  it would go.
+
+  @param ac automaton to look in.
+  @param key key of the edge.
+  @return index of the slot.
+*/
+static unsigned findSlot(AhoCorasick const *ac, int key)
+{
+  unsigned h = (unsigned) key * 0x9e3779b1u;
+  h = (h ^ (h >> 16)) & ac->edgeMask;
+  while (ac->edgeKey[h] != NONE && ac->edgeKey[h] != key){
+    h = (h + 1) & ac->edgeMask;
+  }
+  return h;
+}
+
+/**
+  Get the state reached by an edge of the trie.
+
+  @param ac automaton to look in.
+  @param state state the edge leaves.
+  @param c byte on the edge.
+  @return the state, or NONE if there's no such edge.
+*/
+static int followEdge(AhoCorasick const *ac, int state, unsigned char c)
+{
+  unsigned slot = findSlot(ac, state * BYTES + c);
+  return ac->edgeKey[slot] == NONE ? NONE : ac->edgeTo[slot];
+}
+
+/**
+  Get the state after a byte of input, following failure links until
+  there's an edge for it or a dense state is reached.
+
+  @param ac automaton to run.
+  @param state current state.
+  @param c next byte of input.
+  @return the next state.
+*/
+static int nextState(AhoCorasick const *ac, int state, unsigned char c)
+{
+  while (state >= ac->dense){
+    int to = followEdge(ac, state, c);
+    if (to != NONE){
+      return to;
+    }
+    state = ac->fail[state];
+  }
+  return ac->delta[state * ac->classes + ac->byteClass[c]];
+}
+
+/**
+  Get the state after a byte of input using only the trie and the
+  failure links, for filling in the automaton.
+
+  @param ac automaton to run.
+  @param state current state, with its failure links filled in.
+  @param c next byte of input.
+  @return the next state.
+*/
+static int trieState(AhoCorasick const *ac, int state, unsigned char c)
+{
+  while (true){
+    int to = followEdge(ac, state, c);
+    if (to != NONE){
+      return to;
+    }
+    if (state == 0){
+      return 0;
+    }
+    state = ac->fail[state];
+  }
+}
+
+/**
+  Build an automaton for the given words.
+
+  @param words words to look for, the automaton keeps its own copy.
+  @param count number of words.
+  @return A dynamically allocated automaton.
+*/
+AhoCorasick *makeAhoCorasick(char const *const *words, int count)
+{
+  AhoCorasick *ac = (AhoCorasick *) malloc(sizeof(AhoCorasick));
+  int *lens = (int *) malloc(count * sizeof(int));
+  int total = 0;
+  int longest = 0;
+  memset(ac->byteClass, 0, sizeof(ac->byteClass));
+  ac->classes = 1;
+  for (int i = 0; i < count; i++){
+    lens[i] = words[i] ? strlen(words[i]) : 0;
+    total += lens[i];
+    if (lens[i] > longest){
+      longest = lens[i];
+    }
+    for (int k = 0; k < lens[i]; k++){
+      unsigned char c = words[i][k];
+      if (!ac->byteClass[c]){
+        ac->byteClass[c] = ac->classes++;
+      }
+    }
+  }
+  unsigned size = MIN_EDGE_TABLE;
+  while (size < 2 * (unsigned) total){
+    size *= 2;
+  }
+  ac->words = count;
+  ac->edgeMask = size - 1;
+  ac->edgeKey = (int *) malloc(size * sizeof(int));
+  ac->edgeTo = (int *) malloc(size * sizeof(int));
+  memset(ac->edgeKey, 0xff, size * sizeof(int));
+  ac->fail = (int *) malloc((total + 1) * sizeof(int));
+  ac->first = (int *) malloc((total + 1) * sizeof(int));
+  ac->outLink = (int *) malloc((total + 1) * sizeof(int));
+  ac->next = (int *) malloc(count * sizeof(int));
+  // Parent and incoming byte of each state, for the failure links.
+  int *parent = (int *) malloc((total + 1) * sizeof(int));
+  unsigned char *byte = (unsigned char *) malloc(total + 1);
+
+  // Put the words in the trie a level at a time, so the states come out
+  // in breadth-first order.  at[ i ] is the state for the part of word
+  // i added so far.
+  int *at = (int *) calloc(count, sizeof(int));
+  ac->count = 1;
+  ac->first[0] = NONE;
+  for (int d = 0; d < longest; d++){
+    for (int i = 0; i < count; i++){
+      if (d >= lens[i]){
+        continue;
+      }
+      unsigned char c = words[i][d];
+      unsigned slot = findSlot(ac, at[i] * BYTES + c);
+      if (ac->edgeKey[slot] == NONE){
+        int to = ac->count++;
+        ac->first[to] = NONE;
+        parent[to] = at[i];
+        byte[to] = c;
+        ac->edgeKey[slot] = at[i] * BYTES + c;
+        ac->edgeTo[slot] = to;
+      }
+      at[i] = ac->edgeTo[slot];
+    }
+  }
+  for (int i = count - 1; i >= 0; i--){
+    if (lens[i] > 0){
+      ac->next[i] = ac->first[at[i]];
+      ac->first[at[i]] = i;
+    }
+  }
+
+  // Each state's failure link is shorter, so it's already filled in.
+  ac->fail[0] = 0;
+  ac->outLink[0] = NONE;
+  for (int s = 1; s < ac->count; s++){
+    int fail = parent[s] == 0 ? 0 : trieState(ac, ac->fail[parent[s]], byte[s]);
+    ac->fail[s] = fail;
+    ac->outLink[s] = ac->first[fail] != NONE ? fail : ac->outLink[fail];
+  }
+
+  // Fill in the rows of the shallowest states, taking each missing edge
+  // from the row of the state's failure link.
+  int rep[ BYTES ];
+  for (int c = 0; c < BYTES; c++){
+    rep[ac->byteClass[c]] = c;
+  }
+  ac->dense = ac->count < DENSE_BUDGET / ac->classes ? ac->count : DENSE_BUDGET / ac->classes;
+  ac->delta = (int *) malloc((size_t) ac->dense * ac->classes * sizeof(int));
+  for (int s = 0; s < ac->dense; s++){
+    for (int k = 0; k < ac->classes; k++){
+      int to = k == 0 ? NONE : followEdge(ac, s, rep[k]);
+      if (to == NONE){
+        to = s == 0 ? 0 : ac->delta[ac->fail[s] * ac->classes + k];
+      }
+      ac->delta[s * ac->classes + k] = to;
+    }
+  }
+
+  free(at);
+  free(byte);
+  free(parent);
+  free(lens);
+  ac->mapped = false;
+  return ac;
+}
+
+/**
+  Write the automaton to a file, in the form mapAhoCorasick() reads.
+  That's an AhoImage followed by the arrays, in the order they're in
+  the automaton.
+
+  @param ac automaton to write.
+  @param fp file to write to.
+  @return true if it was written.
+*/
+bool writeAhoCorasick(AhoCorasick const *ac, FILE *fp)
+{
+  AhoImage image = { ac->count, ac->words, ac->classes, ac->dense, ac->edgeMask };
+  memcpy(image.byteClass, ac->byteClass, sizeof(image.byteClass));
+  size_t edges = (size_t) ac->edgeMask + 1;
+  return fwrite(&image, sizeof(image), 1, fp) == 1 &&
+    fwrite(ac->delta, sizeof(int), (size_t) ac->dense * ac->classes, fp) == (size_t) ac->dense * ac->classes &&
+    fwrite(ac->edgeKey, sizeof(int), edges, fp) == edges &&
+    fwrite(ac->edgeTo, sizeof(int), edges, fp) == edges &&
+    fwrite(ac->fail, sizeof(int), ac->count, fp) == (size_t) ac->count &&
+    fwrite(ac->first, sizeof(int), ac->count, fp) == (size_t) ac->count &&
+    fwrite(ac->outLink, sizeof(int), ac->count, fp) == (size_t) ac->count &&
+    fwrite(ac->next, sizeof(int), ac->words, fp) == (size_t) ac->words;
+}
+
+/**
+  Use an automaton written by writeAhoCorasick() right where it is in
+  memory, without copying it.
+
+  @param data start of the automaton, aligned for an int.
+  @param size number of bytes at data.
+  @return A dynamically allocated automaton, or NULL if data doesn't
+          hold one.
+*/
+AhoCorasick *mapAhoCorasick(void const *data, size_t size)
+{
+  AhoImage const *image = (AhoImage const *) data;
+  if (size < sizeof(AhoImage) || image->count < 1 || image->words < 0 ||
+      image->classes < 1 || image->classes > BYTES ||
+      image->dense < 1 || image->dense > image->count ||
+      ((image->edgeMask + 1) & image->edgeMask) != 0){
+    return NULL;
+  }
+  size_t edges = (size_t) image->edgeMask + 1;
+  size_t ints = (size_t) image->dense * image->classes + 2 * edges +
+    3 * (size_t) image->count + image->words;
+  if ((size - sizeof(AhoImage)) / sizeof(int) < ints){
+    return NULL;
+  }
+  for (int c = 0; c < BYTES; c++){
+    if (image->byteClass[c] < 0 || image->byteClass[c] >= image->classes){
+      return NULL;
+    }
+  }
+
+  AhoCorasick *ac = (AhoCorasick *) malloc(sizeof(AhoCorasick));
+  ac->count = image->count;
+  ac->words = image->words;
+  ac->classes = image->classes;
+  ac->dense = image->dense;
+  ac->edgeMask = image->edgeMask;
+  memcpy(ac->byteClass, image->byteClass, sizeof(ac->byteClass));
+  int *array = (int *) (image + 1);
+  ac->delta = array;
+  array += (size_t) ac->dense * ac->classes;
+  ac->edgeKey = array;
+  array += edges;
+  ac->edgeTo = array;
+  array += edges;
+  ac->fail = array;
+  array += ac->count;
+  ac->first = array;
+  array += ac->count;
+  ac->outLink = array;
+  array += ac->count;
+  ac->next = array;
+  ac->mapped = true;
+  return ac;
+}
+
+/**
+  Get the number of states in the automaton.
+
+  @param ac automaton to look at.
+  @return the number of states, counting the start state.
+*/
+int ahoStates(AhoCorasick const *ac)
+{
+  return ac->count;
+}
+
+/**
+  Make a record of the words found, for one thread to use with the
+  given automaton.
+
+  @param ac automaton the record is for, it must outlive the record.
+  @return A dynamically allocated record.
+*/
+AhoHits *makeAhoHits(AhoCorasick const *ac)
+{
+  AhoHits *hits = (AhoHits *) malloc(sizeof(AhoHits));
+  hits->ac = ac;
+  hits->seen = (int *) calloc(ac->count, sizeof(int));
+  hits->step = 0;
+  hits->found = (int *) malloc(ac->words * sizeof(int));
+  return hits;
+}
+
+/**
+  Find the words that occur in the given string.
+
+  @param hits record for the thread, the list of words found is kept in it.
+  @param str string to search.
+  @param len length of str.
+  @param found set to the list of words found, good until the next search.
+  @return the number of words found.
+*/
+int findAhoWords(AhoHits *hits, char const *str, int len, int const **found)
+{
+  AhoCorasick const *ac = hits->ac;
+  if (++hits->step == 0){
+    // The counter wrapped around, forget the old searches for real.
+    memset(hits->seen, 0, ac->count * sizeof(int));
+    hits->step = 1;
+  }
+
+  int n = 0;
+  int state = 0;
+  for (int k = 0; k < len; k++){
+    state = nextState(ac, state, str[k]);
+    // Report the words ending here.  Once a state has been reported,
+    // so has everything further along its output links.
+    int out = ac->first[state] != NONE ? state : ac->outLink[state];
+    while (out != NONE && hits->seen[out] != hits->step){
+      hits->seen[out] = hits->step;
+      for (int w = ac->first[out]; w != NONE; w = ac->next[w]){
+        hits->found[n++] = w;
+      }
+      out = ac->outLink[out];
+    }
+  }
+  *found = hits->found;
+  return n;
+}
+
+/**
+  Free the given record.
+
+  @param hits record to free.
+*/
+void freeAhoHits(AhoHits *hits)
+{
+  free(hits->seen);
+  free(hits->found);
+  free(hits);
+}
+
+/**
+  Free the given automaton.
+
+  @param ac automaton to free.
+*/
+void freeAhoCorasick(AhoCorasick *ac)
+{
+  if (!ac->mapped){
+    free(ac->delta);
+    free(ac->edgeKey);
+    free(ac->edgeTo);
+    free(ac->fail);
+    free(ac->first);
+    free(ac->outLink);
+    free(ac->next);
+  }
+  free(ac);
+}
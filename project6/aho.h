@@ -0,0 +1,98 @@
+/**
+  This is the header file for the aho component, an Aho-Corasick
+  automaton that finds which of many literal words occur in a string in
+  one pass over it, however many words there are.  It's used to pick
+  the patterns worth checking on a line when there are several.
+
+  @file aho.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef AHO_H
+#define AHO_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/** A short name to use for the automaton, shared by every thread. */
+typedef struct AhoCorasickStruct AhoCorasick;
+
+/** A short name to use for one thread's record of the words found. */
+typedef struct AhoHitsStruct AhoHits;
+
+/**
+  Build an automaton for the given words.  Word i is reported as i, and
+  NULL or empty words are left out.
+
+  @param words words to look for, the automaton keeps its own copy.
+  @param count number of words.
+  @return A dynamically allocated automaton.
+*/
+AhoCorasick *makeAhoCorasick(char const *const *words, int count);
+
+/**
+  Get the number of states in the automaton.
+
+  @param ac automaton to look at.
+  @return the number of states, counting the start state.
+*/
+int ahoStates(AhoCorasick const *ac);
+
+/**
+  Write the automaton to a file, in the form mapAhoCorasick() reads.
+
+  @param ac automaton to write.
+  @param fp file to write to.
+  @return true if it was written.
+*/
+bool writeAhoCorasick(AhoCorasick const *ac, FILE *fp);
+
+/**
+  Use an automaton written by writeAhoCorasick() right where it is in
+  memory, such as in a memory mapped file, without copying it.
+
+  @param data start of the automaton, aligned for an int.  It must
+              outlive the automaton.
+  @param size number of bytes at data.
+  @return A dynamically allocated automaton, or NULL if data doesn't
+          hold one.
+*/
+AhoCorasick *mapAhoCorasick(void const *data, size_t size);
+
+/**
+  Make a record of the words found, for one thread to use with the
+  given automaton.
+
+  @param ac automaton the record is for, it must outlive the record.
+  @return A dynamically allocated record.
+*/
+AhoHits *makeAhoHits(AhoCorasick const *ac);
+
+/**
+  Find the words that occur in the given string.  Each word is reported
+  once, no matter how many times it occurs.
+
+  @param hits record for the thread, the list of words found is kept in it.
+  @param str string to search.
+  @param len length of str.
+  @param found set to the list of words found, good until the next search.
+  @return the number of words found.
+*/
+int findAhoWords(AhoHits *hits, char const *str, int len, int const **found);
+
+/**
+  Free the given record.
+
+  @param hits record to free.
+*/
+void freeAhoHits(AhoHits *hits);
+
+/**
+  Free the given automaton.
+
+  @param ac automaton to free.
+*/
+void freeAhoCorasick(AhoCorasick *ac);
+
+#endif
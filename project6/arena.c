@@ -0,0 +1,207 @@
+/**
+  Implementation of the arena component.  The arena is a list of blocks,
+  memory is handed out from the current one, moving on to the next (or a
+  new one) when it's full.  Blocks past the current one are kept for
+  reuse after a release or reset.
+
+  @file arena.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#include "arena.h"
+#include <stdlib.h>
+#include <stdio.h>
+
+// Size of the first block.
+#define INIT_BLOCK_SIZE (64 * 1024)
+
+// Every allocation is rounded up to a multiple of this.
+#define ARENA_ALIGN 16
+
+/** A block of memory the arena hands out pieces of. */
+typedef struct BlockStruct {
+  /** Next block in the arena, or NULL. */
+  struct BlockStruct *next;
+  /** Usable size of the block. */
+  size_t size;
+  /** Memory of the block, aligned like malloc() memory. */
+  union {
+    long double ld;
+    long long ll;
+    void *p;
+  } data[];
+} Block;
+
+/** Representation of an arena. */
+struct ArenaStruct {
+  /** First block. */
+  Block *first;
+  /** Block memory is currently handed out from. */
+  Block *current;
+  /** Bytes used in current. */
+  size_t used;
+  /** Bytes in use in the whole arena, counting what's skipped at block ends. */
+  size_t inUse;
+  /** Counters for the stats report. */
+  ArenaStats stats;
+};
+
+/**
+  Get a new block from the heap, exiting if there isn't enough memory
+  for it.  The table engine's match tables grow with the square of the
+  line length, so a long enough line can ask for more than there is.
+
+  @param arena arena the block is for.
+  @param size usable size of the block.
+  @return the block.
+*/
+static Block *makeBlock(Arena *arena, size_t size)
+{
+  Block *block = (Block *) malloc(sizeof(Block) + size);
+  if (!block){
+    fprintf(stderr, "Out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  block->next = NULL;
+  block->size = size;
+  arena->stats.heapBlocks++;
+  return block;
+}
+
+/**
+  Make an empty arena.
+
+  @return A dynamically allocated arena.
+*/
+Arena *makeArena()
+{
+  Arena *arena = (Arena *) calloc(1, sizeof(Arena));
+  arena->first = arena->current = makeBlock(arena, INIT_BLOCK_SIZE);
+  return arena;
+}
+
+/**
+  Allocate memory from the arena.  The memory isn't cleared, and it's
+  aligned for any type.
+
+  @param arena arena to allocate from.
+  @param size number of bytes needed.
+  @return pointer to the memory, good until the arena is reset.
+*/
+void *arenaAlloc(Arena *arena, size_t size)
+{
+  size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+  while (arena->current->size - arena->used < size){
+    // Skip the rest of this block, taking the next one if it's big
+    // enough or putting a new one in front of it.
+    arena->inUse += arena->current->size - arena->used;
+    Block *next = arena->current->next;
+    if (!next || next->size < size){
+      size_t blockSize = arena->current->size;
+      while (blockSize < size){
+        blockSize *= 2;
+      }
+      Block *block = makeBlock(arena, blockSize);
+      block->next = next;
+      arena->current->next = block;
+      next = block;
+    }
+    arena->current = next;
+    arena->used = 0;
+  }
+
+  void *mem = (char *) arena->current->data + arena->used;
+  arena->used += size;
+  arena->inUse += size;
+  arena->stats.allocations++;
+  arena->stats.bytes += size;
+  if (arena->inUse > arena->stats.peak){
+    arena->stats.peak = arena->inUse;
+  }
+  return mem;
+}
+
+/**
+  Remember the current position in the arena.
+
+  @param arena arena to look at.
+  @return the position.
+*/
+ArenaMark markArena(Arena const *arena)
+{
+  ArenaMark mark = { arena->current, arena->used, arena->inUse };
+  return mark;
+}
+
+/**
+  Give back everything allocated since the given mark, so it can be
+  used again.
+
+  @param arena arena to release memory in.
+  @param mark position returned by markArena().
+*/
+void releaseArena(Arena *arena, ArenaMark mark)
+{
+  arena->current = (Block *) mark.block;
+  arena->used = mark.used;
+  arena->inUse = mark.inUse;
+}
+
+/**
+  Give back everything allocated from the arena.  If it took more than
+  one block, they are merged into a single one big enough for all of
+  them, so the next line fits without more blocks.
+
+  @param arena arena to reset.
+*/
+void resetArena(Arena *arena)
+{
+  if (arena->first->next){
+    size_t total = 0;
+    Block *block = arena->first;
+    while (block){
+      Block *next = block->next;
+      total += block->size;
+      free(block);
+      block = next;
+    }
+    arena->first = makeBlock(arena, total);
+  }
+  arena->current = arena->first;
+  arena->used = 0;
+  arena->inUse = 0;
+  arena->stats.resets++;
+}
+
+/**
+  Add the arena's counters to a running total.
+
+  @param total totals to add to, peak is the largest of the peaks.
+  @param arena arena to add.
+*/
+void addArenaStats(ArenaStats *total, Arena const *arena)
+{
+  total->allocations += arena->stats.allocations;
+  total->bytes += arena->stats.bytes;
+  if (arena->stats.peak > total->peak){
+    total->peak = arena->stats.peak;
+  }
+  total->heapBlocks += arena->stats.heapBlocks;
+  total->resets += arena->stats.resets;
+}
+
+/**
+  Free the arena and all its blocks.
+
+  @param arena arena to free.
+*/
+void freeArena(Arena *arena)
+{
+  Block *block = arena->first;
+  while (block){
+    Block *next = block->next;
+    free(block);
+    block = next;
+  }
+  free(arena);
+}
@@ -0,0 +1,105 @@
+/**
+  This is the header file for the arena component, a bump allocator for
+  the scratch memory used while matching a line.  Everything allocated
+  for a line is thrown away at once by resetting the arena, so once the
+  arena has grown to fit the longest line, matching doesn't touch the
+  heap at all.
+
+  @file arena.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/** Counters for how an arena has been used. */
+typedef struct {
+  /** Number of allocations made from the arena. */
+  long allocations;
+  /** Total bytes handed out by those allocations. */
+  long long bytes;
+  /** Most bytes in use at once. */
+  size_t peak;
+  /** Number of blocks the arena got from the heap. */
+  long heapBlocks;
+  /** Number of times the arena was reset. */
+  long resets;
+} ArenaStats;
+
+/** A short name to use for the arena. */
+typedef struct ArenaStruct Arena;
+
+/**
+  A position in an arena, everything allocated after it can be given
+  back with releaseArena().
+*/
+typedef struct {
+  /** Block in use at the time. */
+  void *block;
+  /** Bytes used in that block. */
+  size_t used;
+  /** Bytes in use in the whole arena. */
+  size_t inUse;
+} ArenaMark;
+
+/**
+  Make an empty arena.
+
+  @return A dynamically allocated arena.
+*/
+Arena *makeArena();
+
+/**
+  Allocate memory from the arena.  The memory isn't cleared, and it's
+  aligned for any type.
+
+  @param arena arena to allocate from.
+  @param size number of bytes needed.
+  @return pointer to the memory, good until the arena is reset.
+*/
+void *arenaAlloc(Arena *arena, size_t size);
+
+/**
+  Remember the current position in the arena.
+
+  @param arena arena to look at.
+  @return the position.
+*/
+ArenaMark markArena(Arena const *arena);
+
+/**
+  Give back everything allocated since the given mark, so it can be
+  used again.
+
+  @param arena arena to release memory in.
+  @param mark position returned by markArena().
+*/
+void releaseArena(Arena *arena, ArenaMark mark);
+
+/**
+  Give back everything allocated from the arena.  If it took more than
+  one block, they are merged into a single one big enough for all of
+  them, so the next line fits without more blocks.
+
+  @param arena arena to reset.
+*/
+void resetArena(Arena *arena);
+
+/**
+  Add the arena's counters to a running total.
+
+  @param total totals to add to, peak is the largest of the peaks.
+  @param arena arena to add.
+*/
+void addArenaStats(ArenaStats *total, Arena const *arena);
+
+/**
+  Free the arena and all its blocks.
+
+  @param arena arena to free.
+*/
+void freeArena(Arena *arena);
+
+#endif
@@ -0,0 +1,54 @@
+#!/bin/bash
+# Corpus generator shared by the benchmark scripts, which source this
+# file.  Corpora are made with a fixed seed, so every run of a script
+# searches the same text.
+
+# Generate a corpus once for each kind and size, and warm the page cache
+# so every run reads from memory.  The name records the kind and size,
+# so changing either makes a new one.
+#   logs    log lines, about one ERROR line in a hundred.
+#   sparse  log lines, about one ERROR line in a thousand.
+#   long    minified JSON, a megabyte of records on each line.
+#   path    short runs of a, for the pathological pattern (a|aa)*b.
+#   run     a single line of a, for highlighting every a with a.*b|a.
+# $1 = corpus kind, $2 = size in bytes.  Sets CORPUS to the file's name.
+generate() {
+  CORPUS=bench-$1-$2.txt
+  if [ ! -f $CORPUS ]; then
+    echo "Generating $CORPUS" >&2
+    awk -v kind=$1 -v bytes=$2 'BEGIN {
+      srand(230);
+      split("INFO WARN DEBUG TRACE", level, " ");
+      split("disk net cpu mem", part, " ");
+      split("alice bob carol dave", user, " ");
+      errors = kind == "sparse" ? 1000 : 100;
+      while (total < bytes) {
+        if (kind == "logs" || kind == "sparse") {
+          if (int(rand() * errors) == 0)
+            line = sprintf("2020-04-%02d ERROR %d %s failure on node %d", rand() * 28 + 1, rand() * 1000, part[int(rand() * 4) + 1], rand() * 64);
+          else
+            line = sprintf("2020-04-%02d %s request %d served in %d ms from cache %s", rand() * 28 + 1, level[int(rand() * 4) + 1], rand() * 100000, rand() * 500, part[int(rand() * 4) + 1]);
+        } else if (kind == "long") {
+          line = "[";
+          while (length(line) < 1048576)
+            line = line sprintf("{\"id\":\"%08x\",\"user\":\"%s\",\"status\":%d,\"ms\":%d},", rand() * 4294967295, user[int(rand() * 4) + 1], (int(rand() * 50) == 0) ? 500 : 200, rand() * 500);
+          line = line "{}]";
+        } else if (kind == "run") {
+          line = "";
+          while (length(line) < bytes - 1)
+            line = line "a";
+        } else {
+          # Runs of a that (a|aa)*b has many ways to split up, and no b.
+          line = "";
+          n = int(rand() * 8) + 16;
+          for (i = 0; i < n; i++)
+            line = line "a";
+          line = line "c";
+        }
+        print line;
+        total += length(line) + 1;
+      }
+    }' > $CORPUS
+  fi
+  cat $CORPUS > /dev/null
+}
@@ -0,0 +1,39 @@
+#!/bin/bash
+# Compare the matching engines on a generated log file, the recursive
+# match tables against the compiled Pike VM and lazy DFA.
+# Usage: ./bench-engines.sh [size-in-MB]
+SIZE_MB=${1:-4}
+
+make
+if [ $? -ne 0 ] || [ ! -x ugrep ]; then
+  echo "**** Make (compilation) FAILED"
+  exit 13
+fi
+
+# About one matching line in a hundred.
+. ./bench-corpus.sh
+generate logs $(( SIZE_MB * 1048576 ))
+
+echo "pattern,engine,seconds,MB/s"
+for PATTERN in 'ERROR' 'ERROR [0-9]+ (disk|net)' '[0-9]+ ms' '(a|e)[^ ]*r'; do
+  for ENGINE in table pike dfa; do
+    START=$(date +%s.%N)
+    ./ugrep -j 1 --engine=$ENGINE "$PATTERN" $CORPUS > /dev/null
+    END=$(date +%s.%N)
+    SECONDS_TAKEN=$(awk "BEGIN { print $END - $START }")
+    awk "BEGIN { printf \"\\\"%s\\\",%s,%.3f,%.1f\\n\", \"$PATTERN\", \"$ENGINE\", $SECONDS_TAKEN, $SIZE_MB / $SECONDS_TAKEN }"
+  done
+done
+
+# Every a on one long line is a separate match of a.*b|a, and every one
+# of them starts a thread that runs to the end of the line looking for
+# a b.  Highlighting them has to stay linear in the line length.  The
+# table engine's match tables are quadratic in it, so it's left out.
+generate run 40000
+for ENGINE in pike dfa; do
+  START=$(date +%s.%N)
+  ./ugrep -j 1 --engine=$ENGINE 'a.*b|a' $CORPUS > /dev/null
+  END=$(date +%s.%N)
+  SECONDS_TAKEN=$(awk "BEGIN { print $END - $START }")
+  awk "BEGIN { printf \"\\\"a.*b|a\\\" (40KB line),%s,%.3f,%.1f\\n\", \"$ENGINE\", $SECONDS_TAKEN, 40000 / 1048576 / $SECONDS_TAKEN }"
+done
@@ -0,0 +1,28 @@
+#!/bin/bash
+# Measure how ugrep scales with the number of worker threads (-j) on a
+# generated log file.  Usage: ./bench-threads.sh [size-in-MB] [pattern]
+SIZE_MB=${1:-512}
+PATTERN=${2:-'ERROR [0-9]+ (disk|net)'}
+
+make
+if [ $? -ne 0 ] || [ ! -x ugrep ]; then
+  echo "**** Make (compilation) FAILED"
+  exit 13
+fi
+
+# About one matching line in a thousand.
+. ./bench-corpus.sh
+generate sparse $(( SIZE_MB * 1048576 ))
+
+echo "threads,seconds,MB/s,speedup"
+BASE=
+for THREADS in 1 2 4 8 16 32; do
+  START=$(date +%s.%N)
+  ./ugrep -j $THREADS "$PATTERN" $CORPUS > /dev/null
+  END=$(date +%s.%N)
+  SECONDS_TAKEN=$(awk "BEGIN { print $END - $START }")
+  if [ -z "$BASE" ]; then
+    BASE=$SECONDS_TAKEN
+  fi
+  awk "BEGIN { printf \"%d,%.3f,%.1f,%.2f\\n\", $THREADS, $SECONDS_TAKEN, $SIZE_MB / $SECONDS_TAKEN, $BASE / $SECONDS_TAKEN }"
+done
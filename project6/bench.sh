@@ -0,0 +1,191 @@
+#!/bin/bash
+# Measure ugrep's throughput for each engine and output mode on generated
+# corpora: ordinary log lines, a few very long lines, and short lines
+# made for a pathological pattern.  Results are written as CSV or JSON
+# with MB/s and lines/s for each run, and compared against a stored
+# baseline, failing if any run got slower than the tolerance allows.
+#
+# Usage: ./bench.sh [-f csv|json] [-s size-in-MB] [-r runs]
+#                   [-b baseline-file] [-t tolerance-percent] [-u]
+#   -f  output format, csv by default.
+#   -s  size of the log and long line corpora, 8MB by default.  The
+#       pathological corpus is an eighth of that.
+#   -r  number of times each case is run, the fastest one counts.
+#   -b  baseline to compare against, bench-baseline.csv by default.
+#   -t  allowed drop in MB/s from the baseline, 10 percent by default.
+#   -u  save this run's results as the new baseline.
+FORMAT=csv
+SIZE_MB=8
+RUNS=3
+BASELINE=bench-baseline.csv
+TOLERANCE=10
+UPDATE=0
+
+# Longest a single run may take, cases that run over are reported as
+# timeouts instead of holding up the whole suite.
+LIMIT=60
+
+while getopts "f:s:r:b:t:u" OPT; do
+  case $OPT in
+    f) FORMAT=$OPTARG ;;
+    s) SIZE_MB=$OPTARG ;;
+    r) RUNS=$OPTARG ;;
+    b) BASELINE=$OPTARG ;;
+    t) TOLERANCE=$OPTARG ;;
+    u) UPDATE=1 ;;
+    *) echo "usage: ./bench.sh [-f csv|json] [-s size-in-MB] [-r runs] [-b baseline-file] [-t tolerance-percent] [-u]" >&2
+       exit 1 ;;
+  esac
+done
+if [ "$FORMAT" != csv ] && [ "$FORMAT" != json ]; then
+  echo "Unknown format: $FORMAT" >&2
+  exit 1
+fi
+
+make >&2
+if [ $? -ne 0 ] || [ ! -x ugrep ]; then
+  echo "**** Make (compilation) FAILED" >&2
+  exit 13
+fi
+
+. ./bench-corpus.sh
+generate logs $(( SIZE_MB * 1048576 ))
+LOGS=$CORPUS
+generate long $(( SIZE_MB * 1048576 ))
+LONG=$CORPUS
+# The table engine is slow on the pathological lines, so there are fewer.
+generate path $(( SIZE_MB * 131072 ))
+PATH_CORPUS=$CORPUS
+
+# Each case is a name, a corpus, the engines to run and a pattern.  The
+# table engine's match table is quadratic in the length of a line, so
+# it's left out on the long lines.
+CASES=(
+  "literal|$LOGS|table pike dfa|ERROR"
+  "regex|$LOGS|table pike dfa|ERROR [0-9]+ (disk|net)"
+  "dense|$LOGS|table pike dfa|[0-9]+ ms"
+  "none|$LOGS|table pike dfa|panic: [a-z]+"
+  "long|$LONG|pike dfa|\"user\":\"(alice|bob)\",\"status\":5"
+  "pathological|$PATH_CORPUS|table pike dfa|(a|aa)*b"
+)
+
+RESULTS=$(mktemp)
+for CASE in "${CASES[@]}"; do
+  NAME=${CASE%%|*}
+  REST=${CASE#*|}
+  CORPUS=${REST%%|*}
+  REST=${REST#*|}
+  ENGINES=${REST%%|*}
+  PATTERN=${REST#*|}
+  BYTES=$(stat -c %s $CORPUS)
+  LINES=$(wc -l < $CORPUS)
+  for ENGINE in $ENGINES; do
+    # Highlighted output, and counting lines with -c, which needn't find
+    # where the matches are.
+    for MODE in print count; do
+      FLAGS=
+      if [ $MODE = count ]; then
+        FLAGS=-c
+      fi
+      BEST=
+      for (( RUN = 0; RUN < RUNS; RUN++ )); do
+        START=$(date +%s.%N)
+        timeout $LIMIT ./ugrep -j 1 --engine=$ENGINE $FLAGS "$PATTERN" $CORPUS > /dev/null
+        STATUS=$?
+        END=$(date +%s.%N)
+        if [ $STATUS -eq 124 ]; then
+          BEST=timeout
+          break
+        fi
+        BEST=$(awk "BEGIN { t = $END - $START; print (\"$BEST\" == \"\" || t < $BEST + 0) ? t : \"$BEST\" }")
+      done
+      # Patterns have | in them, so fields are separated by tabs.
+      printf "%s\t%s\t%s\t%s\t%s\t%s\t%s\n" $NAME $ENGINE $MODE $BYTES $LINES $BEST "$PATTERN" >> $RESULTS
+    done
+  done
+done
+
+# Report every run, in the chosen format.
+awk -F'\t' -v format=$FORMAT '
+function quote(s) {
+  gsub(/\\/, "\\\\", s);
+  gsub(/"/, "\\\"", s);
+  return "\"" s "\"";
+}
+BEGIN {
+  if (format == "csv")
+    print "case,engine,mode,MB,lines,seconds,MB/s,lines/s";
+  else
+    print "[";
+}
+{
+  mb = $4 / 1048576;
+  if ($6 == "timeout") {
+    seconds = "timeout";
+    mbs = 0;
+    lps = 0;
+  } else {
+    seconds = sprintf("%.3f", $6);
+    # Runs too fast for the clock still get a finite rate.
+    t = $6 > 0.001 ? $6 : 0.001;
+    mbs = mb / t;
+    lps = $5 / t;
+  }
+  if (format == "csv")
+    printf "%s,%s,%s,%.1f,%d,%s,%.1f,%.0f\n", $1, $2, $3, mb, $5, seconds, mbs, lps;
+  else
+    printf("%s  {\"case\": %s, \"pattern\": %s, \"engine\": \"%s\", \"mode\": \"%s\", \"MB\": %.1f, \"lines\": %d, \"seconds\": %s, \"MB/s\": %.1f, \"lines/s\": %.0f}", NR > 1 ? ",\n" : "", quote($1), quote($7), $2, $3, mb, $5, seconds == "timeout" ? "null" : seconds, mbs, lps);
+}
+END {
+  if (format == "json")
+    print "\n]";
+}' $RESULTS > $RESULTS.out
+cat $RESULTS.out
+
+# Compare MB/s against the baseline, a CSV file from an earlier run.
+FAIL=0
+if [ $UPDATE -eq 1 ]; then
+  if [ $FORMAT = csv ]; then
+    cp $RESULTS.out $BASELINE
+  else
+    awk -F'\t' 'BEGIN { print "case,engine,mode,MB/s" }
+               { t = $6 == "timeout" ? 0 : ($6 > 0.001 ? $6 : 0.001);
+                 printf "%s,%s,%s,%.1f\n", $1, $2, $3, t ? $4 / 1048576 / t : 0 }' $RESULTS > $BASELINE
+  fi
+  echo "Saved baseline in $BASELINE" >&2
+elif [ -f $BASELINE ]; then
+  awk -F'\t' -v tolerance=$TOLERANCE -v baseline=$BASELINE '
+  BEGIN {
+    # The baseline has the case, engine and mode first, and MB/s in the
+    # column with that heading.
+    getline header < baseline;
+    n = split(header, name, ",");
+    for (i = 1; i <= n; i++)
+      if (name[i] == "MB/s")
+        column = i;
+    while ((getline line < baseline) > 0) {
+      split(line, field, ",");
+      base[field[1] "," field[2] "," field[3]] = field[column];
+    }
+  }
+  {
+    key = $1 "," $2 "," $3;
+    if (!(key in base) || base[key] == 0)
+      next;
+    t = $6 == "timeout" ? 0 : ($6 > 0.001 ? $6 : 0.001);
+    mbs = t ? $4 / 1048576 / t : 0;
+    if (mbs < base[key] * (1 - tolerance / 100)) {
+      printf("**** REGRESSION %s %s %s: %.1f MB/s, baseline %.1f MB/s\n", $1, $2, $3, mbs, base[key]) > "/dev/stderr";
+      failed = 1;
+    }
+  }
+  END { exit failed }' $RESULTS
+  FAIL=$?
+fi
+
+rm -f $RESULTS $RESULTS.out
+if [ $FAIL -ne 0 ]; then
+  echo "Throughput dropped below the baseline in $BASELINE" >&2
+  exit 13
+fi
+exit 0
@@ -0,0 +1,160 @@
+/**
+  Implementation of the byteset component.  The vector search looks up
+  every byte of a block with two byte shuffles, one for bytes below 128
+  and one for bytes above, that give the entry for the byte's low
+  nibble.  A third shuffle turns the high nibble into the bit to test
+  in that entry.
+
+  @file byteset.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#include "byteset.h"
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_SHUFFLE_KERNEL
+#endif
+
+/** Kernels the search can use, best last. */
+typedef enum { SCALAR_KERNEL, SSSE3_KERNEL, AVX2_KERNEL } Kernel;
+
+/**
+  Make the set empty.
+
+  @param set set to clear.
+*/
+void clearByteSet(ByteSet *set)
+{
+  memset(set, 0, sizeof(ByteSet));
+}
+
+/**
+  Add a byte to the set.
+
+  @param set set to add to.
+  @param c byte to add.
+*/
+void addByte(ByteSet *set, unsigned char c)
+{
+  set->bits[c / 64] |= (uint64_t) 1 << (c % 64);
+  set->nibbles[c >> 7][c & 0x0f] |= 1 << ((c >> 4) & 7);
+}
+
+/**
+  Replace the set with every byte that isn't in it.
+
+  @param set set to invert.
+*/
+void invertByteSet(ByteSet *set)
+{
+  // Each bit of either representation stands for exactly one byte.
+  for (int i = 0; i < BYTE_VALUES / 64; i++){
+    set->bits[i] = ~set->bits[i];
+  }
+  for (int h = 0; h < 2; h++){
+    for (int lo = 0; lo < 16; lo++){
+      set->nibbles[h][lo] = ~set->nibbles[h][lo];
+    }
+  }
+}
+
+/**
+  Search a byte at a time.
+
+  @param set set of bytes to look for.
+  @param str string to search.
+  @param from index to start at.
+  @param len length of str.
+  @return index of the byte found, or len if there's none.
+*/
+static int findScalar(ByteSet const *set, char const *str, int from, int len)
+{
+  while (from < len && !inByteSet(set, str[from])){
+    from++;
+  }
+  return from;
+}
+
+#ifdef HAVE_SHUFFLE_KERNEL
+// Search 16 bytes at a time.
+__attribute__((target("ssse3")))
+static int findSSSE3(ByteSet const *set, char const *str, int from, int len)
+{
+  __m128i below = _mm_loadu_si128((__m128i const *) set->nibbles[0]);
+  __m128i above = _mm_loadu_si128((__m128i const *) set->nibbles[1]);
+  __m128i bit = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                              1, 2, 4, 8, 16, 32, 64, -128);
+  __m128i low = _mm_set1_epi8(0x0f);
+  __m128i flip = _mm_set1_epi8(-128);
+  for (; from + 16 <= len; from += 16){
+    __m128i v = _mm_loadu_si128((__m128i const *) (str + from));
+    // A shuffle gives zero for lanes with the top bit set, so each
+    // table only answers for its own half of the bytes.
+    __m128i entry = _mm_or_si128(_mm_shuffle_epi8(below, v),
+                                 _mm_shuffle_epi8(above, _mm_xor_si128(v, flip)));
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low);
+    __m128i hit = _mm_and_si128(entry, _mm_shuffle_epi8(bit, hi));
+    int mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(hit, _mm_setzero_si128())) & 0xffff;
+    if (mask){
+      return from + __builtin_ctz(mask);
+    }
+  }
+  return findScalar(set, str, from, len);
+}
+
+// Search 32 bytes at a time, the same way.
+__attribute__((target("avx2")))
+static int findAVX2(ByteSet const *set, char const *str, int from, int len)
+{
+  __m256i below = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *) set->nibbles[0]));
+  __m256i above = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i const *) set->nibbles[1]));
+  __m256i bit = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128,
+                                 1, 2, 4, 8, 16, 32, 64, -128,
+                                 1, 2, 4, 8, 16, 32, 64, -128,
+                                 1, 2, 4, 8, 16, 32, 64, -128);
+  __m256i low = _mm256_set1_epi8(0x0f);
+  __m256i flip = _mm256_set1_epi8(-128);
+  for (; from + 32 <= len; from += 32){
+    __m256i v = _mm256_loadu_si256((__m256i const *) (str + from));
+    __m256i entry = _mm256_or_si256(_mm256_shuffle_epi8(below, v),
+                                    _mm256_shuffle_epi8(above, _mm256_xor_si256(v, flip)));
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+    __m256i hit = _mm256_and_si256(entry, _mm256_shuffle_epi8(bit, hi));
+    unsigned mask = ~(unsigned) _mm256_movemask_epi8(_mm256_cmpeq_epi8(hit, _mm256_setzero_si256()));
+    if (mask){
+      return from + __builtin_ctz(mask);
+    }
+  }
+  return findSSSE3(set, str, from, len);
+}
+#endif
+
+/**
+  Find the first byte of str at or after from that's in the set.  This
+  looks at 32 or 16 bytes at a time when the processor has AVX2 or
+  SSSE3, picked the first time it's called.
+
+  @param set set of bytes to look for.
+  @param str string to search.
+  @param from index to start at.
+  @param len length of str.
+  @return index of the byte found, or len if there's none.
+*/
+int findByteInSet(ByteSet const *set, char const *str, int from, int len)
+{
+#ifdef HAVE_SHUFFLE_KERNEL
+  static int kernel = -1;
+  if (kernel < 0){
+    kernel = __builtin_cpu_supports("avx2") ? AVX2_KERNEL
+      : __builtin_cpu_supports("ssse3") ? SSSE3_KERNEL : SCALAR_KERNEL;
+  }
+  if (kernel == AVX2_KERNEL){
+    return findAVX2(set, str, from, len);
+  } else if (kernel == SSSE3_KERNEL){
+    return findSSSE3(set, str, from, len);
+  }
+#endif
+  return findScalar(set, str, from, len);
+}
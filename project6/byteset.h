@@ -0,0 +1,81 @@
+/**
+  This is the header file for the byteset component, sets of byte
+  values used for the single-character atoms of a pattern (literals,
+  '.' and character classes), with a fast search for the next byte of
+  a string that's in a set.
+
+  @file byteset.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef BYTESET_H
+#define BYTESET_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Number of possible byte values. */
+#define BYTE_VALUES 256
+
+/**
+  A set of byte values, as a 256-bit membership bitmap.  The same set is
+  also kept as two 16-entry tables indexed by the low four bits of a
+  byte, for the vector search.  Entry lo of nibbles[ h ] has bit
+  hi % 8 set if the byte hi * 16 + lo is in the set, where h is 0 for
+  hi < 8 and 1 otherwise.
+*/
+typedef struct {
+  /** Bit c % 64 of bits[ c / 64 ] is set if c is in the set. */
+  uint64_t bits[ BYTE_VALUES / 64 ];
+  /** Membership by low nibble, for bytes below and above 128. */
+  uint8_t nibbles[ 2 ][ 16 ];
+} ByteSet;
+
+/**
+  Make the set empty.
+
+  @param set set to clear.
+*/
+void clearByteSet(ByteSet *set);
+
+/**
+  Add a byte to the set.
+
+  @param set set to add to.
+  @param c byte to add.
+*/
+void addByte(ByteSet *set, unsigned char c);
+
+/**
+  Replace the set with every byte that isn't in it.
+
+  @param set set to invert.
+*/
+void invertByteSet(ByteSet *set);
+
+/**
+  Check if a byte is in the set.
+
+  @param set set to look in.
+  @param c byte to look for.
+  @return true if c is in the set.
+*/
+static inline bool inByteSet(ByteSet const *set, unsigned char c)
+{
+  return (set->bits[c / 64] >> (c % 64)) & 1;
+}
+
+/**
+  Find the first byte of str at or after from that's in the set.  This
+  looks at 32 or 16 bytes at a time when the processor has AVX2 or
+  SSSE3, picked the first time it's called.
+
+  @param set set of bytes to look for.
+  @param str string to search.
+  @param from index to start at.
+  @param len length of str.
+  @return index of the byte found, or len if there's none.
+*/
+int findByteInSet(ByteSet const *set, char const *str, int from, int len);
+
+#endif
@@ -0,0 +1,407 @@
+/**
+  Implementation of the cache component.  A compiled pattern file is a
+  header, a table of the patterns, their instructions, the byte sets of
+  their OP_CLASS instructions, their literals, and the literal
+  automaton.  Every section starts at a multiple of CACHE_ALIGN bytes,
+  so everything in it can be used straight from a memory mapping.  The
+  file is only good for the build that wrote it, and the version number
+  is changed along with anything that's saved.
+
+  @file cache.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#include "cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Marks the start of a compiled pattern file.
+#define CACHE_MAGIC "UGREPCPF"
+
+// Version of the file layout and of what the patterns compile to.
+#define CACHE_VERSION 2
+
+// Sections of the file start at multiples of this.
+#define CACHE_ALIGN 8
+
+// Set index of an instruction with no byte set.
+#define NO_SET -1
+
+// Starting value and multiplier for the FNV-1a checksum.
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME 1099511628211ULL
+
+/** Start of a compiled pattern file, giving where each section is. */
+typedef struct {
+  /** CACHE_MAGIC, without its NUL. */
+  char magic[ 8 ];
+  /** CACHE_VERSION. */
+  uint32_t version;
+  /** Number of patterns. */
+  uint32_t count;
+  /** Checksum of the pattern strings. */
+  uint64_t checksum;
+  /** Checksum of everything after the header, so a damaged file isn't used. */
+  uint64_t bodyChecksum;
+  /** Size of the whole file. */
+  uint64_t size;
+  /** Offset and number of instructions, for every pattern together. */
+  uint64_t instOffset, instCount;
+  /** Offset and number of byte sets. */
+  uint64_t setOffset, setCount;
+  /** Offset and size of the literals, each ending in a NUL. */
+  uint64_t textOffset, textSize;
+  /** Offset and size of the automaton, the size is 0 if there isn't one. */
+  uint64_t acOffset, acSize;
+} CacheHeader;
+
+/** Entry in the table of patterns, which comes right after the header. */
+typedef struct {
+  /** Index of the pattern's first instruction. */
+  uint32_t firstInst;
+  /** Number of instructions in the pattern's program. */
+  uint32_t instCount;
+  /** Offset of the pattern's literal in the literals section. */
+  uint32_t literal;
+  /** Unused, keeps entries a multiple of CACHE_ALIGN. */
+  uint32_t unused;
+} CachePattern;
+
+/** A saved instruction. */
+typedef struct {
+  /** Opcode. */
+  uint8_t op;
+  /** Byte matched by OP_CHAR. */
+  uint8_t c;
+  /** Unused. */
+  uint16_t unused;
+  /** Index of the byte set of an OP_CLASS, or NO_SET. */
+  int32_t set;
+  /** Branch targets. */
+  int32_t x, y;
+} CacheInstruction;
+
+/**
+  Add a pattern string to the checksum of a list of them, starting from
+  FNV_OFFSET.  The NULs between them are included, so moving text from
+  one to the next changes the checksum.
+
+  @param h checksum of the patterns before this one.
+  @param pstr pattern string.
+  @return the checksum with pstr added.
+*/
+static uint64_t addChecksum(uint64_t h, char const *pstr)
+{
+  do {
+    h = (h ^ (unsigned char) *pstr) * FNV_PRIME;
+  } while (*pstr++);
+  return h;
+}
+
+/**
+  Compute the checksum of the part of a file after its header, a word at
+  a time so it's cheap next to compiling the patterns again.
+
+  @param body start of the part after the header, aligned for a uint64_t.
+  @param size size of the part, a multiple of CACHE_ALIGN.
+  @return the checksum.
+*/
+static uint64_t bodyChecksum(void const *body, size_t size)
+{
+  uint64_t const *word = (uint64_t const *) body;
+  uint64_t h = FNV_OFFSET;
+  for (size_t i = 0; i < size / sizeof(uint64_t); i++){
+    h = (h ^ word[i]) * FNV_PRIME;
+  }
+  return h;
+}
+
+/**
+  Write zero bytes until the file position is a multiple of CACHE_ALIGN.
+
+  @param fp file being written.
+  @return the new position.
+*/
+static long alignFile(FILE *fp)
+{
+  long pos = ftell(fp);
+  while (pos % CACHE_ALIGN){
+    fputc(0, fp);
+    pos++;
+  }
+  return pos;
+}
+
+/**
+  Save the compiled programs, literals and literal automaton of the
+  search to a file.
+
+  @param search search to save.
+  @param name name of the file.
+  @return true if the file was written.
+*/
+bool saveCompiled(Search const *search, char const *name)
+{
+  int count = search->count;
+  // The table engine doesn't keep prefilters, so they may have to be
+  // worked out again.
+  char **literals = (char **) malloc(count * sizeof(char *));
+  for (int i = 0; i < count; i++){
+    SearchPattern const *sp = search->pats + i;
+    Prefilter *pf = sp->pf ? sp->pf : sp->pat ? makePrefilter(sp->pat) : NULL;
+    char const *literal = pf ? prefilterLiteral(pf) : "";
+    literals[i] = (char *) malloc(strlen(literal) + 1);
+    strcpy(literals[i], literal);
+    if (pf && pf != sp->pf){
+      freePrefilter(pf);
+    }
+  }
+  AhoCorasick *ac = search->ac;
+  if (!ac && count > 1){
+    ac = makeAhoCorasick((char const *const *) literals, count);
+  }
+
+  char tmpName[strlen(name) + 5];
+  sprintf(tmpName, "%s.tmp", name);
+  FILE *fp = fopen(tmpName, "w+b");
+  bool ok = fp != NULL;
+  if (ok){
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    uint32_t insts = 0;
+    uint32_t text = 0;
+    for (int i = 0; i < count; i++){
+      CachePattern cp = { insts, search->pats[i].prog->count, text, 0 };
+      ok = ok && fwrite(&cp, sizeof(cp), 1, fp) == 1;
+      insts += cp.instCount;
+      text += strlen(literals[i]) + 1;
+    }
+
+    header.instOffset = ftell(fp);
+    header.instCount = insts;
+    int32_t sets = 0;
+    for (int i = 0; i < count; i++){
+      Program const *prog = search->pats[i].prog;
+      for (int pc = 0; pc < prog->count; pc++){
+        Instruction const *inst = prog->code + pc;
+        CacheInstruction ci = { inst->op, inst->c, 0,
+                                inst->op == OP_CLASS ? sets++ : NO_SET,
+                                inst->x, inst->y };
+        ok = ok && fwrite(&ci, sizeof(ci), 1, fp) == 1;
+      }
+    }
+
+    header.setOffset = ftell(fp);
+    header.setCount = sets;
+    for (int i = 0; i < count; i++){
+      Program const *prog = search->pats[i].prog;
+      for (int pc = 0; pc < prog->count; pc++){
+        if (prog->code[pc].op == OP_CLASS){
+          ok = ok && fwrite(prog->code[pc].set, sizeof(ByteSet), 1, fp) == 1;
+        }
+      }
+    }
+
+    header.textOffset = ftell(fp);
+    header.textSize = text;
+    for (int i = 0; i < count; i++){
+      size_t len = strlen(literals[i]) + 1;
+      ok = ok && fwrite(literals[i], 1, len, fp) == len;
+    }
+
+    header.acOffset = alignFile(fp);
+    if (ac){
+      ok = ok && writeAhoCorasick(ac, fp);
+      header.acSize = ftell(fp) - header.acOffset;
+    }
+
+    header.size = alignFile(fp);
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.version = CACHE_VERSION;
+    header.count = count;
+    header.checksum = FNV_OFFSET;
+    for (int i = 0; i < count; i++){
+      header.checksum = addChecksum(header.checksum, search->pats[i].pstr);
+    }
+    // The body is read back to find its checksum.
+    size_t bodySize = header.size - sizeof(header);
+    uint64_t *body = (uint64_t *) malloc(bodySize + 1);
+    ok = ok && fseek(fp, sizeof(header), SEEK_SET) == 0 &&
+      fread(body, 1, bodySize, fp) == bodySize;
+    header.bodyChecksum = bodyChecksum(body, bodySize);
+    free(body);
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, fp) == 1;
+    ok = fclose(fp) == 0 && ok;
+    if (ok){
+      ok = rename(tmpName, name) == 0;
+    } else {
+      remove(tmpName);
+    }
+  }
+
+  if (ac != search->ac){
+    freeAhoCorasick(ac);
+  }
+  for (int i = 0; i < count; i++){
+    free(literals[i]);
+  }
+  free(literals);
+  return ok;
+}
+
+/**
+  Check that a section lies inside the file.
+
+  @param offset offset of the section.
+  @param length number of items in the section.
+  @param item size of an item.
+  @param size size of the file.
+  @return true if it fits.
+*/
+static bool sectionFits(uint64_t offset, uint64_t length, size_t item, size_t size)
+{
+  return offset % CACHE_ALIGN == 0 && offset <= size &&
+    length <= (size - offset) / item;
+}
+
+/**
+  Rebuild a pattern's program from its saved instructions, checking that
+  every branch and byte set is inside the file.
+
+  @param insts the pattern's instructions.
+  @param count number of instructions.
+  @param sets every byte set in the file.
+  @param setCount number of byte sets.
+  @return A dynamically allocated program, or NULL if it's not valid.
+*/
+static Program *loadProgram(CacheInstruction const *insts, int count,
+                            ByteSet const *sets, uint64_t setCount)
+{
+  if (count < 1 || insts[count - 1].op != OP_MATCH){
+    return NULL;
+  }
+  Program *prog = (Program *) malloc(sizeof(Program));
+  prog->code = (Instruction *) malloc(count * sizeof(Instruction));
+  prog->count = prog->capacity = count;
+  for (int pc = 0; pc < count; pc++){
+    CacheInstruction const *ci = insts + pc;
+    Instruction *inst = prog->code + pc;
+    bool valid = ci->op <= OP_MATCH &&
+      (ci->op != OP_CLASS || (ci->set >= 0 && (uint64_t) ci->set < setCount)) &&
+      ((ci->op != OP_SPLIT && ci->op != OP_JMP) || (ci->x >= 0 && ci->x < count)) &&
+      (ci->op != OP_SPLIT || (ci->y >= 0 && ci->y < count));
+    if (!valid){
+      freeProgram(prog);
+      return NULL;
+    }
+    inst->op = (Opcode) ci->op;
+    inst->c = ci->c;
+    inst->set = ci->op == OP_CLASS ? sets + ci->set : NULL;
+    inst->x = ci->x;
+    inst->y = ci->y;
+  }
+  return prog;
+}
+
+/**
+  Load a search saved by saveCompiled(), if it was saved for the same
+  pattern strings.
+
+  @param pstrs pattern strings, they must outlive the search.
+  @param count number of patterns.
+  @param engine engine used to match lines.
+  @param name name of the file.
+  @return A dynamically allocated search, or NULL if the file can't be
+          used.
+*/
+Search *loadCompiled(char *const *pstrs, int count, Engine engine,
+                     char const *name)
+{
+  if (engine == TABLE_ENGINE){
+    return NULL;
+  }
+  Input *in = openInput(name);
+  if (!in){
+    return NULL;
+  }
+  char const *data;
+  size_t size;
+  CacheHeader const *header = NULL;
+  if (inputData(in, &data, &size) && size >= sizeof(CacheHeader)){
+    header = (CacheHeader const *) data;
+  }
+  uint64_t checksum = FNV_OFFSET;
+  for (int i = 0; i < count; i++){
+    checksum = addChecksum(checksum, pstrs[i]);
+  }
+  if (!header || memcmp(header->magic, CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+      header->version != CACHE_VERSION || header->count != (uint32_t) count ||
+      header->checksum != checksum || header->size != size ||
+      size % CACHE_ALIGN != 0 ||
+      header->bodyChecksum != bodyChecksum(header + 1, size - sizeof(CacheHeader)) ||
+      !sectionFits(sizeof(CacheHeader), count, sizeof(CachePattern), size) ||
+      !sectionFits(header->instOffset, header->instCount, sizeof(CacheInstruction), size) ||
+      !sectionFits(header->setOffset, header->setCount, sizeof(ByteSet), size) ||
+      !sectionFits(header->textOffset, header->textSize, 1, size) ||
+      !sectionFits(header->acOffset, header->acSize, 1, size) ||
+      header->textSize == 0 || data[header->textOffset + header->textSize - 1] != '\0' ||
+      (count > 1) != (header->acSize > 0)){
+    closeInput(in);
+    return NULL;
+  }
+
+  CachePattern const *table = (CachePattern const *) (header + 1);
+  CacheInstruction const *insts = (CacheInstruction const *) (data + header->instOffset);
+  ByteSet const *sets = (ByteSet const *) (data + header->setOffset);
+  char const *text = data + header->textOffset;
+
+  // Patterns are added as they're loaded, so freeSearch() can clean up
+  // after one that isn't valid.
+  Search *search = (Search *) malloc(sizeof(Search));
+  search->pats = (SearchPattern *) malloc(count * sizeof(SearchPattern));
+  search->count = 0;
+  search->ac = NULL;
+  search->unfiltered = (int *) malloc(count * sizeof(int));
+  search->unfilteredCount = 0;
+  search->image = in;
+  search->engine = engine;
+  search->mode = PRINT_LINES;
+  search->maxCount = -1;
+  search->before = search->after = 0;
+  search->binary = BINARY_MATCHES;
+  for (int i = 0; i < count; i++){
+    CachePattern const *cp = table + i;
+    Program *prog = NULL;
+    if (cp->firstInst <= header->instCount &&
+        cp->instCount <= header->instCount - cp->firstInst &&
+        cp->literal < header->textSize){
+      prog = loadProgram(insts + cp->firstInst, cp->instCount, sets,
+                         header->setCount);
+    }
+    if (!prog){
+      freeSearch(search);
+      return NULL;
+    }
+    SearchPattern *sp = search->pats + search->count++;
+    sp->pstr = pstrs[i];
+    sp->pat = NULL;
+    sp->prog = prog;
+    sp->pf = makeLiteralPrefilter(text + cp->literal);
+    sp->parsedNodes = sp->nodes = 0;
+    if (!sp->pf){
+      search->unfiltered[search->unfilteredCount++] = i;
+    }
+  }
+  if (count > 1){
+    search->ac = mapAhoCorasick(data + header->acOffset, header->acSize);
+    if (!search->ac){
+      freeSearch(search);
+      return NULL;
+    }
+  }
+  return search;
+}
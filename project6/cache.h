@@ -0,0 +1,44 @@
+/**
+  This is the header file for the cache component, which saves the
+  compiled form of a search to a file and loads it back, so a large set
+  of patterns doesn't have to be parsed and compiled on every run.
+
+  @file cache.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include "search.h"
+
+/**
+  Save the compiled programs, literals and literal automaton of the
+  search to a file, along with a checksum of its pattern strings.  The
+  file is written under a temporary name and then renamed, so a run
+  that's using the old file isn't disturbed.
+
+  @param search search to save.
+  @param name name of the file.
+  @return true if the file was written.
+*/
+bool saveCompiled(Search const *search, char const *name);
+
+/**
+  Load a search saved by saveCompiled(), if it was saved for the same
+  pattern strings.  The file is memory mapped, and the automaton is used
+  right where it is.  The table engine needs the parsed patterns, so it
+  can't use a saved search.
+
+  @param pstrs pattern strings, they must outlive the search.
+  @param count number of patterns.
+  @param engine engine used to match lines.
+  @param name name of the file.
+  @return A dynamically allocated search, or NULL if the file can't be
+          read, wasn't written by this version, or is for other patterns.
+*/
+Search *loadCompiled(char *const *pstrs, int count, Engine engine,
+                     char const *name);
+
+#endif
@@ -0,0 +1,932 @@
+/**
+  Lazy DFA engine for compiled programs.  Each DFA state is the set of
+  NFA instructions (consuming instructions, pending $ assertions and
+  OP_MATCH) that are live at some position in the input.  States and
+  their transitions are created the first time they're needed and kept
+  in a bounded cache, so a line is matched with one table lookup per
+  byte once the cache is warm.
+
+  Anchored programs don't look at more of a line than they have to.  A
+  program anchored at the start stops as soon as no instruction is live.
+  A program anchored only at the end is run backward from the end of
+  the line by a second lazy DFA, whose states are the instructions that
+  can go on to match, and it stops as soon as no match can start
+  further back.
+
+  Highlighting takes three passes, each one table lookup per byte: the
+  forward DFA finds where the last match ends, the backward DFA runs
+  from there to find where the first match starts, recording its state
+  at each position, and the forward DFA runs again over just that slice.
+  A byte is matched where the two states share a consuming instruction.
+
+  @file dfa.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#include "dfa.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+// Maximum number of cached DFA states before the cache is flushed.
+#define MAX_DFA_STATES 512
+
+// Size of the hash table for finding states by their instruction set.
+#define HASH_SIZE (2 * MAX_DFA_STATES)
+
+// Number of bits in a word of an instruction set.
+#define WORD_BITS 64
+
+// Number of possible input bytes.
+#define ALPHABET 256
+
+// Transition that hasn't been computed yet.
+#define UNKNOWN (-1)
+
+/** Lazily computed flag for whether a state accepts at the end of line. */
+typedef enum { END_UNKNOWN, END_REJECT, END_ACCEPT } EndAccept;
+
+/** A state of the DFA. */
+typedef struct {
+  /** Next state for each byte, or UNKNOWN. */
+  int next[ ALPHABET ];
+  /** True if OP_MATCH is in this state's instruction set. */
+  bool accepting;
+  /** Whether this state accepts once the $ assertions are satisfied,
+      or for a backward DFA, once the ^ assertions are. */
+  EndAccept endAccept;
+  /** True if no match can be found from this state on. */
+  bool dead;
+} DFAState;
+
+/** Representation of the DFA. */
+struct DFAStruct {
+  /** Program being run. */
+  Program *prog;
+  /** True if this DFA runs backward from the end of the line. */
+  bool backward;
+  /** True if every match starts at the start of the line. */
+  bool anchoredStart;
+  /** True if every match ends at the end of the line, and not every
+      match starts at the start. */
+  bool anchoredEnd;
+  /** Backward DFA for the same program, made when it's first needed, or
+      NULL. */
+  DFA *reverse;
+  /** Number of words in an instruction set. */
+  int words;
+  /** Bit mask of the instructions kept in a state's set. */
+  uint64_t *important;
+  /** Instructions live at every position, for unanchored search. */
+  uint64_t *startSet;
+
+  /** Cached states, and the instruction set for each. */
+  DFAState *states;
+  uint64_t *sets;
+  int stateCount;
+  /** Index of each state in a hash table on its set, or UNKNOWN. */
+  int hash[ HASH_SIZE ];
+  /** Cached state at the start of a line, or UNKNOWN. */
+  int initial;
+  /** For a backward DFA, the instructions that reach OP_MATCH at the end
+      of a line, and the cached state after each last byte, or UNKNOWN. */
+  uint64_t *endSet;
+  int endNext[ ALPHABET ];
+  /** Same as endSet and endNext, for a match ending before the end of a
+      line. */
+  uint64_t *matchSet;
+  int matchNext[ ALPHABET ];
+  /** Number of times the cache has been flushed. */
+  int flushes;
+
+  /** Scratch sets and stack for computing closures. */
+  uint64_t *scratch, *visited;
+  int *stack;
+
+  /** Epsilon predecessors of each instruction, for the backward pass.
+      The predecessors of pc are pred[ predStart[ pc ] ] up to
+      pred[ predStart[ pc + 1 ] - 1 ]. */
+  int *predStart, *pred;
+};
+
+// Test bit pc of the given set.
+static bool testBit(uint64_t const *set, int pc)
+{
+  return (set[pc / WORD_BITS] >> (pc % WORD_BITS)) & 1;
+}
+
+// Set bit pc of the given set.
+static void setBit(uint64_t *set, int pc)
+{
+  set[pc / WORD_BITS] |= (uint64_t) 1 << (pc % WORD_BITS);
+}
+
+/**
+  Add pc and everything reachable from it through epsilon instructions
+  to visited.
+
+  @param dfa DFA with the program and the closure stack.
+  @param visited set of instructions added so far.
+  @param pc instruction to start from.
+  @param atStart true if the position is the start of the line.
+  @param atEnd true if the position is the end of the line.
+*/
+static void addClosure(DFA *dfa, uint64_t *visited, int pc, bool atStart,
+                       bool atEnd)
+{
+  Instruction const *code = dfa->prog->code;
+  int top = 0;
+
+  if (testBit(visited, pc)){
+    return;
+  }
+  setBit(visited, pc);
+  dfa->stack[top++] = pc;
+  while (top > 0){
+    Instruction const *inst = code + dfa->stack[--top];
+    int targets[2];
+    int count = 0;
+    if (inst->op == OP_JMP){
+      targets[count++] = inst->x;
+    } else if (inst->op == OP_SPLIT){
+      targets[count++] = inst->x;
+      targets[count++] = inst->y;
+    } else if ((inst->op == OP_BOL && atStart) || (inst->op == OP_EOL && atEnd)){
+      targets[count++] = inst - code + 1;
+    }
+    for (int i = 0; i < count; i++){
+      if (!testBit(visited, targets[i])){
+        setBit(visited, targets[i]);
+        dfa->stack[top++] = targets[i];
+      }
+    }
+  }
+}
+
+// Hash an instruction set.
+static unsigned hashSet(uint64_t const *set, int words)
+{
+  uint64_t h = 1469598103934665603ULL;
+  for (int i = 0; i < words; i++){
+    h = (h ^ set[i]) * 1099511628211ULL;
+  }
+  return (unsigned) (h ^ (h >> 32));
+}
+
+// Drop every cached state.
+static void flushCache(DFA *dfa)
+{
+  dfa->stateCount = 0;
+  dfa->initial = UNKNOWN;
+  dfa->flushes++;
+  for (int i = 0; i < HASH_SIZE; i++){
+    dfa->hash[i] = UNKNOWN;
+  }
+  for (int c = 0; c < ALPHABET; c++){
+    dfa->endNext[c] = UNKNOWN;
+    dfa->matchNext[c] = UNKNOWN;
+  }
+}
+
+/**
+  Add to a set every instruction that reaches one already in it through
+  epsilon instructions, the reverse of addClosure().
+
+  @param dfa DFA with the program and predecessor lists.
+  @param set set of instructions, added to in place.
+  @param atStart true if the position is the start of the line.
+  @param atEnd true if the position is the end of the line.
+*/
+static void backwardClosure(DFA *dfa, uint64_t *set, bool atStart, bool atEnd)
+{
+  Program *prog = dfa->prog;
+  int top = 0;
+
+  for (int i = 0; i < dfa->words; i++){
+    for (uint64_t bits = set[i]; bits; bits &= bits - 1){
+      dfa->stack[top++] = i * WORD_BITS + __builtin_ctzll(bits);
+    }
+  }
+  while (top > 0){
+    int pc = dfa->stack[--top];
+    for (int i = dfa->predStart[pc]; i < dfa->predStart[pc + 1]; i++){
+      int q = dfa->pred[i];
+      Opcode op = prog->code[q].op;
+      if ((op == OP_BOL && !atStart) || (op == OP_EOL && !atEnd)){
+        continue;
+      }
+      if (!testBit(set, q)){
+        setBit(set, q);
+        dfa->stack[top++] = q;
+      }
+    }
+  }
+}
+
+/**
+  Find the instructions that can go on to match starting right before
+  the given byte: OP_MATCH, and each consuming instruction that accepts
+  the byte and leads into the given set.
+
+  @param dfa DFA with the program.
+  @param after instructions that can go on to match after the byte.
+  @param ch the byte.
+  @param seeds set to fill in.
+*/
+static void backwardSeeds(DFA *dfa, uint64_t const *after, unsigned char ch,
+                          uint64_t *seeds)
+{
+  Program *prog = dfa->prog;
+
+  memset(seeds, 0, dfa->words * sizeof(uint64_t));
+  setBit(seeds, prog->count - 1);
+  for (int pc = 0; pc < prog->count - 1; pc++){
+    if (instructionAccepts(prog->code + pc, ch) && testBit(after, pc + 1)){
+      setBit(seeds, pc);
+    }
+  }
+}
+
+/**
+  Find the cached state for the given closure, adding a new one if
+  needed.  Only the important instructions of the closure are kept.
+
+  @param dfa DFA to look in.
+  @param visited closure of the new state, masked in place.
+  @return index of the state.
+*/
+static int findState(DFA *dfa, uint64_t *visited)
+{
+  int words = dfa->words;
+  for (int i = 0; i < words; i++){
+    visited[i] &= dfa->important[i];
+  }
+
+  unsigned h = hashSet(visited, words) % HASH_SIZE;
+  while (dfa->hash[h] != UNKNOWN){
+    int s = dfa->hash[h];
+    if (memcmp(dfa->sets + (size_t) s * words, visited,
+               words * sizeof(uint64_t)) == 0){
+      return s;
+    }
+    h = (h + 1) % HASH_SIZE;
+  }
+
+  if (dfa->stateCount >= MAX_DFA_STATES){
+    flushCache(dfa);
+    h = hashSet(visited, words) % HASH_SIZE;
+  }
+  int s = dfa->stateCount++;
+  dfa->hash[h] = s;
+  memcpy(dfa->sets + (size_t) s * words, visited, words * sizeof(uint64_t));
+  DFAState *state = dfa->states + s;
+  for (int c = 0; c < ALPHABET; c++){
+    state->next[c] = UNKNOWN;
+  }
+  state->endAccept = END_UNKNOWN;
+  if (dfa->backward){
+    // A backward state is the consuming instructions that can go on to
+    // match, plus OP_MATCH.  It accepts if a match can start here, and
+    // with no consuming instructions, no match that ends where the run
+    // began can start further back.
+    state->dead = true;
+    for (int pc = 0; pc < dfa->prog->count - 1; pc++){
+      state->dead = state->dead && !testBit(visited, pc);
+    }
+    backwardClosure(dfa, visited, false, false);
+    state->accepting = testBit(visited, 0);
+  } else {
+    state->accepting = testBit(visited, dfa->prog->count - 1);
+    state->dead = dfa->anchoredStart;
+    for (int i = 0; i < words; i++){
+      state->dead = state->dead && !visited[i];
+    }
+  }
+  return s;
+}
+
+// Get the state at the start of a non-empty line.
+static int initialState(DFA *dfa)
+{
+  if (dfa->initial == UNKNOWN){
+    memset(dfa->scratch, 0, dfa->words * sizeof(uint64_t));
+    addClosure(dfa, dfa->scratch, 0, true, false);
+    dfa->initial = findState(dfa, dfa->scratch);
+  }
+  return dfa->initial;
+}
+
+/**
+  Get the state reached from state s on byte ch, computing and caching
+  it if it's not known yet.
+
+  @param dfa DFA to run.
+  @param s current state.
+  @param ch next byte of input.
+  @return index of the next state.
+*/
+static int nextState(DFA *dfa, int s, unsigned char ch)
+{
+  int next = dfa->states[s].next[ch];
+  if (next != UNKNOWN){
+    return next;
+  }
+
+  int words = dfa->words;
+  uint64_t const *set = dfa->sets + (size_t) s * words;
+  uint64_t *visited = dfa->scratch;
+  if (dfa->backward){
+    // Going back over ch, from the instructions that can go on to match
+    // after it.
+    memcpy(dfa->visited, set, words * sizeof(uint64_t));
+    backwardClosure(dfa, dfa->visited, false, false);
+    backwardSeeds(dfa, dfa->visited, ch, visited);
+  } else {
+    // A new match can start at every position.
+    memcpy(visited, dfa->startSet, words * sizeof(uint64_t));
+    for (int i = 0; i < words; i++){
+      for (uint64_t bits = set[i]; bits; bits &= bits - 1){
+        int pc = i * WORD_BITS + __builtin_ctzll(bits);
+        if (instructionAccepts(dfa->prog->code + pc, ch)){
+          addClosure(dfa, visited, pc + 1, false, false);
+        }
+      }
+    }
+  }
+
+  int flushes = dfa->flushes;
+  next = findState(dfa, visited);
+  // If the cache was flushed, s is gone, so don't record the transition.
+  if (dfa->flushes == flushes){
+    dfa->states[s].next[ch] = next;
+  }
+  return next;
+}
+
+/**
+  Check if the given instructions reach OP_MATCH at the end of line,
+  once pending $ assertions can be satisfied.
+
+  @param dfa DFA with the program.
+  @param set live instructions at the end of line.
+  @param atStart true if the end of line is also its start.
+  @return true if the program matches.
+*/
+static bool acceptsAtEnd(DFA *dfa, uint64_t const *set, bool atStart)
+{
+  uint64_t *visited = dfa->visited;
+  memset(visited, 0, dfa->words * sizeof(uint64_t));
+  for (int pc = 0; pc < dfa->prog->count; pc++){
+    if (testBit(set, pc)){
+      addClosure(dfa, visited, pc, atStart, true);
+    }
+  }
+  return testBit(visited, dfa->prog->count - 1);
+}
+
+/**
+  Make a lazy DFA for the given program, running in either direction.
+
+  @param prog program to run, it must outlive the DFA.
+  @param backward true for a DFA run backward from the end of the line.
+  @return A dynamically allocated DFA for the program.
+*/
+static DFA *newDFA(Program *prog, bool backward)
+{
+  DFA *dfa = (DFA *) malloc(sizeof(DFA));
+  int words = (prog->count + WORD_BITS - 1) / WORD_BITS;
+  dfa->prog = prog;
+  dfa->backward = backward;
+  dfa->anchoredStart = !backward && anchoredAtStart(prog);
+  dfa->anchoredEnd = false;
+  dfa->reverse = NULL;
+  dfa->endSet = NULL;
+  dfa->matchSet = NULL;
+  dfa->words = words;
+  dfa->important = (uint64_t *) calloc(words, sizeof(uint64_t));
+  dfa->startSet = (uint64_t *) calloc(words, sizeof(uint64_t));
+  dfa->scratch = (uint64_t *) calloc(words, sizeof(uint64_t));
+  dfa->visited = (uint64_t *) calloc(words, sizeof(uint64_t));
+  dfa->stack = (int *) malloc(prog->count * sizeof(int));
+  dfa->states = (DFAState *) malloc(MAX_DFA_STATES * sizeof(DFAState));
+  dfa->sets = (uint64_t *) malloc((size_t) MAX_DFA_STATES * words * sizeof(uint64_t));
+  dfa->flushes = 0;
+  flushCache(dfa);
+
+  // Count epsilon predecessors of each instruction.  Along the way, mark
+  // the important instructions: only consuming instructions, $ assertions
+  // and OP_MATCH matter once a closure is computed; the rest are just
+  // ways of getting to those.
+  dfa->predStart = (int *) calloc(prog->count + 1, sizeof(int));
+  for (int pc = 0; pc < prog->count; pc++){
+    Instruction const *inst = prog->code + pc;
+    switch (inst->op){
+      case OP_SPLIT:
+        dfa->predStart[inst->y]++;
+        // fall through
+      case OP_JMP:
+        dfa->predStart[inst->x]++;
+        break;
+      case OP_BOL:
+        dfa->predStart[pc + 1]++;
+        break;
+      case OP_EOL:
+        dfa->predStart[pc + 1]++;
+        // Going backward, a $ is just a way of getting to OP_MATCH.
+        if (!backward){
+          setBit(dfa->important, pc);
+        }
+        break;
+      default:
+        setBit(dfa->important, pc);
+    }
+  }
+
+  // Turn the predecessor counts into start offsets, then fill them in.
+  int total = 0;
+  for (int pc = 0; pc <= prog->count; pc++){
+    int count = dfa->predStart[pc];
+    dfa->predStart[pc] = total;
+    total += count;
+  }
+  dfa->pred = (int *) malloc((total > 0 ? total : 1) * sizeof(int));
+  int fill[prog->count];
+  for (int pc = 0; pc < prog->count; pc++){
+    fill[pc] = dfa->predStart[pc];
+  }
+  for (int pc = 0; pc < prog->count; pc++){
+    Instruction const *inst = prog->code + pc;
+    if (inst->op == OP_SPLIT){
+      dfa->pred[fill[inst->y]++] = pc;
+    }
+    if (inst->op == OP_SPLIT || inst->op == OP_JMP){
+      dfa->pred[fill[inst->x]++] = pc;
+    }
+    if (inst->op == OP_BOL || inst->op == OP_EOL){
+      dfa->pred[fill[pc + 1]++] = pc;
+    }
+  }
+
+  addClosure(dfa, dfa->startSet, 0, false, false);
+  for (int i = 0; i < words; i++){
+    dfa->startSet[i] &= dfa->important[i];
+  }
+  if (backward){
+    dfa->endSet = (uint64_t *) calloc(words, sizeof(uint64_t));
+    setBit(dfa->endSet, prog->count - 1);
+    backwardClosure(dfa, dfa->endSet, false, true);
+    dfa->matchSet = (uint64_t *) calloc(words, sizeof(uint64_t));
+    setBit(dfa->matchSet, prog->count - 1);
+    backwardClosure(dfa, dfa->matchSet, false, false);
+  }
+  return dfa;
+}
+
+/**
+  Make a lazy DFA for the given program.
+
+  @param prog program to run, it must outlive the DFA.
+  @return A dynamically allocated DFA for the program.
+*/
+DFA *makeDFA(Program *prog)
+{
+  DFA *dfa = newDFA(prog, false);
+  dfa->anchoredEnd = !dfa->anchoredStart && anchoredAtEnd(prog);
+  return dfa;
+}
+
+// Get the backward DFA for the program, making it if needed.
+static DFA *reverseDFA(DFA *dfa)
+{
+  if (!dfa->reverse){
+    dfa->reverse = newDFA(dfa->prog, true);
+  }
+  return dfa->reverse;
+}
+
+/**
+  Get the backward state at the last byte before the end of a match.
+
+  @param rev backward DFA to run.
+  @param ch last byte of the match.
+  @param atEnd true if the match ends at the end of the line.
+  @return index of the state.
+*/
+static int endState(DFA *rev, unsigned char ch, bool atEnd)
+{
+  int *next = atEnd ? rev->endNext : rev->matchNext;
+  if (next[ch] == UNKNOWN){
+    backwardSeeds(rev, atEnd ? rev->endSet : rev->matchSet, ch, rev->scratch);
+    // A flush resets the cache, so the new state is recorded after it.
+    int s = findState(rev, rev->scratch);
+    next[ch] = s;
+  }
+  return next[ch];
+}
+
+/**
+  Check if a match can start at the start of the line from the given
+  backward state, where the ^ assertions hold too.
+
+  @param rev backward DFA.
+  @param s state at the first byte of the line.
+  @return true if a match can start there.
+*/
+static bool acceptsAtStart(DFA *rev, int s)
+{
+  DFAState *state = rev->states + s;
+  if (state->endAccept == END_UNKNOWN){
+    memcpy(rev->visited, rev->sets + (size_t) s * rev->words,
+           rev->words * sizeof(uint64_t));
+    backwardClosure(rev, rev->visited, true, false);
+    state->endAccept = testBit(rev->visited, 0) ? END_ACCEPT : END_REJECT;
+  }
+  return state->endAccept == END_ACCEPT;
+}
+
+/**
+  Run a backward DFA from the end of a non-empty line toward its start.
+
+  @param rev backward DFA to run.
+  @param str input string.
+  @param len length of str, at least 1.
+  @param last set to the state it stopped in.
+  @return the position it stopped at, where a match can start or where
+          no match can start at or before, or 0 if it got to the start
+          of the line.
+*/
+static int runBackward(DFA *rev, char const *str, int len, int *last)
+{
+  int s = endState(rev, str[len - 1], true);
+  int k = len - 1;
+  for (; k > 0; k--){
+    DFAState const *state = rev->states + s;
+    if (state->accepting || state->dead){
+      break;
+    }
+    unsigned char ch = str[k - 1];
+    s = state->next[ch];
+    if (s == UNKNOWN){
+      s = nextState(rev, state - rev->states, ch);
+    }
+  }
+  *last = s;
+  return k;
+}
+
+/**
+  Check if a program anchored at the end matches the given non-empty
+  string, by running its backward DFA until a match can start or no
+  match can start further back.
+
+  @param rev backward DFA to run.
+  @param str input string.
+  @param len length of str, at least 1.
+  @return true if some substring of str matches.
+*/
+static bool matchBackward(DFA *rev, char const *str, int len)
+{
+  if (testBit(rev->endSet, 0)){
+    // An empty match at the end of the line.
+    return true;
+  }
+  int s;
+  if (runBackward(rev, str, len, &s) > 0){
+    return rev->states[s].accepting;
+  }
+  return acceptsAtStart(rev, s);
+}
+
+/**
+  Check if the program matches at the end of a non-empty line, from the
+  forward state there, once pending $ assertions are satisfied.
+
+  @param dfa DFA to run.
+  @param s state at the end of the line.
+  @return true if a match ends there.
+*/
+static bool endAccepts(DFA *dfa, int s)
+{
+  DFAState *state = dfa->states + s;
+  if (state->endAccept == END_UNKNOWN){
+    bool accept = acceptsAtEnd(dfa, dfa->sets + (size_t) s * dfa->words, false);
+    state->endAccept = accept ? END_ACCEPT : END_REJECT;
+  }
+  return state->endAccept == END_ACCEPT;
+}
+
+/**
+  Find where the last match in a non-empty line ends, running the DFA
+  forward until the line ends or nothing is live any more.
+
+  @param dfa DFA to run.
+  @param str input string.
+  @param len length of str, at least 1.
+  @return the end of the last match, or -1 if nothing matches.
+*/
+static int lastMatchEnd(DFA *dfa, char const *str, int len)
+{
+  int end = -1;
+  int s = initialState(dfa);
+  for (int i = 0; i < len; i++){
+    DFAState const *state = dfa->states + s;
+    if (state->accepting){
+      end = i;
+    }
+    if (state->dead){
+      return end;
+    }
+    unsigned char ch = str[i];
+    s = state->next[ch];
+    if (s == UNKNOWN){
+      s = nextState(dfa, state - dfa->states, ch);
+    }
+  }
+  return endAccepts(dfa, s) ? len : end;
+}
+
+/**
+  Find where the first match in a line starts, running the backward DFA
+  from the end of the last match until the start of the line, or for a
+  program anchored at the end, until no match can start further back.
+
+  @param rev backward DFA to run.
+  @param str input string.
+  @param len length of str.
+  @param to end of the last match, at least 1.
+  @param anchoredEnd true if every match ends at the end of the line.
+  @param back filled in with the backward state at each position, from
+              the one returned up to to - 1.
+  @return the start of the first match, or to if no match can start.
+*/
+static int firstMatchStart(DFA *rev, char const *str, int len, int to,
+                           bool anchoredEnd, int *back)
+{
+  int from = to;
+  int s = endState(rev, str[to - 1], to == len);
+  for (int k = to - 1; ; k--){
+    DFAState const *state = rev->states + s;
+    back[k] = s;
+    if (k > 0 ? state->accepting : acceptsAtStart(rev, s)){
+      from = k;
+    }
+    if (k == 0 || (anchoredEnd && state->dead)){
+      return from;
+    }
+    unsigned char ch = str[k - 1];
+    s = state->next[ch];
+    if (s == UNKNOWN){
+      s = nextState(rev, state - rev->states, ch);
+    }
+  }
+}
+
+/**
+  Check if the program matches anywhere in the given string, including
+  empty matches.
+
+  @param dfa DFA to run.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @return true if some substring of str matches.
+*/
+bool matchDFA(DFA *dfa, char const *str, int len)
+{
+  if (len == 0){
+    memset(dfa->scratch, 0, dfa->words * sizeof(uint64_t));
+    addClosure(dfa, dfa->scratch, 0, true, true);
+    return testBit(dfa->scratch, dfa->prog->count - 1);
+  }
+  if (dfa->anchoredEnd){
+    return matchBackward(reverseDFA(dfa), str, len);
+  }
+
+  int s = initialState(dfa);
+  for (int i = 0; i < len; i++){
+    DFAState const *state = dfa->states + s;
+    if (state->accepting){
+      return true;
+    }
+    if (state->dead){
+      // Anchored at the start, and nothing is live any more.
+      return false;
+    }
+    // Cached transitions are followed inline, only new ones are computed.
+    unsigned char ch = str[i];
+    s = state->next[ch];
+    if (s == UNKNOWN){
+      s = nextState(dfa, state - dfa->states, ch);
+    }
+  }
+
+  return endAccepts(dfa, s);
+}
+
+/**
+  Compute, for the position at, the set of instructions from which
+  OP_MATCH can be reached, given the same set for the next position.
+  That's the seeds (OP_MATCH and consuming instructions that lead into
+  after) plus everything that reaches a seed through epsilon edges.
+
+  @param dfa DFA with the program and predecessor lists.
+  @param str input string.
+  @param len length of str.
+  @param at position in str.
+  @param after set for position at + 1, ignored when at == len.
+  @param set set for position at, filled in.
+*/
+static void backwardSet(DFA *dfa, char const *str, int len, int at,
+                        uint64_t const *after, uint64_t *set)
+{
+  if (at < len){
+    backwardSeeds(dfa, after, str[at], set);
+  } else {
+    memset(set, 0, dfa->words * sizeof(uint64_t));
+    setBit(set, dfa->prog->count - 1);
+  }
+  backwardClosure(dfa, set, at == 0, at == len);
+}
+
+/**
+  Add character k to the runs of matched characters, extending the run
+  ending right before it or starting a new one.
+
+  @param spans runs found so far.
+  @param count number of runs in spans.
+  @param k index of the matched character.
+  @return the new number of runs.
+*/
+static int addMatched(Span *spans, int count, int k)
+{
+  if (count > 0 && spans[count - 1].end == k){
+    spans[count - 1].end = k + 1;
+  } else {
+    spans[count].start = k;
+    spans[count++].end = k + 1;
+  }
+  return count;
+}
+
+/**
+  Find the matched characters between from and to by computing the sets
+  of instructions at each position directly.  This is only used when the
+  backward DFA can't keep its states for the whole slice in its cache.
+
+  @param dfa DFA whose program is matched.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @param from start of the first match.
+  @param to end of the last match.
+  @param spans array of spans, filled in with the runs of matched
+               characters.
+  @param arena arena the scratch sets are allocated from.
+  @return the number of spans.
+*/
+static int findSpansBySets(DFA *dfa, char const *str, int len, int from,
+                           int to, Span *spans, Arena *arena)
+{
+  int words = dfa->words;
+  Program *prog = dfa->prog;
+
+  // Backward pass, reach[ k ] is the set of instructions that can go on
+  // to match starting at position k.  Past to, nothing can.
+  ArenaMark mark = markArena(arena);
+  uint64_t *reach = (uint64_t *) arenaAlloc(arena, (size_t) (len + 1) * words * sizeof(uint64_t));
+  uint64_t *none = (uint64_t *) arenaAlloc(arena, words * sizeof(uint64_t));
+  memset(none, 0, words * sizeof(uint64_t));
+  backwardSet(dfa, str, len, to, none, reach + (size_t) to * words);
+  for (int k = to - 1; k > from; k--){
+    backwardSet(dfa, str, len, k, reach + (size_t) (k + 1) * words,
+                reach + (size_t) k * words);
+  }
+
+  // Forward pass, live holds the instructions reachable at position k
+  // from a match starting at or before k.  A character is matched if a
+  // live instruction consumes it and can go on to match afterward.
+  int count = 0;
+  uint64_t *live = (uint64_t *) arenaAlloc(arena, words * sizeof(uint64_t));
+  uint64_t *next = (uint64_t *) arenaAlloc(arena, words * sizeof(uint64_t));
+  memset(live, 0, words * sizeof(uint64_t));
+  addClosure(dfa, live, 0, from == 0, from == len);
+  for (int k = from; k < to; k++){
+    uint64_t const *after = reach + (size_t) (k + 1) * words;
+    bool matched = false;
+    memset(next, 0, words * sizeof(uint64_t));
+    addClosure(dfa, next, 0, false, k + 1 == len);
+    for (int pc = 0; pc < prog->count; pc++){
+      Instruction const *inst = prog->code + pc;
+      if (testBit(live, pc) && instructionAccepts(inst, str[k])){
+        if (testBit(after, pc + 1)){
+          matched = true;
+        }
+        addClosure(dfa, next, pc + 1, false, k + 1 == len);
+      }
+    }
+    if (matched){
+      count = addMatched(spans, count, k);
+    }
+    uint64_t *tmp = live;
+    live = next;
+    next = tmp;
+  }
+
+  releaseArena(arena, mark);
+  return count;
+}
+
+/**
+  Find the runs of characters that are part of some non-empty match of
+  the program in the given string.
+
+  @param dfa DFA whose program is matched.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @param spans array of len spans, filled in with the runs of matched
+               characters.
+  @param arena arena the scratch sets are allocated from.
+  @return the number of spans.
+*/
+int findMatchedSpans(DFA *dfa, char const *str, int len, Span *spans,
+                     Arena *arena)
+{
+  if (len == 0){
+    return 0;
+  }
+
+  // Matches only cover [ from, to ), the end of the last one and the
+  // start of the first one.
+  int to = dfa->anchoredEnd ? len : lastMatchEnd(dfa, str, len);
+  if (to <= 0){
+    return 0;
+  }
+  DFA *rev = reverseDFA(dfa);
+  ArenaMark mark = markArena(arena);
+  int *back = (int *) arenaAlloc(arena, (size_t) to * sizeof(int));
+  int flushes = rev->flushes;
+  int from = firstMatchStart(rev, str, len, to, dfa->anchoredEnd, back);
+  if (rev->flushes != flushes){
+    // Some of the recorded states were dropped from the cache.
+    releaseArena(arena, mark);
+    return findSpansBySets(dfa, str, len, from, to, spans, arena);
+  }
+
+  // Forward pass over the slice.  The forward state holds the consuming
+  // instructions live at k for a match starting at or after from, and
+  // the backward state the ones that accept str[ k ] and can go on to
+  // match.  Character k is matched if they share one besides OP_MATCH.
+  int words = dfa->words;
+  int last = dfa->prog->count - 1;
+  uint64_t matchBit = (uint64_t) 1 << (last % WORD_BITS);
+  int s;
+  if (from == 0){
+    s = initialState(dfa);
+  } else {
+    memcpy(dfa->scratch, dfa->startSet, words * sizeof(uint64_t));
+    s = findState(dfa, dfa->scratch);
+  }
+  int count = 0;
+  for (int k = from; k < to; k++){
+    uint64_t const *live = dfa->sets + (size_t) s * words;
+    uint64_t const *reach = rev->sets + (size_t) back[k] * words;
+    for (int i = 0; i < words; i++){
+      uint64_t both = live[i] & reach[i];
+      if (i == last / WORD_BITS){
+        both &= ~matchBit;
+      }
+      if (both){
+        count = addMatched(spans, count, k);
+        break;
+      }
+    }
+    unsigned char ch = str[k];
+    int next = dfa->states[s].next[ch];
+    s = next != UNKNOWN ? next : nextState(dfa, s, ch);
+  }
+
+  releaseArena(arena, mark);
+  return count;
+}
+
+/**
+  Free the memory for the given DFA, but not its program.
+
+  @param dfa DFA to free.
+*/
+void freeDFA(DFA *dfa)
+{
+  free(dfa->important);
+  free(dfa->startSet);
+  free(dfa->scratch);
+  free(dfa->visited);
+  free(dfa->stack);
+  free(dfa->states);
+  free(dfa->sets);
+  free(dfa->predStart);
+  free(dfa->pred);
+  free(dfa->endSet);
+  free(dfa->matchSet);
+  if (dfa->reverse){
+    freeDFA(dfa->reverse);
+  }
+  free(dfa);
+}
@@ -0,0 +1,67 @@
+/**
+  This is the header file for the dfa component, a matching engine that
+  runs a compiled Program as a lazily built, cached DFA.
+
+  @file dfa.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef DFA_H
+#define DFA_H
+
+#include <stdbool.h>
+#include "program.h"
+#include "arena.h"
+#include "span.h"
+
+/** A short name to use for the lazy DFA. */
+typedef struct DFAStruct DFA;
+
+/**
+  Make a lazy DFA for the given program.  DFA states are built on
+  demand while matching, and kept in a bounded cache that is flushed
+  when it fills up.
+
+  @param prog program to run, it must outlive the DFA.
+  @return A dynamically allocated DFA for the program.
+*/
+DFA *makeDFA(Program *prog);
+
+/**
+  Check if the program matches anywhere in the given string, including
+  empty matches.  This runs in time linear in len.
+
+  @param dfa DFA to run.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @return true if some substring of str matches.
+*/
+bool matchDFA(DFA *dfa, char const *str, int len);
+
+/**
+  Find the runs of characters that are part of some non-empty match of
+  the program in the given string.  The DFA finds where the last match
+  ends, a backward DFA for the same program finds where the first one
+  starts, and a last forward pass covers just the part in between, so
+  it runs in time linear in len.
+
+  @param dfa DFA whose program is matched.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @param spans array of len spans, filled in with the runs of matched
+               characters.
+  @param arena arena the scratch sets are allocated from, everything
+               allocated is given back before returning.
+  @return the number of spans.
+*/
+int findMatchedSpans(DFA *dfa, char const *str, int len, Span *spans,
+                     Arena *arena);
+
+/**
+  Free the memory for the given DFA, but not its program.
+
+  @param dfa DFA to free.
+*/
+void freeDFA(DFA *dfa);
+
+#endif
@@ -64,8 +64,8 @@ checkResults() {
 runTest() {
   rm -f output.txt stderr.txt
 
-  echo "Test $1: ./ugrep '$2' input-$1.txt > output.txt 2> stderr.txt"
-  ./ugrep "$2" input-$1.txt > output.txt 2> stderr.txt
+  echo "Test $1: ./ugrep ${ENGINE:+--engine=$ENGINE} '$2' input-$1.txt > output.txt 2> stderr.txt"
+  ./ugrep ${ENGINE:+--engine=$ENGINE} "$2" input-$1.txt > output.txt 2> stderr.txt
   STATUS=$?
 
   checkResults "$1" "$3"
@@ -90,6 +90,7 @@ runTest 41 '^[0123456789]{,5}$' 0
 runTest 42 '^[0123456789]{3,}$' 0
 runTest 43 '^a{7,6}$' 1
 runTest 44 '^a{abc,xyz}$' 1
+runTest 45 '^(ab){2,3}$' 0
 
 if [ $FAIL -ne 0 ]; then
   echo "FAILING TESTS!"
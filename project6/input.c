@@ -0,0 +1,330 @@
+/**
+  Implementation of the input component.  Regular files are mapped into
+  memory and scanned in place, except small ones, which are read whole
+  with one read(); pipes and terminals are read with large
+  block reads into a buffer that grows to hold the longest line.  Lines
+  are found with memchr(), and handed out as pointer and length slices
+  of the mapping or buffer, so they're never copied one at a time.
+  Lines that will be printed later can be held, and a refill only moves
+  out the bytes before the oldest held line.
+
+  @file input.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "input.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Size of a block read from a pipe or terminal, and the initial buffer.
+#define BLOCK_SIZE (1024 * 1024)
+
+#define MULTIPLY_FACTOR 2
+
+// Largest regular file read into a buffer instead of mapped.  For
+// small files, a mapping costs more than the read.
+#define SMALL_FILE_SIZE (64 * 1024)
+
+// Number of bytes at the start of an input checked for a NUL, to tell if
+// it's binary.
+#define SNIFF_SIZE (32 * 1024)
+
+/** Representation of an open input. */
+struct InputStruct {
+  /** File descriptor being read, or -1 for bytes in memory. */
+  int fd;
+  /** True if data is a mapping of the whole file. */
+  bool mapped;
+  /** True if data belongs to someone else. */
+  bool borrowed;
+  /** Bytes of the file (mapped) or buffered bytes (not mapped). */
+  char *data;
+  /** Number of valid bytes in data. */
+  size_t size;
+  /** Capacity of data, when it's a buffer. */
+  size_t capacity;
+  /** Offset in data of the next line. */
+  size_t pos;
+  /** Offset in the whole input of data[ 0 ]. */
+  size_t base;
+  /** True if the bytes from hold on have to stay in the buffer. */
+  bool holding;
+  /** Offset in the whole input of the first byte held. */
+  size_t hold;
+  /** True once a read has reported the end of the file. */
+  bool eof;
+};
+
+/**
+  Open the given file for reading lines.
+
+  @param filename name of the file to read, or NULL for standard input.
+  @return A dynamically allocated input, or NULL if the file can't be
+          opened.
+*/
+Input *openInput(char const *filename)
+{
+  int fd = STDIN_FILENO;
+  if (filename){
+    fd = open(filename, O_RDONLY);
+    if (fd < 0){
+      return NULL;
+    }
+  }
+
+  Input *in = (Input *) malloc(sizeof(Input));
+  in->fd = fd;
+  in->mapped = false;
+  in->borrowed = false;
+  in->data = NULL;
+  in->size = 0;
+  in->capacity = 0;
+  in->pos = 0;
+  in->base = 0;
+  in->holding = false;
+  in->hold = 0;
+  in->eof = false;
+
+  struct stat st;
+  bool regular = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+  // Files under /proc and /sys have a size of 0 but still have content,
+  // so they're left to the block reads.
+  if (regular && st.st_size > 0 && st.st_size <= SMALL_FILE_SIZE){
+    // A byte of room past the end lets a read report the end of the
+    // file without the buffer growing.  A file that grew since the
+    // stat() fills it, and the rest is read as usual.
+    in->capacity = st.st_size + 1;
+    in->data = (char *) malloc(in->capacity);
+    while (in->size < in->capacity){
+      ssize_t count = read(fd, in->data + in->size, in->capacity - in->size);
+      if (count < 0 && errno == EINTR){
+        continue;
+      }
+      if (count <= 0){
+        in->eof = count == 0;
+        break;
+      }
+      in->size += count;
+    }
+    return in;
+  }
+  if (regular){
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED){
+      posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+      in->mapped = true;
+      in->data = (char *) map;
+      in->size = st.st_size;
+      in->eof = true;
+      return in;
+    }
+  }
+
+  // Not mappable, fall back to block reads.
+  in->capacity = BLOCK_SIZE;
+  in->data = (char *) malloc(in->capacity);
+  return in;
+}
+
+/**
+  Make an input that reads lines from bytes already in memory.
+
+  @param data bytes to read.
+  @param size number of bytes.
+  @return A dynamically allocated input.
+*/
+Input *openMemory(char const *data, size_t size)
+{
+  Input *in = (Input *) malloc(sizeof(Input));
+  in->fd = -1;
+  in->mapped = false;
+  in->borrowed = true;
+  in->data = (char *) data;
+  in->size = size;
+  in->capacity = size;
+  in->pos = 0;
+  in->base = 0;
+  in->holding = false;
+  in->hold = 0;
+  in->eof = true;
+  return in;
+}
+
+/**
+  Get all the bytes of an input that's in memory as a whole.
+
+  @param in input to look at.
+  @param data set to the start of the bytes.
+  @param size set to the number of bytes.
+  @return true if the input is in memory, false if it's read in blocks.
+*/
+bool inputData(Input *in, char const **data, size_t *size)
+{
+  if (!in->mapped && !in->borrowed){
+    return false;
+  }
+  *data = in->data;
+  *size = in->size;
+  return true;
+}
+
+/**
+  Read another block into the buffer of an unmapped input, first moving
+  the held lines and the unfinished line at pos to the front and growing
+  the buffer if they already fill it.
+
+  @param in input to read into.
+  @return false if there was nothing more to read.
+*/
+static bool fillBuffer(Input *in)
+{
+  size_t from = in->pos;
+  if (in->holding && in->hold - in->base < from){
+    from = in->hold - in->base;
+  }
+  if (from > 0){
+    memmove(in->data, in->data + from, in->size - from);
+    in->size -= from;
+    in->pos -= from;
+    in->base += from;
+  }
+  if (in->size == in->capacity){
+    in->capacity *= MULTIPLY_FACTOR;
+    in->data = (char *) realloc(in->data, in->capacity);
+  }
+
+  ssize_t count;
+  do {
+    count = read(in->fd, in->data + in->size, in->capacity - in->size);
+  } while (count < 0 && errno == EINTR);
+  if (count <= 0){
+    in->eof = true;
+    return false;
+  }
+  in->size += count;
+  return true;
+}
+
+/**
+  Get the next line of input, without its newline.
+
+  @param in input to read from.
+  @param line set to the start of the line.
+  @param len set to the length of the line.
+  @return true if a line was read, false at the end of input.
+*/
+bool nextLine(Input *in, char const **line, int *len)
+{
+  // Bytes after pos already looked at, so only new ones are looked at
+  // after a refill.
+  size_t scanned = 0;
+  char *newline;
+  while (!(newline = memchr(in->data + in->pos + scanned, '\n',
+                            in->size - in->pos - scanned))){
+    scanned = in->size - in->pos;
+    if (in->eof || !fillBuffer(in)){
+      break;
+    }
+  }
+
+  size_t end = newline ? newline - in->data : in->size;
+  if (!newline && end == in->pos){
+    return false;
+  }
+  if (end - in->pos > INT_MAX){
+    fprintf(stderr, "Input line too long\n");
+    exit(EXIT_FAILURE);
+  }
+  *line = in->data + in->pos;
+  *len = end - in->pos;
+  in->pos = newline ? end + 1 : end;
+  return true;
+}
+
+/**
+  Check if the input looks binary, with a NUL byte near the start.
+
+  @param in input to check, before any lines are read.
+  @return true if the input looks binary.
+*/
+bool looksBinary(Input *in)
+{
+  if (!in->mapped && !in->borrowed && in->size == 0 && !in->eof){
+    fillBuffer(in);
+  }
+  size_t size = in->size < SNIFF_SIZE ? in->size : SNIFF_SIZE;
+  return memchr(in->data, '\0', size) != NULL;
+}
+
+/**
+  Get where a line is in the whole input.
+
+  @param in input the line came from.
+  @param line line from the last call to nextLine(), or a held line.
+  @return the offset of the line.
+*/
+size_t lineOffset(Input *in, char const *line)
+{
+  return in->base + (line - in->data);
+}
+
+/**
+  Get a line back from its offset in the whole input.
+
+  @param in input the line came from.
+  @param offset offset of the line, it must be held.
+  @return the start of the line.
+*/
+char const *lineAt(Input *in, size_t offset)
+{
+  return in->data + (offset - in->base);
+}
+
+/**
+  Keep the bytes from the given offset on in the input's buffer.
+
+  @param in input to hold lines of.
+  @param offset offset of the first line to keep.
+*/
+void holdInput(Input *in, size_t offset)
+{
+  in->holding = true;
+  in->hold = offset;
+}
+
+/**
+  Stop keeping any held lines in the input's buffer.
+
+  @param in input to release.
+*/
+void releaseInput(Input *in)
+{
+  in->holding = false;
+}
+
+/**
+  Close the given input and free its memory.
+
+  @param in input to close.
+*/
+void closeInput(Input *in)
+{
+  if (in->mapped){
+    munmap(in->data, in->size);
+  } else if (!in->borrowed){
+    free(in->data);
+  }
+  if (in->fd >= 0 && in->fd != STDIN_FILENO){
+    close(in->fd);
+  }
+  free(in);
+}
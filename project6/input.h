@@ -0,0 +1,121 @@
+/**
+  This is the header file for the input component, a buffered line
+  scanner that hands out lines as slices of its buffer, with no limit on
+  their length.  Lines can be held in the buffer, to print them after
+  reading further, without copying them.
+
+  @file input.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** A short name to use for an open input. */
+typedef struct InputStruct Input;
+
+/**
+  Open the given file for reading lines.  Regular files are memory
+  mapped, anything else (including standard input) is read in large
+  blocks.
+
+  @param filename name of the file to read, or NULL for standard input.
+  @return A dynamically allocated input, or NULL if the file can't be
+          opened.
+*/
+Input *openInput(char const *filename);
+
+/**
+  Make an input that reads lines from bytes already in memory, such as
+  a chunk of a mapped file.  The bytes aren't copied, so they must
+  outlive the input.
+
+  @param data bytes to read.
+  @param size number of bytes.
+  @return A dynamically allocated input.
+*/
+Input *openMemory(char const *data, size_t size);
+
+/**
+  Get all the bytes of an input that's in memory as a whole, like a
+  memory mapped file.
+
+  @param in input to look at.
+  @param data set to the start of the bytes.
+  @param size set to the number of bytes.
+  @return true if the input is in memory, false if it's read in blocks.
+*/
+bool inputData(Input *in, char const **data, size_t *size);
+
+/**
+  Get the next line of input, without its newline.  The line is a slice
+  of the input's buffer; it is not NUL-terminated and it's only valid
+  until the next call to nextLine() or closeInput().  A last line
+  without a trailing newline is still reported.
+
+  @param in input to read from.
+  @param line set to the start of the line.
+  @param len set to the length of the line.
+  @return true if a line was read, false at the end of input.
+*/
+bool nextLine(Input *in, char const **line, int *len);
+
+/**
+  Check if the input looks like a binary file, with a NUL byte in its
+  first block.  Nothing is taken from the input, a stream just has its
+  first block read into the buffer.
+
+  @param in input to check, before any lines are read.
+  @return true if the input looks binary.
+*/
+bool looksBinary(Input *in);
+
+/**
+  Get where a line is in the whole input, to get it back with lineAt()
+  after more lines are read, as long as it's held with holdInput().
+
+  @param in input the line came from.
+  @param line line from the last call to nextLine(), or a held line.
+  @return the offset of the line.
+*/
+size_t lineOffset(Input *in, char const *line);
+
+/**
+  Get a line back from its offset in the whole input.  The pointer is
+  only valid until the next call to nextLine().
+
+  @param in input the line came from.
+  @param offset offset of the line from lineOffset(), it must be held.
+  @return the start of the line.
+*/
+char const *lineAt(Input *in, size_t offset);
+
+/**
+  Keep the bytes from the given offset on in the input's buffer, so the
+  lines there can still be got with lineAt() after reading further.  It
+  replaces any earlier hold.  Memory for the buffer grows with the bytes
+  held, so only the lines that may still be needed should be.
+
+  @param in input to hold lines of.
+  @param offset offset of the first line to keep, from lineOffset().
+*/
+void holdInput(Input *in, size_t offset);
+
+/**
+  Stop keeping any held lines in the input's buffer.
+
+  @param in input to release.
+*/
+void releaseInput(Input *in);
+
+/**
+  Close the given input and free its memory.
+
+  @param in input to close.
+*/
+void closeInput(Input *in);
+
+#endif
@@ -0,0 +1,450 @@
+/**
+  Implementation of the parallel component.  The main thread takes the
+  files from the walker and cuts them into jobs, newline-aligned chunks
+  of mapped files or whole files that can only be read as a stream.
+  Files found by walking a directory are usually small and many, so
+  they're each a single job, opened by the worker that searches it, and
+  the main thread does nothing for them but find them.  Worker threads each
+  have their own Scanner, and print each job into a memory buffer.  Jobs
+  sit in a fixed window, and whichever thread finishes the oldest job
+  writes out every finished job in order, so the output is the same as
+  searching the files one line at a time.  The writer also keeps the
+  count of matching lines for each file, cutting off output past the -m
+  limit and telling the workers to skip the rest of a file once it's
+  reached.  With context lines, files aren't cut up, since the context
+  of a match can be in the next chunk.  Files that look binary are
+  checked once, when they're opened, and are either skipped or searched
+  whole for one match.
+
+  @file parallel.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+// Size a mapped file is cut into jobs at, before moving to a line end.
+#define CHUNK_SIZE (4 * 1024 * 1024)
+
+// Number of jobs allowed in flight for each worker thread.
+#define JOBS_PER_THREAD 4
+
+/** A file being searched, shared by the jobs for its chunks. */
+typedef struct {
+  /** Input for the file, or NULL until a worker opens it. */
+  Input *in;
+  /** Name of the file, a copy owned by the file. */
+  char *name;
+  /** Name printed before each matching line, or NULL. */
+  char const *label;
+  /** Number of jobs (plus one while it's being cut up) still using it. */
+  int users;
+  /** Matching lines written out so far. */
+  long matches;
+  /** True once the match limit is reached, so the rest is skipped. */
+  bool stop;
+  /** True if the file looks binary, and only a message is printed if it
+      matches. */
+  bool binary;
+  /** True if a worker couldn't open the file. */
+  bool failed;
+} File;
+
+/** A piece of work for one thread. */
+typedef struct {
+  /** File the job is part of. */
+  File *file;
+  /** Chunk of the file to search, or NULL to read the whole file. */
+  char const *data;
+  /** Size of the chunk. */
+  size_t size;
+  /** Matching lines printed by the job. */
+  char *output;
+  /** Size of output. */
+  size_t outputSize;
+  /** Number of matching lines the job found. */
+  long matches;
+  /** True once the job has been searched. */
+  bool done;
+} Job;
+
+/** State shared by the main thread and the workers. */
+typedef struct {
+  /** Search being matched. */
+  Search const *search;
+  /** Totals for the workers' scratch memory, added to as they finish. */
+  ArenaStats *stats;
+  /** Lock for everything below. */
+  pthread_mutex_t lock;
+  /** Signaled when a job is queued, or when no more are coming. */
+  pthread_cond_t ready;
+  /** Signaled when jobs leave the window, once it's down to half full,
+      so a main thread waiting for room queues a batch of jobs at a time
+      rather than taking turns with the writer one job at a time. */
+  pthread_cond_t room;
+  /** Jobs in flight, job number seq is at window[ seq % windowSize ]. */
+  Job *window;
+  int windowSize;
+  /** Number of jobs queued, taken by a worker and written out so far. */
+  long queued, taken, written;
+  /** True once the main thread has queued every job. */
+  bool finished;
+  /** Matching lines written out for every file. */
+  long matches;
+  /** True once nothing more needs to be searched at all. */
+  bool quit;
+  /** True once any output is written, so with context lines the next
+      file's output is separated from it. */
+  bool printed;
+  /** True if a worker couldn't open a file. */
+  bool failed;
+} Pool;
+
+/**
+  Drop one use of a file, closing it when nothing uses it anymore.  Its
+  count or name is printed then, since every job before it has been
+  written out.  The pool must be locked.
+
+  @param pool pool the file is searched in.
+  @param file file to release.
+*/
+static void releaseFile(Pool *pool, File *file)
+{
+  if (--file->users == 0){
+    if (file->failed){
+      pool->failed = true;
+    } else {
+      reportInput(pool->search, stdout, file->name, file->label != NULL,
+                  file->matches);
+    }
+    if (file->in){
+      closeInput(file->in);
+    }
+    free(file->name);
+    free(file);
+  }
+}
+
+/**
+  Get the size of the first lines of the output.
+
+  @param output output of a job, one line for each match.
+  @param size size of output.
+  @param lines number of lines to measure.
+  @return the size of those lines.
+*/
+static size_t linesSize(char const *output, size_t size, long lines)
+{
+  size_t pos = 0;
+  for (long i = 0; i < lines; i++){
+    pos = (char const *) memchr(output + pos, '\n', size - pos) - output + 1;
+  }
+  return pos;
+}
+
+/**
+  Check if the search prints context lines around the matching lines.
+
+  @param search search to check.
+  @return true if it does.
+*/
+static bool hasContext(Search const *search)
+{
+  return search->mode == PRINT_LINES && (search->before > 0 || search->after > 0);
+}
+
+/**
+  Write out finished jobs from the front of the window, in order.  The
+  pool must be locked.
+
+  @param pool pool to write from.
+*/
+static void writeFinishedJobs(Pool *pool)
+{
+  long limit = matchLimit(pool->search);
+  while (pool->written < pool->taken){
+    Job *job = pool->window + pool->written % pool->windowSize;
+    if (!job->done){
+      break;
+    }
+    File *file = job->file;
+    long lines = job->matches;
+    if (limit >= 0 && lines > limit - file->matches){
+      // The job's chunk went past the limit for its file.
+      lines = limit - file->matches;
+    }
+    // Only PRINT_LINES mode has any output to cut short.
+    size_t size = lines < job->matches && pool->search->mode == PRINT_LINES
+      ? linesSize(job->output, job->outputSize, lines) : job->outputSize;
+    if (size > 0){
+      if (pool->printed && hasContext(pool->search)){
+        fputs("--\n", stdout);
+      }
+      fwrite(job->output, 1, size, stdout);
+      pool->printed = true;
+    }
+    file->matches += lines;
+    pool->matches += lines;
+    if (file->matches == limit){
+      file->stop = true;
+    }
+    if (pool->search->mode == PRINT_NOTHING && pool->matches > 0){
+      pool->quit = true;
+    }
+    free(job->output);
+    releaseFile(pool, file);
+    pool->written++;
+    if (pool->queued - pool->written <= pool->windowSize / 2){
+      pthread_cond_broadcast(&pool->room);
+    }
+  }
+}
+
+/**
+  Check if a newly opened file looks binary, and how it's searched if it
+  does.
+
+  @param search search the file is part of.
+  @param file file to check.
+  @return false if the file is skipped.
+*/
+static bool checkBinary(Search const *search, File *file)
+{
+  file->binary = false;
+  if (search->binary == BINARY_TEXT || !looksBinary(file->in)){
+    return true;
+  }
+  file->binary = search->mode == PRINT_LINES;
+  return search->binary != BINARY_SKIP;
+}
+
+/**
+  Search one job, printing its matching lines into the job's buffer.  A
+  file that isn't open yet is opened first, it's the only job for it.
+
+  @param search search being matched.
+  @param sc scanner of the thread running the job.
+  @param job job to search.
+*/
+static void runJob(Search const *search, Scanner *sc, Job *job)
+{
+  File *file = job->file;
+  if (!file->in){
+    file->in = openInput(file->name);
+    if (!file->in){
+      fprintf(stderr, "Can't open input file: %s\n", file->name);
+      file->failed = true;
+      return;
+    }
+    if (!checkBinary(search, file)){
+      return;
+    }
+  }
+
+  FILE *out = open_memstream(&job->output, &job->outputSize);
+  if (job->file->binary){
+    job->matches = scanBinaryInput(sc, job->file->in, job->file->name, out);
+  } else if (job->data){
+    Input *chunk = openMemory(job->data, job->size);
+    job->matches = scanInput(sc, chunk, job->file->label, out);
+    closeInput(chunk);
+  } else {
+    job->matches = scanInput(sc, job->file->in, job->file->label, out);
+  }
+  fclose(out);
+}
+
+/**
+  Body of a worker thread, taking jobs in order until there are none left.
+
+  @param arg the pool.
+  @return NULL
+*/
+static void *worker(void *arg)
+{
+  Pool *pool = (Pool *) arg;
+  Scanner *sc = makeScanner(pool->search);
+
+  pthread_mutex_lock(&pool->lock);
+  while (true){
+    while (pool->taken == pool->queued && !pool->finished){
+      pthread_cond_wait(&pool->ready, &pool->lock);
+    }
+    if (pool->taken == pool->queued){
+      break;
+    }
+    Job *job = pool->window + pool->taken++ % pool->windowSize;
+    // Jobs after the limit for their file can't print anything.
+    bool skip = job->file->stop || pool->quit;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!skip){
+      runJob(pool->search, sc, job);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    job->done = true;
+    writeFinishedJobs(pool);
+  }
+  scannerStats(sc, pool->stats);
+  pthread_mutex_unlock(&pool->lock);
+
+  freeScanner(sc);
+  return NULL;
+}
+
+/**
+  Queue a job, waiting for room in the window if it's full.
+
+  @param pool pool to queue the job in.
+  @param file file the job is part of.
+  @param data chunk to search, or NULL for the whole file.
+  @param size size of the chunk.
+  @return false if the file is done with, and the job wasn't queued.
+*/
+static bool queueJob(Pool *pool, File *file, char const *data, size_t size)
+{
+  pthread_mutex_lock(&pool->lock);
+  while (pool->queued - pool->written >= pool->windowSize){
+    pthread_cond_wait(&pool->room, &pool->lock);
+  }
+  if (file->stop || pool->quit){
+    pthread_mutex_unlock(&pool->lock);
+    return false;
+  }
+  Job *job = pool->window + pool->queued % pool->windowSize;
+  job->file = file;
+  job->data = data;
+  job->size = size;
+  job->output = NULL;
+  job->outputSize = 0;
+  job->matches = 0;
+  job->done = false;
+  file->users++;
+  pool->queued++;
+  pthread_cond_signal(&pool->ready);
+  pthread_mutex_unlock(&pool->lock);
+  return true;
+}
+
+/**
+  Search the given files, printing matching lines to standard output.
+
+  @param search search to match lines against.
+  @param walker walker handing out the files to search.
+  @param threads number of worker threads to use, at least 1.
+  @param labels true if each line is printed with its file name.
+  @param stats totals the workers' scratch memory counters are added to.
+  @param matches set to the number of matching lines written out.
+  @return true if every file and directory could be opened.
+*/
+bool searchFiles(Search const *search, Walker *walker, int threads,
+                 bool labels, ArenaStats *stats, long *matches)
+{
+  Pool pool;
+  pool.search = search;
+  pool.stats = stats;
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.ready, NULL);
+  pthread_cond_init(&pool.room, NULL);
+  pool.windowSize = threads * JOBS_PER_THREAD;
+  pool.window = (Job *) malloc(pool.windowSize * sizeof(Job));
+  pool.queued = pool.taken = pool.written = 0;
+  pool.finished = false;
+  pool.matches = 0;
+  pool.quit = false;
+  pool.printed = false;
+  pool.failed = false;
+
+  pthread_t workers[threads];
+  for (int i = 0; i < threads; i++){
+    pthread_create(workers + i, NULL, worker, &pool);
+  }
+
+  bool opened = true;
+  char const *name;
+  bool listed;
+  while ((name = nextFile(walker, &listed))){
+    pthread_mutex_lock(&pool.lock);
+    bool quit = pool.quit;
+    pthread_mutex_unlock(&pool.lock);
+    if (quit){
+      break;
+    }
+    File *file = (File *) malloc(sizeof(File));
+    file->in = NULL;
+    file->name = (char *) malloc(strlen(name) + 1);
+    strcpy(file->name, name);
+    file->label = labels ? file->name : NULL;
+    file->users = 1;
+    file->matches = 0;
+    file->stop = matchLimit(search) == 0;
+    file->binary = false;
+    file->failed = false;
+    if (listed){
+      file->in = openInput(name);
+      if (!file->in){
+        fprintf(stderr, "Can't open input file: %s\n", name);
+        opened = false;
+        free(file->name);
+        free(file);
+        continue;
+      }
+      // Skipped files still get their count of 0 when they're released.
+      file->stop = !checkBinary(search, file) || file->stop;
+    }
+
+    char const *data;
+    size_t size;
+    if (!file->in){
+      // Found in a directory, a worker opens it.
+      if (!file->stop){
+        queueJob(&pool, file, NULL, 0);
+      }
+    } else if (!file->stop && !file->binary && !hasContext(search) &&
+               inputData(file->in, &data, &size)){
+      // Cut the file into chunks that end just after a newline.
+      size_t pos = 0;
+      while (pos < size){
+        size_t end = pos + CHUNK_SIZE;
+        if (end >= size){
+          end = size;
+        } else {
+          char const *newline = memchr(data + end, '\n', size - end);
+          end = newline ? newline - data + 1 : size;
+        }
+        if (!queueJob(&pool, file, data + pos, end - pos)){
+          break;
+        }
+        pos = end;
+      }
+    } else if (!file->stop){
+      queueJob(&pool, file, NULL, 0);
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    releaseFile(&pool, file);
+    pthread_mutex_unlock(&pool.lock);
+  }
+
+  pthread_mutex_lock(&pool.lock);
+  pool.finished = true;
+  pthread_cond_broadcast(&pool.ready);
+  pthread_mutex_unlock(&pool.lock);
+  for (int i = 0; i < threads; i++){
+    pthread_join(workers[i], NULL);
+  }
+
+  *matches = pool.matches;
+  opened = opened && !pool.failed && !walkFailed(walker);
+  free(pool.window);
+  pthread_cond_destroy(&pool.room);
+  pthread_cond_destroy(&pool.ready);
+  pthread_mutex_destroy(&pool.lock);
+  return opened;
+}
@@ -0,0 +1,38 @@
+/**
+  This is the header file for the parallel component, which searches
+  the files handed out by a walker on a pool of worker threads while
+  keeping the output in the same order a single thread would print it.
+
+  @file parallel.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <stdbool.h>
+#include "search.h"
+#include "walk.h"
+
+/**
+  Search the files the walker hands out, printing matching lines to
+  standard output.  Files are searched while the walker is still
+  finding more.  Large files named as inputs are split into chunks at
+  line boundaries so one file can be spread over several threads.
+  Files and directories that can't be opened are reported on standard
+  error and skipped.  Once a file reaches the search's match limit, the
+  rest of it isn't searched, and in PRINT_NOTHING mode nothing is
+  searched after the first match.
+
+  @param search search to match lines against.
+  @param walker walker handing out the files to search.
+  @param threads number of worker threads to use, at least 1.
+  @param labels true if each line is printed with its file name.
+  @param stats totals the workers' scratch memory counters are added to.
+  @param matches set to the number of matching lines written out.
+  @return true if every file and directory could be opened.
+*/
+bool searchFiles(Search const *search, Walker *walker, int threads,
+                 bool labels, ArenaStats *stats, long *matches);
+
+#endif
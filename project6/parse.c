@@ -376,3 +376,20 @@ Pattern *parsePattern(char const *str)
   }
   return pat;
 }
+
+/** Simplify a parsed pattern into one that matches the same strings
+    with fewer nodes.
+
+    @param pat pattern to optimize, used up.
+    @param before set to the number of nodes in pat.
+    @param after set to the number of nodes in the result.
+    @return pointer to the optimized pattern.
+*/
+Pattern *optimizePattern(Pattern *pat, int *before, int *after)
+{
+  // Each node simplifies its sub-patterns before itself.
+  *before = pat->nodes(pat);
+  pat = pat->optimize(pat);
+  *after = pat->nodes(pat);
+  return pat;
+}
@@ -17,4 +17,17 @@
 ***/
 Pattern *parsePattern( char const *str );
 
+/** Simplify a parsed pattern into one that matches the same strings
+    with fewer nodes: runs of literals are fused into strings,
+    alternations of single symbols become character classes, nested
+    repetitions are collapsed and alternatives starting with the same
+    symbols are factored.
+
+    @param pat pattern to optimize, used up.
+    @param before set to the number of nodes in pat.
+    @param after set to the number of nodes in the result.
+    @return pointer to the optimized pattern.
+***/
+Pattern *optimizePattern( Pattern *pat, int *before, int *after );
+
 #endif
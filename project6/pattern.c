@@ -6,9 +6,13 @@
 */
 
 #include "pattern.h"
+#include "program.h"
+#include "prefilter.h"
+#include "byteset.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <limits.h>
 
 /**
    Type of pattern used to represent a single, ordinary symbol,
@@ -16,25 +20,65 @@
 */
 typedef struct {
   // Fields from our superclass.
-  void (*match)(Pattern *pat, char const *str, int len, bool (*table)[len + 1]);
+  void (*match)(Pattern *pat, char const *str, int len, MatchTable *table, Arena *arena);
+  void (*compile)(Pattern *pat, Program *prog);
+  void (*literals)(Pattern *pat, Literals *info);
+  Pattern *(*optimize)(Pattern *pat);
+  int (*nodes)(Pattern *pat);
   void (*destroy)(Pattern *pat);
 
   /** Symbol this pattern is supposed to match. */
   char sym;
+  /** Set holding just sym. */
+  ByteSet set;
 } LiteralPattern;
 
+/**
+  Mark every character of the string that's in the set as a matching,
+  1-character substring.  Literals, '.' and character classes all match
+  this way.
+
+  @param *set pointer to the set of bytes the pattern matches.
+  @param *str pointer to the given string.
+  @param len length of the given string.
+  @param *table pointer to the table to fill in.
+*/
+static void matchByteSet(ByteSet const *set, char const *str, int len,
+                         MatchTable *table)
+{
+  for (int i = findByteInSet(set, str, 0, len); i < len;
+       i = findByteInSet(set, str, i + 1, len)){
+    setTableBit(table, i, i + 1);
+  }
+}
+
 // Overridden match() method for a LiteralPattern
 static void matchLiteralPattern(Pattern *pat, char const *str, int len,
-                                 bool (*table)[len + 1 ])
+                                 MatchTable *table, Arena *arena)
 {
   // Cast down to the struct type pat really points to.
   LiteralPattern *this = (LiteralPattern *) pat;
 
   // Find all occurreces of the symbol we're supposed to match, and
   // mark them in the match table as matching, 1-character substrings.
-  for ( int i = 0; i < len; i++ )
-    if ( str[i] == this->sym )
-      table[i][i + 1] = true;
+  matchByteSet(&this->set, str, len, table);
+}
+
+// Overridden compile() method for a LiteralPattern
+static void compileLiteralPattern(Pattern *pat, Program *prog)
+{
+  LiteralPattern *this = (LiteralPattern *) pat;
+
+  int pc = emitInstruction(prog, OP_CHAR);
+  prog->code[pc].c = this->sym;
+}
+
+// Overridden literals() method for a LiteralPattern
+static void literalsLiteralPattern(Pattern *pat, Literals *info)
+{
+  LiteralPattern *this = (LiteralPattern *) pat;
+
+  exactLiterals(info, &this->sym, 1);
 }
 
 /**
@@ -53,6 +97,19 @@ static void destroySimplePattern(Pattern *pat)
   free(pat);
 }
 
+// Overridden optimize() method for patterns with nothing to simplify,
+// like a LiteralPattern.
+static Pattern *optimizeSimplePattern(Pattern *pat)
+{
+  return pat;
+}
+
+// Overridden nodes() method for patterns with no sub-patterns.
+static int nodesSimplePattern(Pattern *pat)
+{
+  return 1;
+}
+
 /**
   Make a pattern for a single, non-special character, like `a` or `5`.
 
@@ -65,31 +122,143 @@ Pattern *makeLiteralPattern(char sym)
   LiteralPattern *this = (LiteralPattern *) malloc( sizeof( LiteralPattern ) );
 
   this->match = matchLiteralPattern;
+  this->compile = compileLiteralPattern;
+  this->literals = literalsLiteralPattern;
+  this->optimize = optimizeSimplePattern;
+  this->nodes = nodesSimplePattern;
   this->destroy = destroySimplePattern;
   this->sym = sym;
+  clearByteSet(&this->set);
+  addByte(&this->set, sym);
 
   return (Pattern *) this;
 }
 
+/**
+   Type of pattern used to represent a run of ordinary symbols matched
+   one after another, like "abc".  The parser never makes one, the
+   optimizer puts one in place of a chain of literals.
+*/
+typedef struct {
+  // Fields from our superclass.
+  void (*match)(Pattern *pat, char const *str, int len, MatchTable *table, Arena *arena);
+  void (*compile)(Pattern *pat, Program *prog);
+  void (*literals)(Pattern *pat, Literals *info);
+  Pattern *(*optimize)(Pattern *pat);
+  int (*nodes)(Pattern *pat);
+  void (*destroy)(Pattern *pat);
+
+  /** Symbols this pattern is supposed to match, in order. */
+  char *str;
+  /** Number of symbols in str. */
+  int len;
+} StringPattern;
+
+// Overridden match() method for a StringPattern
+static void matchStringPattern(Pattern *pat, char const *str, int len,
+                               MatchTable *table, Arena *arena)
+{
+  StringPattern *this = (StringPattern *) pat;
+
+  // Every occurrence is a match from where it starts to where it ends.
+  for (int begin = 0; begin + this->len <= len; begin++){
+    if (memcmp(str + begin, this->str, this->len) == 0){
+      setTableBit(table, begin, begin + this->len);
+    }
+  }
+}
+
+// Overridden compile() method for a StringPattern, one OP_CHAR for each
+// symbol, just like the literals it replaced.
+static void compileStringPattern(Pattern *pat, Program *prog)
+{
+  StringPattern *this = (StringPattern *) pat;
+
+  for (int i = 0; i < this->len; i++){
+    int pc = emitInstruction(prog, OP_CHAR);
+    prog->code[pc].c = this->str[i];
+  }
+}
+
+// Overridden literals() method for a StringPattern
+static void literalsStringPattern(Pattern *pat, Literals *info)
+{
+  StringPattern *this = (StringPattern *) pat;
+
+  exactLiterals(info, this->str, this->len);
+}
+
+// destroy function used for StringPattern
+static void destroyStringPattern(Pattern *pat)
+{
+  StringPattern *this = (StringPattern *) pat;
+  free(this->str);
+  free(this);
+}
+
+/**
+  Make a pattern for a run of ordinary symbols.
+
+  @param str the symbols this pattern is supposed to match, copied.
+  @param len number of symbols, at least 1.
+  @return A dynamically allocated representation for this new pattern.
+*/
+static Pattern *makeStringPattern(char const *str, int len)
+{
+  StringPattern *this = (StringPattern *) malloc(sizeof(StringPattern));
+
+  this->match = matchStringPattern;
+  this->compile = compileStringPattern;
+  this->literals = literalsStringPattern;
+  this->optimize = optimizeSimplePattern;
+  this->nodes = nodesSimplePattern;
+  this->destroy = destroyStringPattern;
+  this->str = (char *) malloc(len + 1);
+  memcpy(this->str, str, len);
+  this->str[len] = '\0';
+  this->len = len;
+  return (Pattern *) this;
+}
+
 /**
    Type of pattern used to represent any character specified with '.'
 */
 typedef struct {
   // Fields from our superclass.
-  void (*match)(Pattern *pat, char const *str, int len, bool (*table)[len + 1]);
+  void (*match)(Pattern *pat, char const *str, int len, MatchTable *table, Arena *arena);
+  void (*compile)(Pattern *pat, Program *prog);
+  void (*literals)(Pattern *pat, Literals *info);
+  Pattern *(*optimize)(Pattern *pat);
+  int (*nodes)(Pattern *pat);
   void (*destroy)(Pattern *pat);
+
+  /** Every byte, lines are matched by length, so NUL is a byte like any
+      other. */
+  ByteSet set;
 } DotPattern;
 
 // Overridden match() method for a DotPattern
 static void matchDotPattern(Pattern *pat, char const *str, int len,
-                                 bool (*table)[len + 1])
+                                 MatchTable *table, Arena *arena)
 {
+  DotPattern *this = (DotPattern *) pat;
+
   // Find all occurreces of the any symbol and mark them as true.
   // mark them in the match table as matching, 1-character substrings.
-  for ( int i = 0; i < len; i++ )
-    if (str[i]){
-      table[i][i + 1] = true;
-    }
+  matchByteSet(&this->set, str, len, table);
+}
+
+// Overridden compile() method for a DotPattern
+static void compileDotPattern(Pattern *pat, Program *prog)
+{
+  emitInstruction(prog, OP_ANY);
+}
+
+// Overridden literals() method for patterns that match a different
+// string every time, like a DotPattern.
+static void literalsUnknownPattern(Pattern *pat, Literals *info)
+{
+  unknownLiterals(info);
 }
 
 /**
@@ -103,7 +272,13 @@ Pattern *makeDotPattern()
   DotPattern *this = (DotPattern *) malloc(sizeof(DotPattern));
 
   this->match = matchDotPattern;
+  this->compile = compileDotPattern;
+  this->literals = literalsUnknownPattern;
+  this->optimize = optimizeSimplePattern;
+  this->nodes = nodesSimplePattern;
   this->destroy = destroySimplePattern;
+  clearByteSet(&this->set);
+  invertByteSet(&this->set);
   return (Pattern *) this;
 }
 
@@ -112,7 +287,11 @@ Pattern *makeDotPattern()
 */
 typedef struct {
   // Fields from our superclass.
-  void (*match)(Pattern *pat, char const *str, int len, bool (*table)[ len + 1 ] );
+  void (*match)(Pattern *pat, char const *str, int len, MatchTable *table, Arena *arena);
+  void (*compile)(Pattern *pat, Program *prog);
+  void (*literals)(Pattern *pat, Literals *info);
+  Pattern *(*optimize)(Pattern *pat);
+  int (*nodes)(Pattern *pat);
   void (*destroy)(Pattern *pat);
   Pattern *p;
   // Anchor type
@@ -121,7 +300,7 @@ typedef struct {
 
 // Overridden match() method for a AnchorPattern
 static void matchAnchorPattern(Pattern *pat, char const *str, int len,
-                                 bool (*table)[len + 1])
+                                 MatchTable *table, Arena *arena)
 {
   // Find all occurreces of the any symbol and mark them as true.
   // mark them in the match table as matching, 1-character substrings.
@@ -130,20 +309,72 @@ static void matchAnchorPattern(Pattern *pat, char const *str, int len,
   if (!anchor->p){
     return;
   }
-  bool (*tbl)[len + 1]  = calloc((len + 1) * (len + 1), sizeof(bool));
-  anchor->p->match(anchor->p, str, len, tbl);
-  for (int begin = 0; begin <= len; begin++ ){
-    if (anchor->anchor_type == START){
-      if (tbl[0][begin]){
-          table[0][begin] = true;
-      }
-    } else{ //anchor_type == END
-      if (tbl[begin][len]){
-          table[begin][len] = true;
+  // The sub-table is scratch, given back to the arena when done.
+  ArenaMark mark = markArena(arena);
+  MatchTable *tbl = makeTable(len, arena);
+  anchor->p->match(anchor->p, str, len, tbl, arena);
+  if (anchor->anchor_type == START){
+    // Only the matches starting at 0, the whole first row.
+    orRow(tableRow(table, 0), tableRow(tbl, 0), table->words);
+  } else{ //anchor_type == END
+    for (int begin = 0; begin <= len; begin++ ){
+      if (getTableBit(tbl, begin, len)){
+          setTableBit(table, begin, len);
       }
     }
   }
-  free(tbl);
+  releaseArena(arena, mark);
+}
+
+// Overridden compile() method for a AnchorPattern
+static void compileAnchorPattern(Pattern *pat, Program *prog)
+{
+  AnchorPattern *anchor = (AnchorPattern *) pat;
+
+  // The anchor is an assertion on the position before (^) or after ($)
+  // whatever the sub-pattern matches.
+  if (anchor->anchor_type == START){
+    emitInstruction(prog, OP_BOL);
+  }
+  if (anchor->p){
+    anchor->p->compile(anchor->p, prog);
+  }
+  if (anchor->anchor_type == END){
+    emitInstruction(prog, OP_EOL);
+  }
+}
+
+// Overridden literals() method for a AnchorPattern, anchors match no
+// characters of their own.
+static void literalsAnchorPattern(Pattern *pat, Literals *info)
+{
+  AnchorPattern *anchor = (AnchorPattern *) pat;
+
+  if (anchor->p){
+    anchor->p->literals(anchor->p, info);
+  } else {
+    exactLiterals(info, "", 0);
+  }
+}
+
+// Overridden optimize() method for a AnchorPattern, only the sub-pattern
+// can be simplified.
+static Pattern *optimizeAnchorPattern(Pattern *pat)
+{
+  AnchorPattern *anchor = (AnchorPattern *) pat;
+
+  if (anchor->p){
+    anchor->p = anchor->p->optimize(anchor->p);
+  }
+  return pat;
+}
+
+// Overridden nodes() method for a AnchorPattern
+static int nodesAnchorPattern(Pattern *pat)
+{
+  AnchorPattern *anchor = (AnchorPattern *) pat;
+
+  return 1 + (anchor->p ? anchor->p->nodes(anchor->p) : 0);
 }
 
 /**
@@ -159,6 +390,10 @@ Pattern *makeAnchorPattern(Pattern *p, int anchorType)
   AnchorPattern *this = (AnchorPattern *) malloc( sizeof(AnchorPattern));
 
   this->match = matchAnchorPattern;
+  this->compile = compileAnchorPattern;
+  this->literals = literalsAnchorPattern;
+  this->optimize = optimizeAnchorPattern;
+  this->nodes = nodesAnchorPattern;
   this->destroy = destroySimplePattern;
   this->p = p;
   this->anchor_type = anchorType;
@@ -171,52 +406,58 @@ Pattern *makeAnchorPattern(Pattern *p, int anchorType)
 */
 typedef struct {
   // Fields from our superclass.
-  void (*match)( Pattern *pat, char const *str, int len, bool (*table)[ len + 1 ] );
+  void (*match)(Pattern *pat, char const *str, int len, MatchTable *table, Arena *arena);
+  void (*compile)(Pattern *pat, Program *prog);
+  void (*literals)(Pattern *pat, Literals *info);
+  Pattern *(*optimize)(Pattern *pat);
+  int (*nodes)(Pattern *pat);
   void (*destroy)( Pattern *pat );
-  // pointer to the the symbols enclosed in character class
+  // pointer to the the symbols enclosed in character class, or NULL for
+  // a class made by the optimizer
   char *sym;
   // check if inverted
   bool inverted;
+  // the bytes the class matches
+  ByteSet set;
 } CharacterClassPattern;
 
-/**
-  Static helper to check if character in string found in symbols enclosed in
-  character class.
+// Overridden match() method for a CharacterClassPattern
+static void matchCharacterClassPattern( Pattern *pat, char const *str, int len,
+                                 MatchTable *table, Arena *arena)
+{
+  CharacterClassPattern *this = (CharacterClassPattern *) pat;
 
-  @param *str pointer to the string.
-  @param *sym pointer to the symbol in the character class.
-  @param inverted check if char should belong to the character class.
-*/
-static bool checkCharacterClass(char ch, char *sym, bool inverted)
+  matchByteSet(&this->set, str, len, table);
+}
+
+// Overridden compile() method for a CharacterClassPattern
+static void compileCharacterClassPattern(Pattern *pat, Program *prog)
 {
-  while (*sym){
-    if (ch == *sym){
-      if (inverted){
-        return false;
-      }
-      return true;
-    }
-    sym++;
-  }
-  if (inverted){
-    return true;
-  }
-  return false;
+  CharacterClassPattern *this = (CharacterClassPattern *) pat;
+
+  int pc = emitInstruction(prog, OP_CLASS);
+  prog->code[pc].set = &this->set;
 }
 
-// Overridden match() method for a CharacterClassPattern
-static void matchCharacterClassPattern( Pattern *pat, char const *str, int len,
-                                 bool (*table)[len + 1])
+// Overridden literals() method for a CharacterClassPattern, a class of
+// just one symbol is the same as that symbol.
+static void literalsCharacterClassPattern(Pattern *pat, Literals *info)
 {
   CharacterClassPattern *this = (CharacterClassPattern *) pat;
 
-  for ( int i = 0; i < len; i++ ){
-    char *ch = this->sym;
-    if (checkCharacterClass(str[i], ch, this->inverted)){
-      table[i][i + 1] = true;
+  int members = 0;
+  char only = '\0';
+  for (int c = 0; c <= UCHAR_MAX; c++){
+    if (inByteSet(&this->set, c)){
+      members++;
+      only = c;
     }
   }
-
+  if (members == 1 && only){
+    exactLiterals(info, &only, 1);
+  } else {
+    unknownLiterals(info);
+  }
 }
 
 // destroy function used for CharacterClassPattern
@@ -227,6 +468,30 @@ static void destroyCharacterClassPattern(Pattern *pat)
   free(this);
 }
 
+/**
+  Make a character class matching the given bytes, for the optimizer to
+  put in place of an alternation of single symbols.  It has no symbols
+  string, only the set.
+
+  @param *set pointer to the bytes the class matches, copied.
+  @return A dynamically allocated representation for this new pattern.
+*/
+static Pattern *makeByteSetPattern(ByteSet const *set)
+{
+  CharacterClassPattern *this = (CharacterClassPattern *) malloc( sizeof(CharacterClassPattern));
+
+  this->match = matchCharacterClassPattern;
+  this->compile = compileCharacterClassPattern;
+  this->literals = literalsCharacterClassPattern;
+  this->optimize = optimizeSimplePattern;
+  this->nodes = nodesSimplePattern;
+  this->destroy = destroyCharacterClassPattern;
+  this->sym = NULL;
+  this->inverted = false;
+  this->set = *set;
+  return (Pattern *) this;
+}
+
 /**
   Make a pattern for the character class.
 
@@ -240,9 +505,22 @@ Pattern *makeCharacterClassPattern(char * sym, bool inverted)
   CharacterClassPattern *this = (CharacterClassPattern *) malloc( sizeof(CharacterClassPattern));
 
   this->match = matchCharacterClassPattern;
+  this->compile = compileCharacterClassPattern;
+  this->literals = literalsCharacterClassPattern;
+  this->optimize = optimizeSimplePattern;
+  this->nodes = nodesSimplePattern;
   this->destroy = destroyCharacterClassPattern;
   this->sym = sym;
   this->inverted = inverted;
+  // The string terminator is never one of the symbols, but an inverted
+  // class matches it.
+  clearByteSet(&this->set);
+  for (char *ch = sym; *ch; ch++){
+    addByte(&this->set, *ch);
+  }
+  if (inverted){
+    invertByteSet(&this->set);
+  }
   return (Pattern *) this;
 }
 
@@ -251,7 +529,11 @@ Pattern *makeCharacterClassPattern(char * sym, bool inverted)
 */
 typedef struct {
   // Fields from our superclass.
-  void (*match)( Pattern *pat, char const *str, int len, bool (*table)[ len + 1 ] );
+  void (*match)(Pattern *pat, char const *str, int len, MatchTable *table, Arena *arena);
+  void (*compile)(Pattern *pat, Program *prog);
+  void (*literals)(Pattern *pat, Literals *info);
+  Pattern *(*optimize)(Pattern *pat);
+  int (*nodes)(Pattern *pat);
   void (*destroy)( Pattern *pat );
 
   // Pointers to the Pattern to repeat.
@@ -260,38 +542,124 @@ typedef struct {
   enum {PLUS, STAR, QUESTION} repetition_type;
 } RepetitionPattern;
 
+/**
+  Add to one row of a table every end reachable from the ends already
+  in it by more matches of the repeated pattern back to back.  Ends only
+  grow past the match being extended, so taking the set bits in
+  increasing order sees each new end before it is passed.
+
+  @param *table pointer to the table to fill in.
+  @param *tbl pointer to the table of the repeated pattern.
+  @param begin the row to fill in.
+*/
+static void closeRow(MatchTable *table, MatchTable const *tbl, int begin)
+{
+  int words = table->words;
+  uint64_t *row = tableRow(table, begin);
+  for (int i = begin / TABLE_WORD_BITS; i < words; i++){
+    uint64_t seen = 0;
+    for (uint64_t bits = row[i]; bits; bits = row[i] & ~seen){
+      uint64_t low = bits & -bits;
+      seen |= low;
+      int k = i * TABLE_WORD_BITS + __builtin_ctzll(low);
+      if (k != begin){
+        orRow(row + i, tableRow(tbl, k) + i, words - i);
+      }
+    }
+  }
+}
+
+/**
+  Fill in one row of a repetition's table, every end reachable from
+  begin by one or more matches of the repeated pattern back to back.
+
+  @param *table pointer to the table to fill in.
+  @param *tbl pointer to the table of the repeated pattern.
+  @param begin the row to fill in.
+*/
+static void repeatRow(MatchTable *table, MatchTable const *tbl, int begin)
+{
+  orRow(tableRow(table, begin), tableRow(tbl, begin), table->words);
+  closeRow(table, tbl, begin);
+}
+
 /**
   Function to match the repetition pattern based on syntax.
   @param *pat pointer to the pattern to repeat.
   @param *str pointer to the given string.
   @param len length of the given string.
   @param *table pointer to the 2D array representing subsequence of string.
+  @param *arena arena for scratch tables.
 */
 static void matchRepetitionPattern(Pattern *pat, char const *str, int len,
-                                       bool (*table)[len + 1])
+                                       MatchTable *table, Arena *arena)
 {
   RepetitionPattern *rep = (RepetitionPattern *)pat;
-  bool (*tbl)[len + 1]  = calloc((len + 1) * (len + 1), sizeof(bool));
-  rep->p->match(rep->p, str, len, tbl);
-  for (int begin = 0; begin <= len; begin++ ){
-    for (int end = begin; end <= len; end++ ) {
-      for ( int k = begin; k <= end; k++ ){
-        if (tbl[begin][k]){
-          table[begin][k] = true;
-        }
-        if (tbl[k][end]){
-          table[k][end] = true;
-        }
-        if (rep->repetition_type != QUESTION && table[begin][k] && table[k][end]){
-          table[begin][end] = true;
-        }
-      }
+  ArenaMark mark = markArena(arena);
+  MatchTable *tbl = makeTable(len, arena);
+  rep->p->match(rep->p, str, len, tbl, arena);
+  if (rep->repetition_type == QUESTION){
+    orRow(table->bits, tbl->bits, (len + 1) * table->words);
+  } else {
+    for (int begin = 0; begin <= len; begin++ ){
+      repeatRow(table, tbl, begin);
     }
   }
-  free(tbl);
+  releaseArena(arena, mark);
   if (rep->repetition_type == STAR || rep->repetition_type == QUESTION){
     //indication to skip match during concatenation
-    table[0][0] = true;
+    setTableBit(table, 0, 0);
+  }
+}
+
+/**
+  Function to compile the repetition pattern based on syntax.
+  @param *pat pointer to the pattern to repeat.
+  @param *prog pointer to the program being built.
+*/
+static void compileRepetitionPattern(Pattern *pat, Program *prog)
+{
+  RepetitionPattern *rep = (RepetitionPattern *)pat;
+
+  if (rep->repetition_type == PLUS){
+    // L1: p, split L1 L2, L2:
+    int loop = prog->count;
+    rep->p->compile(rep->p, prog);
+    int split = emitInstruction(prog, OP_SPLIT);
+    prog->code[split].x = loop;
+    prog->code[split].y = prog->count;
+  } else if (rep->repetition_type == STAR){
+    // L1: split L2 L3, L2: p, jmp L1, L3:
+    int split = emitInstruction(prog, OP_SPLIT);
+    rep->p->compile(rep->p, prog);
+    int jmp = emitInstruction(prog, OP_JMP);
+    prog->code[jmp].x = split;
+    prog->code[split].x = split + 1;
+    prog->code[split].y = prog->count;
+  } else { // repetition_type == QUESTION
+    // split L1 L2, L1: p, L2:
+    int split = emitInstruction(prog, OP_SPLIT);
+    rep->p->compile(rep->p, prog);
+    prog->code[split].x = split + 1;
+    prog->code[split].y = prog->count;
+  }
+}
+
+/**
+  Function to find literals of the repetition pattern.  Only a '+'
+  repetition is sure to contain its sub-pattern.
+  @param *pat pointer to the pattern to repeat.
+  @param *info pointer to the literals to fill in.
+*/
+static void literalsRepetitionPattern(Pattern *pat, Literals *info)
+{
+  RepetitionPattern *rep = (RepetitionPattern *)pat;
+
+  if (rep->repetition_type == PLUS){
+    rep->p->literals(rep->p, info);
+    repeatLiterals(info);
+  } else {
+    unknownLiterals(info);
   }
 }
 
@@ -307,6 +675,44 @@ static void destroyRepetitionPattern(Pattern *pat)
   free(this);
 }
 
+/**
+  Collapse a repetition of a repetition into one.  Repeating p+ one or
+  more times is p+, an optional p? is p?, and every other mix of '*',
+  '+' and '?' matches the same as p*.
+
+  @param *rep pointer to the outer repetition, used up.
+  @return the pattern to use in place of rep.
+*/
+static Pattern *collapseRepetition(RepetitionPattern *rep)
+{
+  if (rep->p->compile != compileRepetitionPattern){
+    return (Pattern *) rep;
+  }
+  RepetitionPattern *inner = (RepetitionPattern *) rep->p;
+  if (inner->repetition_type != rep->repetition_type){
+    inner->repetition_type = STAR;
+  }
+  free(rep);
+  return (Pattern *) inner;
+}
+
+// Overridden optimize() method for a RepetitionPattern
+static Pattern *optimizeRepetitionPattern(Pattern *pat)
+{
+  RepetitionPattern *rep = (RepetitionPattern *) pat;
+
+  rep->p = rep->p->optimize(rep->p);
+  return collapseRepetition(rep);
+}
+
+// Overridden nodes() method for a RepetitionPattern
+static int nodesRepetitionPattern(Pattern *pat)
+{
+  RepetitionPattern *rep = (RepetitionPattern *) pat;
+
+  return 1 + rep->p->nodes(rep->p);
+}
+
 /**
   Make a pattern for a repetition character, '*', '+', '?'
 
@@ -320,6 +726,10 @@ Pattern *makeRepetitionPattern(Pattern *p, int repetition_type)
   RepetitionPattern *this = (RepetitionPattern *) malloc(sizeof(RepetitionPattern));
 
   this->match = matchRepetitionPattern;
+  this->compile = compileRepetitionPattern;
+  this->literals = literalsRepetitionPattern;
+  this->optimize = optimizeRepetitionPattern;
+  this->nodes = nodesRepetitionPattern;
   this->destroy = destroyRepetitionPattern;
   this->p = p;
   this->repetition_type = repetition_type;
@@ -332,7 +742,11 @@ Pattern *makeRepetitionPattern(Pattern *p, int repetition_type)
 */
 typedef struct {
   // Fields from our superclass.
-  void (*match)( Pattern *pat, char const *str, int len, bool (*table)[ len + 1 ] );
+  void (*match)(Pattern *pat, char const *str, int len, MatchTable *table, Arena *arena);
+  void (*compile)(Pattern *pat, Program *prog);
+  void (*literals)(Pattern *pat, Literals *info);
+  Pattern *(*optimize)(Pattern *pat);
+  int (*nodes)(Pattern *pat);
   void (*destroy)( Pattern *pat );
 
   // Pointers to the Pattern to repeat in start and end range
@@ -341,49 +755,168 @@ typedef struct {
   int start, end;
 } ExtendedRepetitionPattern;
 
+/**
+  Fill in one row of an extended repetition's table by counting
+  repetitions.  The frontier holds the ends reached from begin by
+  exactly count matches of the repeated pattern, and each step moves it
+  along one more match.  Once count reaches start, every frontier is
+  added to the row, stopping at end (or, with no upper bound, taking
+  everything reachable after start).  Only the words between the first
+  and last ends in the frontier are touched, so a step costs about as
+  much as the matches it follows.
+
+  @param *table pointer to the table to fill in.
+  @param *tbl pointer to the table of the repeated pattern.
+  @param *rowEnd one past the last non-zero word of each row of tbl.
+  @param begin the row to fill in.
+  @param *rep pointer to the extended repetition pattern.
+  @param *arena arena for the frontier rows.
+*/
+static void countRow(MatchTable *table, MatchTable const *tbl, int const *rowEnd,
+                     int begin, ExtendedRepetitionPattern const *rep, Arena *arena)
+{
+  int words = table->words;
+  uint64_t *row = tableRow(table, begin);
+  ArenaMark mark = markArena(arena);
+  uint64_t *frontier = (uint64_t *) arenaAlloc(arena, words * sizeof(uint64_t));
+  uint64_t *next = (uint64_t *) arenaAlloc(arena, words * sizeof(uint64_t));
+  // The frontier's non-zero words are in [ lo, hi ).
+  int lo = begin / TABLE_WORD_BITS;
+  int hi = lo + 1;
+  frontier[lo] = (uint64_t) 1 << (begin % TABLE_WORD_BITS);
+
+  for (int count = 1; rep->end == -1 || count <= rep->end; count++){
+    // Take one more match from every end in the frontier.  Ends never
+    // move backward, so the next frontier starts at lo too.
+    int nextHi = lo;
+    for (int i = lo; i < hi; i++){
+      for (uint64_t bits = frontier[i]; bits; bits &= bits - 1){
+        int k = i * TABLE_WORD_BITS + __builtin_ctzll(bits);
+        if (rowEnd[k] > nextHi){
+          memset(next + nextHi, 0, (rowEnd[k] - nextHi) * sizeof(uint64_t));
+          nextHi = rowEnd[k];
+        }
+        if (rowEnd[k] > i){
+          orRow(next + i, tableRow(tbl, k) + i, rowEnd[k] - i);
+        }
+      }
+    }
+    while (lo < nextHi && !next[lo]){
+      lo++;
+    }
+    if (lo == nextHi){
+      break;
+    }
+    uint64_t *tmp = frontier;
+    frontier = next;
+    next = tmp;
+    hi = nextHi;
+
+    if (count >= rep->start){
+      orRow(row + lo, frontier + lo, hi - lo);
+      if (rep->end == -1){
+        // Any number of matches more, like a '*' after the last one.
+        closeRow(table, tbl, begin);
+        break;
+      }
+    }
+  }
+  releaseArena(arena, mark);
+}
+
 /**
   Function to match the extended repetition pattern based on syntax.
   @param *pat pointer to the pattern to repeat.
   @param *str pointer to the given string.
   @param len length of the given string.
   @param *table pointer to the 2D array representing subsequence of string.
+  @param *arena arena for scratch tables.
 */
 static void matchExtendedRepetitionPattern(Pattern *pat, char const *str, int len,
-                                       bool (*table)[len + 1])
+                                       MatchTable *table, Arena *arena)
 {
   ExtendedRepetitionPattern *rep = (ExtendedRepetitionPattern *)pat;
-  bool (*tbl)[len + 1]  = calloc((len + 1) * (len + 1), sizeof(bool));
-  bool (*init_tbl)[len + 1]  = calloc((len + 1) * (len + 1), sizeof(bool));
-  rep->p->match(rep->p, str, len, tbl);
+  ArenaMark mark = markArena(arena);
+  MatchTable *tbl = makeTable(len, arena);
+  rep->p->match(rep->p, str, len, tbl, arena);
+  int *rowEnd = (int *) arenaAlloc(arena, (len + 1) * sizeof(int));
   for (int begin = 0; begin <= len; begin++ ){
-    for (int end = begin; end <= len; end++ ) {
-      for ( int k = begin; k <= end; k++ ){
-        if (tbl[begin][k]){
-          init_tbl[begin][k] = true;
-        }
-        if (tbl[k][end]){
-          init_tbl[k][end] = true;
-        }
-        if (init_tbl[begin][k] && init_tbl[k][end]){
-            init_tbl[begin][end] = true;
-        }
-      }
+    uint64_t const *row = tableRow(tbl, begin);
+    rowEnd[begin] = tbl->words;
+    while (rowEnd[begin] > 0 && !row[rowEnd[begin] - 1]){
+      rowEnd[begin]--;
     }
   }
-  free(tbl);
   for (int begin = 0; begin <= len; begin++ ){
-    for (int end = begin; end <= len; end++ ) {
-        if (init_tbl[begin][end]){
-            if (end - begin >= rep->start && (end - begin <= rep->end || rep->end == -1)){
-              table[begin][end] = true;
-            }
-        }
-    }
+    countRow(table, tbl, rowEnd, begin, rep, arena);
   }
-  free(init_tbl);
+  releaseArena(arena, mark);
   if (rep->start == 0){
     //indication to skip match during concatenation
-    table[0][0] = true;
+    setTableBit(table, 0, 0);
+  }
+}
+
+/**
+  Function to compile the extended repetition pattern by unrolling it,
+  start mandatory copies of the sub-pattern followed by either a loop
+  (no upper bound) or end - start optional copies.
+  @param *pat pointer to the pattern to repeat.
+  @param *prog pointer to the program being built.
+*/
+static void compileExtendedRepetitionPattern(Pattern *pat, Program *prog)
+{
+  ExtendedRepetitionPattern *rep = (ExtendedRepetitionPattern *)pat;
+  int start = rep->start < 0 ? 0 : rep->start;
+
+  for (int i = 0; i < start; i++){
+    rep->p->compile(rep->p, prog);
+  }
+  if (rep->end == -1){
+    int split = emitInstruction(prog, OP_SPLIT);
+    rep->p->compile(rep->p, prog);
+    int jmp = emitInstruction(prog, OP_JMP);
+    prog->code[jmp].x = split;
+    prog->code[split].x = split + 1;
+    prog->code[split].y = prog->count;
+    return;
+  }
+  // Optional copies are nested, so each split skips all remaining copies.
+  int optional = rep->end - start;
+  int splits[optional > 0 ? optional : 1];
+  for (int i = 0; i < optional; i++){
+    splits[i] = emitInstruction(prog, OP_SPLIT);
+    prog->code[splits[i]].x = splits[i] + 1;
+    rep->p->compile(rep->p, prog);
+  }
+  for (int i = 0; i < optional; i++){
+    prog->code[splits[i]].y = prog->count;
+  }
+}
+
+/**
+  Function to find literals of the extended repetition pattern.  Every
+  match is start - 1 copies of the sub-pattern followed by one or more
+  copies, or exactly start copies if the count is fixed.
+  @param *pat pointer to the pattern to repeat.
+  @param *info pointer to the literals to fill in.
+*/
+static void literalsExtendedRepetitionPattern(Pattern *pat, Literals *info)
+{
+  ExtendedRepetitionPattern *rep = (ExtendedRepetitionPattern *)pat;
+
+  if (rep->start <= 0){
+    unknownLiterals(info);
+    return;
+  }
+  exactLiterals(info, "", 0);
+  for (int i = 0; i < rep->start; i++){
+    Literals copy;
+    rep->p->literals(rep->p, &copy);
+    if (i == rep->start - 1 && rep->end != rep->start){
+      repeatLiterals(&copy);
+    }
+    concatLiterals(info, &copy);
   }
 }
 
@@ -399,6 +932,46 @@ static void destroyExtendedRepetitionPattern(Pattern *pat)
   free(this);
 }
 
+/**
+  Overridden optimize() method for a ExtendedRepetitionPattern.  The
+  ranges that '*', '+' and '?' can say, and {1,1}, are replaced by them,
+  and repeating p* any number of times but 0 is p*.
+  @param *pat pointer to the pattern to optimize.
+  @return the pattern to use in place of pat.
+*/
+static Pattern *optimizeExtendedRepetitionPattern(Pattern *pat)
+{
+  ExtendedRepetitionPattern *rep = (ExtendedRepetitionPattern *) pat;
+  Pattern *p = rep->p->optimize(rep->p);
+  int start = rep->start < 0 ? 0 : rep->start;
+  int end = rep->end;
+
+  if (p->compile == compileRepetitionPattern &&
+      ((RepetitionPattern *) p)->repetition_type == STAR && end != 0){
+    free(rep);
+    return p;
+  }
+  if (start == 1 && end == 1){
+    free(rep);
+    return p;
+  }
+  if (start <= 1 && (end == -1 || end == 1)){
+    free(rep);
+    int type = end == 1 ? QUESTION : start == 0 ? STAR : PLUS;
+    return collapseRepetition((RepetitionPattern *) makeRepetitionPattern(p, type));
+  }
+  rep->p = p;
+  return pat;
+}
+
+// Overridden nodes() method for a ExtendedRepetitionPattern
+static int nodesExtendedRepetitionPattern(Pattern *pat)
+{
+  ExtendedRepetitionPattern *rep = (ExtendedRepetitionPattern *) pat;
+
+  return 1 + rep->p->nodes(rep->p);
+}
+
 /**
   Make a pattern for a extended repetition character, {m, n}
 
@@ -410,9 +983,13 @@ static void destroyExtendedRepetitionPattern(Pattern *pat)
 Pattern *makeExtendedRepetitionPattern(Pattern *p, int start, int end)
 {
   // Make an instance of RepetitionPattern, and fill in its state.
-  ExtendedRepetitionPattern *this = (ExtendedRepetitionPattern *) malloc(sizeof(RepetitionPattern));
+  ExtendedRepetitionPattern *this = (ExtendedRepetitionPattern *) malloc(sizeof(ExtendedRepetitionPattern));
 
   this->match = matchExtendedRepetitionPattern;
+  this->compile = compileExtendedRepetitionPattern;
+  this->literals = literalsExtendedRepetitionPattern;
+  this->optimize = optimizeExtendedRepetitionPattern;
+  this->nodes = nodesExtendedRepetitionPattern;
   this->destroy = destroyExtendedRepetitionPattern;
   this->p = p;
   this->start = start;
@@ -428,7 +1005,11 @@ Pattern *makeExtendedRepetitionPattern(Pattern *p, int start, int end)
 */
 typedef struct {
   // Fields from our superclass.
-  void (*match)(Pattern *pat, char const *str, int len, bool (*table)[len + 1]);
+  void (*match)(Pattern *pat, char const *str, int len, MatchTable *table, Arena *arena);
+  void (*compile)(Pattern *pat, Program *prog);
+  void (*literals)(Pattern *pat, Literals *info);
+  Pattern *(*optimize)(Pattern *pat);
+  int (*nodes)(Pattern *pat);
   void (*destroy)(Pattern *pat);
 
   // Pointers to the two sub-patterns.
@@ -448,6 +1029,108 @@ static void destroyBinaryPattern(Pattern *pat)
   free( this );
 }
 
+// Overridden nodes() method for a BinaryPattern
+static int nodesBinaryPattern(Pattern *pat)
+{
+  BinaryPattern *this = (BinaryPattern *) pat;
+
+  return 1 + this->p1->nodes(this->p1) + this->p2->nodes(this->p2);
+}
+
+/**
+  Count the patterns joined by a chain of binary patterns of one type,
+  like a concatenation of concatenations.
+
+  @param *pat pointer to the top of the chain.
+  @param compile compile() method of the type of binary pattern.
+  @return the number of patterns joined.
+*/
+static int chainLength(Pattern *pat, void (*compile)(Pattern *, Program *))
+{
+  if (pat->compile != compile){
+    return 1;
+  }
+  BinaryPattern *this = (BinaryPattern *) pat;
+  return chainLength(this->p1, compile) + chainLength(this->p2, compile);
+}
+
+/**
+  Take apart a chain of binary patterns of one type, adding the patterns
+  it joins to a list in order.  The binary patterns are freed.
+
+  @param *pat pointer to the top of the chain.
+  @param compile compile() method of the type of binary pattern.
+  @param **items list of patterns, with room for chainLength() more.
+  @param count number of patterns already in the list.
+  @return the number of patterns in the list now.
+*/
+static int takeChain(Pattern *pat, void (*compile)(Pattern *, Program *),
+                     Pattern **items, int count)
+{
+  if (pat->compile != compile){
+    items[count] = pat;
+    return count + 1;
+  }
+  BinaryPattern *this = (BinaryPattern *) pat;
+  count = takeChain(this->p1, compile, items, count);
+  count = takeChain(this->p2, compile, items, count);
+  free(this);
+  return count;
+}
+
+/**
+  Get the symbols matched by a LiteralPattern or StringPattern.
+
+  @param *pat pointer to the pattern.
+  @param **str set to the symbols.
+  @param *len set to the number of symbols.
+  @return false if pat is some other type of pattern.
+*/
+static bool symbolsOf(Pattern *pat, char const **str, int *len)
+{
+  if (pat->compile == compileLiteralPattern){
+    *str = &((LiteralPattern *) pat)->sym;
+    *len = 1;
+    return true;
+  }
+  if (pat->compile == compileStringPattern){
+    *str = ((StringPattern *) pat)->str;
+    *len = ((StringPattern *) pat)->len;
+    return true;
+  }
+  return false;
+}
+
+/**
+  Make a pattern for a run of ordinary symbols, a LiteralPattern if
+  there's just one.
+
+  @param str the symbols to match, copied.
+  @param len number of symbols, at least 1.
+  @return A dynamically allocated representation for this new pattern.
+*/
+static Pattern *makeSymbolsPattern(char const *str, int len)
+{
+  return len == 1 ? makeLiteralPattern(*str) : makeStringPattern(str, len);
+}
+
+/**
+  Join a list of patterns with concatenations, leaning left like the
+  parser builds them.
+
+  @param **items list of patterns, used up.
+  @param count number of patterns, at least 1.
+  @return the concatenation of the patterns.
+*/
+static Pattern *joinConcatenation(Pattern **items, int count)
+{
+  Pattern *pat = items[0];
+  for (int i = 1; i < count; i++){
+    pat = makeConcatenationPattern(pat, items[i]);
+  }
+  return pat;
+}
+
 /**
   Match for the concatenation pattern to concatenate the 2 sub-patterns.
 
@@ -455,43 +1138,108 @@ static void destroyBinaryPattern(Pattern *pat)
   @param *const str Pointer to the string to match.
   @param len length of the string.
   @param (*table) pointer to the 2D array representing subsequence of string.
+  @param *arena arena for scratch tables.
   @return A dynamically allocated representation for this new pattern.
 */
 
 static void matchConcatenationPattern(Pattern *pat, char const *str, int len,
-                                       bool (*table)[len + 1])
+                                       MatchTable *table, Arena *arena)
 {
   // Cast down to the struct type pat really points to.
   BinaryPattern *this = (BinaryPattern *) pat;
 
   // Two more tables for matching sub-expressions.
-  bool (*tbl1)[len + 1]  = calloc((len + 1) * (len + 1), sizeof(bool));
-  bool (*tbl2)[len + 1]  = calloc((len + 1) * (len + 1), sizeof(bool));
+  ArenaMark mark = markArena(arena);
+  MatchTable *tbl1 = makeTable(len, arena);
+  MatchTable *tbl2 = makeTable(len, arena);
 
   //  Let our two sub-patterns figure out everywhere they match.
-  this->p1->match(this->p1, str, len, tbl1);
-  this->p2->match(this->p2, str, len, tbl2);
+  this->p1->match(this->p1, str, len, tbl1, arena);
+  this->p2->match(this->p2, str, len, tbl2, arena);
 
   // Then, based on their matches, look for all places where their
-  // concatenaton matches.  Check all substrings of the input string.
-  for (int begin = 0; begin <= len; begin++)
-    for (int end = begin; end <= len; end++) {
-
-      // For the [ begin, end ) range, check all places where it could
-      // be split into two substrings, the first matching p1 and the second
-      // matching p2.
-      for ( int k = begin; k <= end; k++ ){
-        if (tbl1[begin][k] && tbl2[0][0]){
-          table[begin][k] = true;
-        }
-        if (tbl1[begin][k] && tbl2[k][end]){
-          table[begin][end] = true;
-        }
+  // concatenaton matches.  A match of p1 over [ begin, k ) followed by
+  // a match of p2 starting at k gives row k of tbl2 as ends for begin.
+  int words = table->words;
+  for (int begin = 0; begin <= len; begin++){
+    uint64_t *row = tableRow(table, begin);
+    uint64_t const *row1 = tableRow(tbl1, begin);
+    if (getTableBit(tbl2, 0, 0)){
+      orRow(row, row1, words);
+    }
+    for (int i = begin / TABLE_WORD_BITS; i < words; i++){
+      for (uint64_t bits = row1[i]; bits; bits &= bits - 1){
+        int k = i * TABLE_WORD_BITS + __builtin_ctzll(bits);
+        // Ends in row k are at least k, so the words before i stay as is.
+        orRow(row + i, tableRow(tbl2, k) + i, words - i);
       }
     }
+  }
+
+  releaseArena(arena, mark);
+}
+
+// Overridden compile() method for concatenation, p1 followed by p2.
+static void compileConcatenationPattern(Pattern *pat, Program *prog)
+{
+  BinaryPattern *this = (BinaryPattern *) pat;
 
-  free( tbl1 );
-  free( tbl2 );
+  this->p1->compile(this->p1, prog);
+  this->p2->compile(this->p2, prog);
+}
+
+// Overridden literals() method for concatenation, p1 followed by p2.
+static void literalsConcatenationPattern(Pattern *pat, Literals *info)
+{
+  BinaryPattern *this = (BinaryPattern *) pat;
+  Literals second;
+
+  this->p1->literals(this->p1, info);
+  this->p2->literals(this->p2, &second);
+  concatLiterals(info, &second);
+}
+
+/**
+  Overridden optimize() method for concatenation.  The chain of
+  concatenations is taken apart, each run of literals is fused into one
+  StringPattern, and the chain is joined back up.
+  @param *pat pointer to the concatenation.
+  @return the pattern to use in place of pat.
+*/
+static Pattern *optimizeConcatenationPattern(Pattern *pat)
+{
+  BinaryPattern *this = (BinaryPattern *) pat;
+
+  this->p1 = this->p1->optimize(this->p1);
+  this->p2 = this->p2->optimize(this->p2);
+  Pattern *items[chainLength(pat, compileConcatenationPattern)];
+  int count = takeChain(pat, compileConcatenationPattern, items, 0);
+
+  int kept = 0;
+  char const *sym;
+  int len;
+  for (int i = 0; i < count; ){
+    int runEnd = i;
+    int runLen = 0;
+    while (runEnd < count && symbolsOf(items[runEnd], &sym, &len)){
+      runLen += len;
+      runEnd++;
+    }
+    if (runEnd - i < 2){
+      items[kept++] = items[i++];
+      continue;
+    }
+    char run[runLen];
+    runLen = 0;
+    for (; i < runEnd; i++){
+      symbolsOf(items[i], &sym, &len);
+      memcpy(run + runLen, sym, len);
+      runLen += len;
+      items[i]->destroy(items[i]);
+    }
+    items[kept++] = makeStringPattern(run, runLen);
+  }
+  return joinConcatenation(items, kept);
 }
 
 /**
@@ -512,6 +1260,10 @@ Pattern *makeConcatenationPattern(Pattern *p1, Pattern *p2)
   this->p2 = p2;
 
   this->match = matchConcatenationPattern;
+  this->compile = compileConcatenationPattern;
+  this->literals = literalsConcatenationPattern;
+  this->optimize = optimizeConcatenationPattern;
+  this->nodes = nodesBinaryPattern;
   this->destroy = destroyBinaryPattern;
 
   return (Pattern *) this;
@@ -524,33 +1276,233 @@ Pattern *makeConcatenationPattern(Pattern *p1, Pattern *p2)
   @param *const str Pointer to the string to match.
   @param len length of the string.
   @param (*table) pointer to the 2D array representing subsequence of string.
+  @param *arena arena for scratch tables.
   @return A dynamically allocated representation for this new pattern.
 */
 static void matchAlternationPattern(Pattern *pat, char const *str, int len,
-                                       bool (*table)[len + 1])
+                                       MatchTable *table, Arena *arena)
 {
   // Cast down to the struct type pat really points to.
   BinaryPattern *this = (BinaryPattern *) pat;
 
   // Two more tables for matching sub-expressions.
-  bool (*tbl1)[len + 1]  = calloc((len + 1) * (len + 1), sizeof(bool));
-  bool (*tbl2)[len + 1]  = calloc((len + 1) * (len + 1), sizeof(bool));
+  ArenaMark mark = markArena(arena);
+  MatchTable *tbl1 = makeTable(len, arena);
+  MatchTable *tbl2 = makeTable(len, arena);
 
   //  Let our two sub-patterns figure out everywhere they match.
-  this->p1->match(this->p1, str, len, tbl1);
-  this->p2->match(this->p2, str, len, tbl2);
+  this->p1->match(this->p1, str, len, tbl1, arena);
+  this->p2->match(this->p2, str, len, tbl2, arena);
+
+  // Then, based on their matches, the alternation matches wherever
+  // either of them does, so OR the whole tables together.
+  int size = (len + 1) * table->words;
+  orRow(table->bits, tbl1->bits, size);
+  orRow(table->bits, tbl2->bits, size);
+  releaseArena(arena, mark);
+}
 
-  // Then, based on their matches, look for all places where their
-  // concatenaton matches.  Check all substrings of the input string.
-  for (int begin = 0; begin <= len; begin++){
-    for (int end = begin; end <= len; end++){
-      if (tbl1[begin][end] || tbl2[begin][end]){
-          table[begin][end] = true;
+// Overridden compile() method for alternation, split L1 L2, L1: p1, jmp L3,
+// L2: p2, L3:
+static void compileAlternationPattern(Pattern *pat, Program *prog)
+{
+  BinaryPattern *this = (BinaryPattern *) pat;
+
+  int split = emitInstruction(prog, OP_SPLIT);
+  this->p1->compile(this->p1, prog);
+  int jmp = emitInstruction(prog, OP_JMP);
+  this->p2->compile(this->p2, prog);
+  prog->code[split].x = split + 1;
+  prog->code[split].y = jmp + 1;
+  prog->code[jmp].x = prog->count;
+}
+
+// Overridden literals() method for alternation, either p1 or p2.
+static void literalsAlternationPattern(Pattern *pat, Literals *info)
+{
+  BinaryPattern *this = (BinaryPattern *) pat;
+  Literals second;
+
+  this->p1->literals(this->p1, info);
+  this->p2->literals(this->p2, &second);
+  alternateLiterals(info, &second);
+}
+
+/**
+  Remove symbols from the start of a pattern that begins with a
+  LiteralPattern or StringPattern.
+
+  @param *pat pointer to the pattern, used up.
+  @param n number of symbols to remove, no more than its first pattern
+           matches.
+  @return the rest of the pattern, or NULL if nothing is left.
+*/
+static Pattern *removePrefix(Pattern *pat, int n)
+{
+  Pattern *items[chainLength(pat, compileConcatenationPattern)];
+  int count = takeChain(pat, compileConcatenationPattern, items, 0);
+  char const *sym;
+  int len;
+  symbolsOf(items[0], &sym, &len);
+  Pattern *rest = len > n ? makeSymbolsPattern(sym + n, len - n) : NULL;
+  items[0]->destroy(items[0]);
+  if (rest){
+    items[0] = rest;
+    return joinConcatenation(items, count);
+  }
+  return count > 1 ? joinConcatenation(items + 1, count - 1) : NULL;
+}
+
+/**
+  Get the symbols a pattern starts with, if its first pattern is a
+  LiteralPattern or StringPattern.
+
+  @param *pat pointer to the pattern.
+  @param **str set to the symbols.
+  @param *len set to the number of symbols.
+  @return false if the pattern doesn't start with symbols.
+*/
+static bool leadingSymbols(Pattern *pat, char const **str, int *len)
+{
+  while (pat->compile == compileConcatenationPattern){
+    pat = ((BinaryPattern *) pat)->p1;
+  }
+  return symbolsOf(pat, str, len);
+}
+
+/**
+  Get the bytes matched by a pattern that matches a single byte, a
+  LiteralPattern, DotPattern or CharacterClassPattern.
+
+  @param *pat pointer to the pattern.
+  @return the bytes it matches, or NULL if it's some other type.
+*/
+static ByteSet const *byteSetOf(Pattern *pat)
+{
+  if (pat->compile == compileLiteralPattern){
+    return &((LiteralPattern *) pat)->set;
+  }
+  if (pat->compile == compileDotPattern){
+    return &((DotPattern *) pat)->set;
+  }
+  if (pat->compile == compileCharacterClassPattern){
+    return &((CharacterClassPattern *) pat)->set;
+  }
+  return NULL;
+}
+
+/**
+  Build an optimized alternation of a list of optimized patterns.  Every
+  engine takes the union of an alternation's matches, so the order of
+  the alternatives doesn't matter.  Alternatives that start with the
+  same symbols are grouped, so abc|abd becomes ab(c|d), and the ones
+  that match a single byte are merged into one character class, so
+  ab(c|d) becomes ab[cd].
+
+  @param **alts list of alternatives, used up.
+  @param count number of alternatives, at least 1.
+  @return the alternation of the patterns.
+*/
+static Pattern *optimizeAlternatives(Pattern **alts, int count)
+{
+  int kept = 0;
+  for (int i = 0; i < count; i++){
+    char const *sym, *other;
+    int len, otherLen;
+    if (!alts[i]){
+      continue;
+    }
+    if (!leadingSymbols(alts[i], &sym, &len)){
+      alts[kept++] = alts[i];
+      continue;
+    }
+    // Find the others starting with the same symbol, and how many
+    // symbols all of them start with.
+    int members = 1;
+    int prefix = len;
+    for (int j = i + 1; j < count; j++){
+      if (alts[j] && leadingSymbols(alts[j], &other, &otherLen) && other[0] == sym[0]){
+        members++;
+        int common = 1;
+        while (common < prefix && common < otherLen && other[common] == sym[common]){
+          common++;
+        }
+        prefix = common;
+      }
+    }
+    if (members == 1){
+      alts[kept++] = alts[i];
+      continue;
+    }
+    char shared[prefix];
+    memcpy(shared, sym, prefix);
+    Pattern *rest[members];
+    int restCount = 0;
+    bool empty = false;
+    for (int j = i; j < count; j++){
+      if (alts[j] && leadingSymbols(alts[j], &other, &otherLen) && other[0] == shared[0]){
+        Pattern *r = removePrefix(alts[j], prefix);
+        alts[j] = NULL;
+        if (r){
+          rest[restCount++] = r;
+        } else {
+          empty = true;
         }
+      }
+    }
+    Pattern *factored = makeSymbolsPattern(shared, prefix);
+    if (restCount > 0){
+      Pattern *r = optimizeAlternatives(rest, restCount);
+      if (empty){
+        // One of them ended with the shared symbols, so the rest is optional.
+        r = collapseRepetition((RepetitionPattern *) makeRepetitionPattern(r, QUESTION));
+      }
+      factored = makeConcatenationPattern(factored, r);
     }
+    alts[kept++] = factored;
   }
-  free( tbl1 );
-  free( tbl2 );
+  count = kept;
+
+  kept = 0;
+  int first = -1;
+  ByteSet merged;
+  for (int i = 0; i < count; i++){
+    ByteSet const *set = byteSetOf(alts[i]);
+    if (!set){
+      alts[kept++] = alts[i];
+    } else if (first < 0){
+      first = kept;
+      merged = *set;
+      alts[kept++] = alts[i];
+    } else {
+      for (int c = 0; c <= UCHAR_MAX; c++){
+        if (inByteSet(set, c)){
+          addByte(&merged, c);
+        }
+      }
+      alts[i]->destroy(alts[i]);
+      alts[first]->destroy(alts[first]);
+      alts[first] = makeByteSetPattern(&merged);
+    }
+  }
+
+  Pattern *pat = alts[0];
+  for (int i = 1; i < kept; i++){
+    pat = makeAlternationPattern(pat, alts[i]);
+  }
+  return pat;
+}
+
+// Overridden optimize() method for alternation.
+static Pattern *optimizeAlternationPattern(Pattern *pat)
+{
+  BinaryPattern *this = (BinaryPattern *) pat;
+
+  this->p1 = this->p1->optimize(this->p1);
+  this->p2 = this->p2->optimize(this->p2);
+  Pattern *alts[chainLength(pat, compileAlternationPattern)];
+  int count = takeChain(pat, compileAlternationPattern, alts, 0);
+  return optimizeAlternatives(alts, count);
 }
 
 /**
@@ -569,6 +1521,10 @@ Pattern *makeAlternationPattern(Pattern *p1, Pattern *p2)
   this->p2 = p2;
 
   this->match = matchAlternationPattern;
+  this->compile = compileAlternationPattern;
+  this->literals = literalsAlternationPattern;
+  this->optimize = optimizeAlternationPattern;
+  this->nodes = nodesBinaryPattern;
   this->destroy = destroyBinaryPattern;
 
   return (Pattern *) this;
@@ -9,6 +9,7 @@
 #define PATTERN_H
 
 #include <stdbool.h>
+#include "table.h"
 
 //////////////////////////////////////////////////////////////////////
 // Superclass for Patterns
@@ -16,27 +17,73 @@
 /** A short name to use for the Pattern interface. */
 typedef struct PatternStruct Pattern;
 
+/** Compiled program for a pattern, defined in program.h. */
+struct ProgramStruct;
+
+/** Literal strings known to be in a pattern's matches, defined in prefilter.h. */
+struct LiteralsStruct;
+
 /**
   Structure used as a superclass/interface for a regular expression
   pattern.  There's a function pointer for an overridable method,
   match(), that reports all the places where this pattern matches a
-  given string.  There's also an overridable method for freeing
+  given string, one, compile(), that lowers it into an NFA program, one,
+  literals(), that reports the literal text its matches must contain,
+  and two, optimize() and nodes(), that simplify the tree and measure
+  it.  There's also an overridable method for freeing
   resources for the pattern.
 */
 struct PatternStruct {
   /** Method for matching this pattern against a given string.  For
       each substring str[ begin ] .. str[ end - 1 ] that matches this
-      pattern, this function sets table[ begin ][ end ] to true.
+      pattern, this function sets bit end of row begin in the table.
 
       @param pat pointer to the pattern being matched (essentially, a this
                  pointer).
       @param str input string in which we're finding matches.
       @param len length of str.
-      @param table ( len + 1 ) x ( len + 1 ) array of booleans that
-                   gets filled in with the substrings where this
+      @param table ( len + 1 ) x ( len + 1 ) table of bits (see table.h)
+                   that gets filled in with the substrings where this
                    pattern matches the string.
+      @param arena arena for any scratch tables, the pattern gives back
+                   everything it allocates after table.
+  */
+  void (*match)( Pattern *pat, char const *str, int len, MatchTable *table,
+                 Arena *arena );
+
+  /** Method for compiling this pattern into the instructions of an
+      NFA program (see program.h).  The instructions emitted for the
+      pattern start at the current end of the program, and execution
+      continues after the last of them once the pattern has matched.
+
+      @param pat pointer to the pattern being compiled.
+      @param prog program the instructions are appended to.
+  */
+  void (*compile)( Pattern *pat, struct ProgramStruct *prog );
+
+  /** Method for working out literal strings that every match of this
+      pattern starts with, ends with or contains (see prefilter.h).
+
+      @param pat pointer to the pattern being analyzed.
+      @param info literals to fill in, the caller frees them.
+  */
+  void (*literals)( Pattern *pat, struct LiteralsStruct *info );
+
+  /** Method for simplifying this pattern into one that matches the same
+      strings with fewer nodes, optimizing its sub-patterns first.  The
+      pattern is used up, it may be freed or become part of the result.
+
+      @param pat pointer to the pattern being optimized.
+      @return the pattern to use in place of pat.
+  */
+  Pattern *(*optimize)( Pattern *pat );
+
+  /** Method for counting the nodes in this pattern's tree.
+
+      @param pat pointer to the pattern being counted.
+      @return the number of nodes, counting pat and all its sub-patterns.
   */
-  void (*match)( Pattern *pat, char const *str, int len, bool (*table)[ len + 1 ] );
+  int (*nodes)( Pattern *pat );
 
   /** Free memory for this pattern, including any subpatterns it contains.
       @param pat pattern to free.
@@ -0,0 +1,491 @@
+/**
+  Pike VM engine for compiled programs.  A thread is an instruction and
+  its capture slots.  Each step runs every thread on the current list
+  over one byte, putting the survivors on the next list, so there is
+  no backtracking and no recursion.  Threads are kept in order of their
+  start position, and only the first thread to reach an instruction in
+  a step is kept.  The same instruction means the same future, so the
+  thread that started earliest always wins, and the longest match from
+  the leftmost start is found in one pass.
+
+  Searching again after each match would rescan the rest of the line
+  every time, so finding every match on a line first works backward
+  over it, marking the instructions a match can still be reached from
+  at each position.  Matches can then start only where the first
+  instruction is marked, and threads that can't reach a match are
+  dropped, so each match is run over just once.
+
+  @file pike.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#include "pike.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Number of bits in a word of an instruction set.
+#define WORD_BITS 64
+
+/** A list of threads for one position in the input. */
+typedef struct {
+  /** Instruction of each thread. */
+  int *pc;
+  /** PIKE_SLOTS capture slots for each thread. */
+  int *slots;
+  /** Number of threads. */
+  int count;
+} ThreadList;
+
+/** Representation of the VM. */
+struct PikeStruct {
+  /** Program being run. */
+  Program *prog;
+  /** True if every match starts at the start of the line. */
+  bool anchored;
+  /** Threads for the current and the next position. */
+  ThreadList lists[ 2 ];
+  /** Step each instruction was last added in, so it's added only once. */
+  int *seen;
+  /** Current step. */
+  int step;
+  /** Instructions waiting to be followed while adding a thread. */
+  int *stack;
+  /** Number of words in an instruction set. */
+  int words;
+  /**
+    Instructions that reach each instruction without consuming a byte,
+    those of pc are preds[ predStart[ pc ] ] .. preds[ predStart[ pc + 1 ] - 1 ].
+  */
+  int *predStart, *preds;
+};
+
+/**
+  Check if an instruction is in a set.
+
+  @param set set to look in.
+  @param pc instruction to look for.
+  @return true if pc is in set.
+*/
+static bool testBit(uint64_t const *set, int pc)
+{
+  return set[pc / WORD_BITS] >> (pc % WORD_BITS) & 1;
+}
+
+/**
+  Add an instruction to a set.
+
+  @param set set to add to.
+  @param pc instruction to add.
+*/
+static void setBit(uint64_t *set, int pc)
+{
+  set[pc / WORD_BITS] |= (uint64_t) 1 << (pc % WORD_BITS);
+}
+
+/**
+  Make a thread list for the given program.
+
+  @param list list to fill in.
+  @param count number of instructions in the program.
+*/
+static void initList(ThreadList *list, int count)
+{
+  list->pc = (int *) malloc(count * sizeof(int));
+  list->slots = (int *) malloc(count * PIKE_SLOTS * sizeof(int));
+  list->count = 0;
+}
+
+/**
+  Make a Pike VM for the given program, with thread lists big enough
+  that running it never allocates memory.
+
+  @param prog program to run, it must outlive the VM.
+  @return A dynamically allocated VM for the program.
+*/
+Pike *makePike(Program *prog)
+{
+  Pike *vm = (Pike *) malloc(sizeof(Pike));
+  vm->prog = prog;
+  vm->anchored = anchoredAtStart(prog);
+  initList(vm->lists, prog->count);
+  initList(vm->lists + 1, prog->count);
+  vm->seen = (int *) calloc(prog->count, sizeof(int));
+  vm->step = 0;
+  vm->stack = (int *) malloc(prog->count * sizeof(int));
+  vm->words = (prog->count + WORD_BITS - 1) / WORD_BITS;
+
+  // Count the jumps into each instruction, then list where they're from.
+  Instruction const *code = prog->code;
+  vm->predStart = (int *) calloc(prog->count + 1, sizeof(int));
+  vm->preds = (int *) malloc(2 * prog->count * sizeof(int));
+  for (int pc = 0; pc < prog->count; pc++){
+    switch (code[pc].op){
+    case OP_SPLIT:
+      vm->predStart[code[pc].y + 1]++;
+      // fall through
+    case OP_JMP:
+      vm->predStart[code[pc].x + 1]++;
+      break;
+    case OP_BOL:
+    case OP_EOL:
+      vm->predStart[pc + 2]++;
+      break;
+    default:
+      break;
+    }
+  }
+  for (int pc = 0; pc < prog->count; pc++){
+    vm->predStart[pc + 1] += vm->predStart[pc];
+  }
+  int *fill = vm->stack;
+  memcpy(fill, vm->predStart, prog->count * sizeof(int));
+  for (int pc = 0; pc < prog->count; pc++){
+    switch (code[pc].op){
+    case OP_SPLIT:
+      vm->preds[fill[code[pc].y]++] = pc;
+      // fall through
+    case OP_JMP:
+      vm->preds[fill[code[pc].x]++] = pc;
+      break;
+    case OP_BOL:
+    case OP_EOL:
+      vm->preds[fill[pc + 1]++] = pc;
+      break;
+    default:
+      break;
+    }
+  }
+  return vm;
+}
+
+/**
+  Start a new step, so every instruction can be added again.
+
+  @param vm VM being run.
+*/
+static void nextStep(Pike *vm)
+{
+  if (++vm->step == 0){
+    // The counter wrapped around, forget the old steps for real.
+    memset(vm->seen, 0, vm->prog->count * sizeof(int));
+    vm->step = 1;
+  }
+}
+
+/**
+  Add a thread at pc to the list, following jumps, splits and
+  assertions to the consuming instructions and OP_MATCH they reach.
+
+  @param vm VM being run.
+  @param list list to add to.
+  @param pc instruction of the new thread.
+  @param slots capture slots of the new thread.
+  @param pos position in the input the thread is at.
+  @param len length of the input.
+*/
+static void addThread(Pike *vm, ThreadList *list, int pc, int const *slots,
+                      int pos, int len)
+{
+  Instruction const *code = vm->prog->code;
+  int top = 0;
+  if (vm->seen[pc] != vm->step){
+    vm->seen[pc] = vm->step;
+    vm->stack[top++] = pc;
+  }
+  while (top > 0){
+    pc = vm->stack[--top];
+    int next[ 2 ];
+    int n = 0;
+    switch (code[pc].op){
+    case OP_SPLIT:
+      next[n++] = code[pc].y;
+      next[n++] = code[pc].x;
+      break;
+    case OP_JMP:
+      next[n++] = code[pc].x;
+      break;
+    case OP_BOL:
+      if (pos == 0){
+        next[n++] = pc + 1;
+      }
+      break;
+    case OP_EOL:
+      if (pos == len){
+        next[n++] = pc + 1;
+      }
+      break;
+    default:
+      list->pc[list->count] = pc;
+      memcpy(list->slots + list->count * PIKE_SLOTS, slots, PIKE_SLOTS * sizeof(int));
+      list->count++;
+      break;
+    }
+    for (int i = 0; i < n; i++){
+      if (vm->seen[next[i]] != vm->step){
+        vm->seen[next[i]] = vm->step;
+        vm->stack[top++] = next[i];
+      }
+    }
+  }
+}
+
+/**
+  Run the VM from the given position, finding the leftmost-longest
+  match or, if first is true, stopping at the first match reached.
+
+  @param vm VM to run.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @param from first position a match may start at.
+  @param slots capture slots of the match, filled in if there's a match.
+  @param first true if any match will do.
+  @return true if there's a match.
+*/
+static bool runPike(Pike *vm, char const *str, int len, int from,
+                    int slots[ PIKE_SLOTS ], bool first)
+{
+  Instruction const *code = vm->prog->code;
+  ThreadList *clist = vm->lists;
+  ThreadList *nlist = vm->lists + 1;
+  bool found = false;
+
+  clist->count = 0;
+  nextStep(vm);
+  for (int pos = from; pos <= len; pos++){
+    // Until there's a match, a new thread starts at every position.  It
+    // goes last, since every thread already running started earlier.
+    // Anchored at the start, only the one at 0 can get anywhere.
+    if (!found && (pos == 0 || !vm->anchored)){
+      int start[ PIKE_SLOTS ] = { pos, -1 };
+      addThread(vm, clist, 0, start, pos, len);
+    }
+    if ((found || vm->anchored) && clist->count == 0){
+      break;
+    }
+
+    nlist->count = 0;
+    nextStep(vm);
+    for (int i = 0; i < clist->count; i++){
+      int *ts = clist->slots + i * PIKE_SLOTS;
+      if (found && ts[ 0 ] > slots[ 0 ]){
+        // This thread and the rest of the list started too late.
+        break;
+      }
+      Instruction const *inst = code + clist->pc[i];
+      switch (inst->op){
+      case OP_MATCH:
+        if (!found || ts[ 0 ] < slots[ 0 ] || pos > slots[ 1 ]){
+          slots[ 0 ] = ts[ 0 ];
+          slots[ 1 ] = pos;
+          found = true;
+        }
+        if (first){
+          return true;
+        }
+        break;
+      case OP_CHAR:
+        if (pos < len && (unsigned char) str[pos] == inst->c){
+          addThread(vm, nlist, clist->pc[i] + 1, ts, pos + 1, len);
+        }
+        break;
+      default:
+        if (pos < len && instructionAccepts(inst, str[pos])){
+          addThread(vm, nlist, clist->pc[i] + 1, ts, pos + 1, len);
+        }
+        break;
+      }
+    }
+
+    ThreadList *tmp = clist;
+    clist = nlist;
+    nlist = tmp;
+  }
+  return found;
+}
+
+/**
+  Find the leftmost-longest match of the program in str that starts at
+  or after from.  This runs in time linear in len - from.
+
+  @param vm VM to run.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @param from first position a match may start at.
+  @param slots capture slots of the match, slots[ 0 ] .. slots[ 1 ] - 1
+               is the matching substring, filled in if there's a match.
+  @return true if there's a match.
+*/
+bool findPikeMatch(Pike *vm, char const *str, int len, int from,
+                   int slots[ PIKE_SLOTS ])
+{
+  return runPike(vm, str, len, from, slots, false);
+}
+
+/**
+  Check if the program matches anywhere in the given string, including
+  empty matches, stopping at the first match reached.
+
+  @param vm VM to run.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @return true if there's a match.
+*/
+bool matchPike(Pike *vm, char const *str, int len)
+{
+  int slots[ PIKE_SLOTS ];
+  return runPike(vm, str, len, 0, slots, true);
+}
+
+/**
+  Work backward over the string, finding the instructions a match can
+  be reached from at each position.
+
+  @param vm VM whose program is matched.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @param live array of len + 1 sets, the one at pos is filled in with the
+              instructions a match can be reached from at pos.
+*/
+static void findLive(Pike *vm, char const *str, int len, uint64_t *live)
+{
+  Instruction const *code = vm->prog->code;
+  int count = vm->prog->count;
+  int words = vm->words;
+  for (int pos = len; pos >= 0; pos--){
+    uint64_t *set = live + (size_t) pos * words;
+    uint64_t const *after = set + words;
+    memset(set, 0, words * sizeof(uint64_t));
+    int top = 0;
+    setBit(set, count - 1);
+    vm->stack[top++] = count - 1;
+    for (int pc = 0; pos < len && pc < count - 1; pc++){
+      if (instructionConsumes(code + pc) && instructionAccepts(code + pc, str[pos])
+          && testBit(after, pc + 1)){
+        setBit(set, pc);
+        vm->stack[top++] = pc;
+      }
+    }
+    // Anything that gets to a live instruction without a byte is live.
+    while (top > 0){
+      int pc = vm->stack[--top];
+      for (int i = vm->predStart[pc]; i < vm->predStart[pc + 1]; i++){
+        int pred = vm->preds[i];
+        if (testBit(set, pred) || (code[pred].op == OP_BOL && pos != 0)
+            || (code[pred].op == OP_EOL && pos != len)){
+          continue;
+        }
+        setBit(set, pred);
+        vm->stack[top++] = pred;
+      }
+    }
+  }
+}
+
+/**
+  Find where the longest match starting at the given position ends,
+  running only threads that can still reach a match.
+
+  @param vm VM to run.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @param start position the match starts at, a match must start there.
+  @param live sets filled in by findLive().
+  @return the end of the longest match.
+*/
+static int findLongest(Pike *vm, char const *str, int len, int start,
+                       uint64_t const *live)
+{
+  Instruction const *code = vm->prog->code;
+  ThreadList *clist = vm->lists;
+  ThreadList *nlist = vm->lists + 1;
+  int slots[ PIKE_SLOTS ] = { start, -1 };
+  int end = start;
+
+  clist->count = 0;
+  nextStep(vm);
+  addThread(vm, clist, 0, slots, start, len);
+  for (int pos = start; clist->count > 0; pos++){
+    uint64_t const *after = live + (size_t) (pos + 1) * vm->words;
+    nlist->count = 0;
+    nextStep(vm);
+    for (int i = 0; i < clist->count; i++){
+      int pc = clist->pc[i];
+      if (code[pc].op == OP_MATCH){
+        end = pos;
+      } else if (pos < len && instructionAccepts(code + pc, str[pos])
+                 && testBit(after, pc + 1)){
+        addThread(vm, nlist, pc + 1, slots, pos + 1, len);
+      }
+    }
+
+    ThreadList *tmp = clist;
+    clist = nlist;
+    nlist = tmp;
+  }
+  return end;
+}
+
+/**
+  Find every leftmost-longest match of the program in the given string,
+  starting again after the end of each match.  This runs in time linear
+  in len.
+
+  @param vm VM to run.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @param spans array of len spans, filled in with the non-empty matches.
+  @param count set to the number of spans.
+  @param arena arena the scratch sets are allocated from, everything
+               allocated is given back before returning.
+  @return true if the program matches anywhere, including empty matches.
+*/
+bool findPikeSpans(Pike *vm, char const *str, int len, Span *spans, int *count,
+                   Arena *arena)
+{
+  ArenaMark mark = markArena(arena);
+  uint64_t *live = (uint64_t *) arenaAlloc(arena, (size_t) (len + 1) * vm->words
+                                                  * sizeof(uint64_t));
+  findLive(vm, str, len, live);
+
+  bool found = false;
+  *count = 0;
+  int from = 0;
+  while (from <= len){
+    // The leftmost match starts at the first position 0 is live at.
+    while (from <= len && !testBit(live + (size_t) from * vm->words, 0)){
+      from++;
+    }
+    if (from > len){
+      break;
+    }
+    found = true;
+    int end = findLongest(vm, str, len, from, live);
+    if (end > from){
+      spans[*count].start = from;
+      spans[(*count)++].end = end;
+    }
+    // An empty match can't be highlighted, so look past it.
+    from = end > from ? end : from + 1;
+  }
+  releaseArena(arena, mark);
+  return found;
+}
+
+/**
+  Free the memory for the given VM, but not its program.
+
+  @param vm VM to free.
+*/
+void freePike(Pike *vm)
+{
+  for (int i = 0; i < 2; i++){
+    free(vm->lists[i].pc);
+    free(vm->lists[i].slots);
+  }
+  free(vm->seen);
+  free(vm->stack);
+  free(vm->predStart);
+  free(vm->preds);
+  free(vm);
+}
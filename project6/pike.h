@@ -0,0 +1,84 @@
+/**
+  This is the header file for the pike component, a matching engine
+  that runs a compiled Program as a Pike VM, stepping every NFA thread
+  in lock step over the input.  Unlike the DFA engine, it reports where
+  matches are, finding leftmost-longest matches one after another.
+
+  @file pike.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef PIKE_H
+#define PIKE_H
+
+#include <stdbool.h>
+#include "program.h"
+#include "span.h"
+#include "arena.h"
+
+/** Capture slots for each thread, the start and end of the match. */
+#define PIKE_SLOTS 2
+
+/** A short name to use for the Pike VM. */
+typedef struct PikeStruct Pike;
+
+/**
+  Make a Pike VM for the given program, with thread lists big enough
+  that running it never allocates memory.
+
+  @param prog program to run, it must outlive the VM.
+  @return A dynamically allocated VM for the program.
+*/
+Pike *makePike(Program *prog);
+
+/**
+  Find the leftmost-longest match of the program in str that starts at
+  or after from.  This runs in time linear in len - from.
+
+  @param vm VM to run.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @param from first position a match may start at.
+  @param slots capture slots of the match, slots[ 0 ] .. slots[ 1 ] - 1
+               is the matching substring, filled in if there's a match.
+  @return true if there's a match.
+*/
+bool findPikeMatch(Pike *vm, char const *str, int len, int from,
+                   int slots[ PIKE_SLOTS ]);
+
+/**
+  Check if the program matches anywhere in the given string, including
+  empty matches, stopping at the first match reached.
+
+  @param vm VM to run.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @return true if there's a match.
+*/
+bool matchPike(Pike *vm, char const *str, int len);
+
+/**
+  Find every leftmost-longest match of the program in the given string,
+  starting again after the end of each match.  This runs in time linear
+  in len.
+
+  @param vm VM to run.
+  @param str input string in which we're finding matches.
+  @param len length of str.
+  @param spans array of len spans, filled in with the non-empty matches.
+  @param count set to the number of spans.
+  @param arena arena the scratch sets are allocated from, everything
+               allocated is given back before returning.
+  @return true if the program matches anywhere, including empty matches.
+*/
+bool findPikeSpans(Pike *vm, char const *str, int len, Span *spans, int *count,
+                   Arena *arena);
+
+/**
+  Free the memory for the given VM, but not its program.
+
+  @param vm VM to free.
+*/
+void freePike(Pike *vm);
+
+#endif
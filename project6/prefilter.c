@@ -0,0 +1,329 @@
+/**
+  Implementation of the prefilter component.  Patterns report the
+  literal facts about what they match through their literals() method,
+  and the longest string every match must contain is searched for with
+  an SSE2 first/last byte filter (or memchr() where SSE2 isn't
+  available) before a line is given to the matching engine.
+
+  @file prefilter.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#include "prefilter.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Longest literal string that's tracked, longer ones are cut down.
+#define MAX_LITERAL 256
+
+// Number of bytes compared at once by the SSE2 search.
+#define VECTOR_SIZE 16
+
+/** Representation of the prefilter. */
+struct PrefilterStruct {
+  /** Literal every match contains. */
+  char *literal;
+  /** Length of literal. */
+  int len;
+};
+
+// Make a dynamically allocated copy of len bytes of str.
+static char *copyString(char const *str, int len)
+{
+  char *copy = (char *) malloc(len + 1);
+  memcpy(copy, str, len);
+  copy[len] = '\0';
+  return copy;
+}
+
+// Make a dynamically allocated concatenation of two strings, cut down to
+// at most MAX_LITERAL characters, keeping its start or its end.
+static char *joinStrings(char const *a, char const *b, bool keepEnd)
+{
+  int alen = strlen(a);
+  int blen = strlen(b);
+  char *join = (char *) malloc(alen + blen + 1);
+  memcpy(join, a, alen);
+  memcpy(join + alen, b, blen + 1);
+  if (alen + blen > MAX_LITERAL){
+    if (keepEnd){
+      memmove(join, join + alen + blen - MAX_LITERAL, MAX_LITERAL + 1);
+    }
+    join[MAX_LITERAL] = '\0';
+  }
+  return join;
+}
+
+// Replace *dest with candidate if candidate is longer, freeing the loser.
+static void keepLonger(char **dest, char *candidate)
+{
+  if (strlen(candidate) > strlen(*dest)){
+    free(*dest);
+    *dest = candidate;
+  } else {
+    free(candidate);
+  }
+}
+
+/**
+  Fill in literals for a pattern that matches exactly the given string.
+
+  @param info literals to fill in.
+  @param str the string matched.
+  @param len length of str.
+*/
+void exactLiterals(Literals *info, char const *str, int len)
+{
+  if (len > MAX_LITERAL){
+    // Too long to track exactly, just keep its ends.
+    info->exact = NULL;
+    info->prefix = copyString(str, MAX_LITERAL);
+    info->suffix = copyString(str + len - MAX_LITERAL, MAX_LITERAL);
+    info->required = copyString(str, MAX_LITERAL);
+    return;
+  }
+  info->exact = copyString(str, len);
+  info->prefix = copyString(str, len);
+  info->suffix = copyString(str, len);
+  info->required = copyString(str, len);
+}
+
+/**
+  Fill in literals for a pattern nothing is known about.
+
+  @param info literals to fill in.
+*/
+void unknownLiterals(Literals *info)
+{
+  info->exact = NULL;
+  info->prefix = copyString("", 0);
+  info->suffix = copyString("", 0);
+  info->required = copyString("", 0);
+}
+
+/**
+  Replace a with the literals for a pattern matching a followed by b.
+
+  @param a literals for the first part, replaced by the result.
+  @param b literals for the second part.
+*/
+void concatLiterals(Literals *a, Literals *b)
+{
+  if (a->exact && b->exact && strlen(a->exact) + strlen(b->exact) <= MAX_LITERAL){
+    char *exact = joinStrings(a->exact, b->exact, false);
+    freeLiterals(a);
+    freeLiterals(b);
+    exactLiterals(a, exact, strlen(exact));
+    free(exact);
+    return;
+  }
+
+  // The text where a's matches end and b's begin is required too.
+  char *middle = joinStrings(a->suffix, b->prefix, false);
+  char *prefix = a->exact ? joinStrings(a->exact, b->prefix, false)
+                          : copyString(a->prefix, strlen(a->prefix));
+  char *suffix = b->exact ? joinStrings(a->suffix, b->exact, true)
+                          : copyString(b->suffix, strlen(b->suffix));
+  char *required = copyString(a->required, strlen(a->required));
+  keepLonger(&required, copyString(b->required, strlen(b->required)));
+  keepLonger(&required, middle);
+  keepLonger(&required, copyString(prefix, strlen(prefix)));
+  keepLonger(&required, copyString(suffix, strlen(suffix)));
+
+  freeLiterals(a);
+  freeLiterals(b);
+  a->exact = NULL;
+  a->prefix = prefix;
+  a->suffix = suffix;
+  a->required = required;
+}
+
+/**
+  Replace a with the literals for a pattern matching either a or b.
+
+  @param a literals for the first alternative, replaced by the result.
+  @param b literals for the second alternative.
+*/
+void alternateLiterals(Literals *a, Literals *b)
+{
+  if (a->exact && b->exact && strcmp(a->exact, b->exact) == 0){
+    freeLiterals(b);
+    return;
+  }
+
+  // Only what both alternatives start or end with is still known.
+  int plen = 0;
+  while (a->prefix[plen] && a->prefix[plen] == b->prefix[plen]){
+    plen++;
+  }
+  int alen = strlen(a->suffix);
+  int blen = strlen(b->suffix);
+  int slen = 0;
+  while (slen < alen && slen < blen &&
+         a->suffix[alen - slen - 1] == b->suffix[blen - slen - 1]){
+    slen++;
+  }
+  char *prefix = copyString(a->prefix, plen);
+  char *suffix = copyString(a->suffix + alen - slen, slen);
+  char *required = copyString(prefix, plen);
+  keepLonger(&required, copyString(suffix, slen));
+
+  freeLiterals(a);
+  freeLiterals(b);
+  a->exact = NULL;
+  a->prefix = prefix;
+  a->suffix = suffix;
+  a->required = required;
+}
+
+/**
+  Replace info with the literals for a pattern matching one or more
+  repetitions of info.
+
+  @param info literals for a single repetition, replaced by the result.
+*/
+void repeatLiterals(Literals *info)
+{
+  // Prefix, suffix and required text all still hold, but the length of
+  // the match isn't fixed anymore.
+  free(info->exact);
+  info->exact = NULL;
+}
+
+/**
+  Free the strings of the given literals.
+
+  @param info literals to free.
+*/
+void freeLiterals(Literals *info)
+{
+  free(info->exact);
+  free(info->prefix);
+  free(info->suffix);
+  free(info->required);
+}
+
+/**
+  Make a prefilter for the given pattern.
+
+  @param pat pattern to analyze.
+  @return A dynamically allocated prefilter, or NULL if the pattern has
+          no required literal to search for.
+*/
+Prefilter *makePrefilter(Pattern *pat)
+{
+  Literals info;
+  pat->literals(pat, &info);
+  Prefilter *pf = makeLiteralPrefilter(info.required);
+  freeLiterals(&info);
+  return pf;
+}
+
+/**
+  Make a prefilter that searches for the given literal.
+
+  @param literal string every match contains.
+  @return A dynamically allocated prefilter, or NULL if the literal is
+          empty.
+*/
+Prefilter *makeLiteralPrefilter(char const *literal)
+{
+  int len = strlen(literal);
+  if (len == 0){
+    return NULL;
+  }
+  Prefilter *pf = (Prefilter *) malloc(sizeof(Prefilter));
+  pf->literal = copyString(literal, len);
+  pf->len = len;
+  return pf;
+}
+
+/**
+  Get the literal a prefilter searches for.
+
+  @param pf prefilter to look at.
+  @return the literal string.
+*/
+char const *prefilterLiteral(Prefilter const *pf)
+{
+  return pf->literal;
+}
+
+/**
+  Find the first occurrence of needle in hay.
+
+  @param hay string to search.
+  @param len length of hay.
+  @param needle string to look for.
+  @param n length of needle, at least 1.
+  @return pointer to the occurrence in hay, or NULL if there isn't one.
+*/
+static char const *findLiteral(char const *hay, int len, char const *needle, int n)
+{
+  if (n == 1){
+    return memchr(hay, needle[0], len);
+  }
+
+  int pos = 0;
+#ifdef __SSE2__
+  // Compare 16 candidate positions at a time against the needle's first
+  // and last bytes, and only check the rest where both agree.
+  __m128i first = _mm_set1_epi8(needle[0]);
+  __m128i last = _mm_set1_epi8(needle[n - 1]);
+  for (; pos + n - 1 + VECTOR_SIZE <= len; pos += VECTOR_SIZE){
+    __m128i head = _mm_loadu_si128((__m128i const *) (hay + pos));
+    __m128i tail = _mm_loadu_si128((__m128i const *) (hay + pos + n - 1));
+    unsigned mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(head, first),
+                                                    _mm_cmpeq_epi8(tail, last)));
+    while (mask){
+      int candidate = pos + __builtin_ctz(mask);
+      if (memcmp(hay + candidate + 1, needle + 1, n - 2) == 0){
+        return hay + candidate;
+      }
+      mask &= mask - 1;
+    }
+  }
+#endif
+
+  // Check the remaining positions a byte at a time, skipping to
+  // occurrences of the first byte.
+  while (pos + n <= len){
+    char const *hit = memchr(hay + pos, needle[0], len - n + 1 - pos);
+    if (!hit){
+      return NULL;
+    }
+    if (memcmp(hit + 1, needle + 1, n - 1) == 0){
+      return hit;
+    }
+    pos = hit - hay + 1;
+  }
+  return NULL;
+}
+
+/**
+  Check if the given string contains the prefilter's literal.
+
+  @param pf prefilter to check with.
+  @param str input string.
+  @param len length of str.
+  @return true if the literal occurs in str.
+*/
+bool prefilterAccepts(Prefilter const *pf, char const *str, int len)
+{
+  return findLiteral(str, len, pf->literal, pf->len) != NULL;
+}
+
+/**
+  Free the memory for the given prefilter.
+
+  @param pf prefilter to free.
+*/
+void freePrefilter(Prefilter *pf)
+{
+  free(pf->literal);
+  free(pf);
+}
@@ -0,0 +1,129 @@
+/**
+  This is the header file for the prefilter component.  It works out a
+  literal string that every match of a pattern must contain, so lines
+  without it can be skipped with a fast substring search before the
+  matching engine runs.
+
+  @file prefilter.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef PREFILTER_H
+#define PREFILTER_H
+
+#include <stdbool.h>
+#include "pattern.h"
+
+/**
+  Literal facts about the strings a pattern matches.  All the strings
+  are dynamically allocated and NUL-terminated.
+*/
+typedef struct LiteralsStruct {
+  /** The only string the pattern matches, or NULL if there's not just one. */
+  char *exact;
+  /** A string every match starts with. */
+  char *prefix;
+  /** A string every match ends with. */
+  char *suffix;
+  /** A string every match contains. */
+  char *required;
+} Literals;
+
+/** A short name to use for the prefilter. */
+typedef struct PrefilterStruct Prefilter;
+
+/**
+  Fill in literals for a pattern that matches exactly the given string.
+
+  @param info literals to fill in.
+  @param str the string matched.
+  @param len length of str.
+*/
+void exactLiterals(Literals *info, char const *str, int len);
+
+/**
+  Fill in literals for a pattern nothing is known about.
+
+  @param info literals to fill in.
+*/
+void unknownLiterals(Literals *info);
+
+/**
+  Replace a with the literals for a pattern matching a followed by b.
+  The strings of b are freed.
+
+  @param a literals for the first part, replaced by the result.
+  @param b literals for the second part.
+*/
+void concatLiterals(Literals *a, Literals *b);
+
+/**
+  Replace a with the literals for a pattern matching either a or b.
+  The strings of b are freed.
+
+  @param a literals for the first alternative, replaced by the result.
+  @param b literals for the second alternative.
+*/
+void alternateLiterals(Literals *a, Literals *b);
+
+/**
+  Replace info with the literals for a pattern matching one or more
+  repetitions of info.
+
+  @param info literals for a single repetition, replaced by the result.
+*/
+void repeatLiterals(Literals *info);
+
+/**
+  Free the strings of the given literals.
+
+  @param info literals to free.
+*/
+void freeLiterals(Literals *info);
+
+/**
+  Make a prefilter for the given pattern.
+
+  @param pat pattern to analyze.
+  @return A dynamically allocated prefilter, or NULL if the pattern has
+          no required literal to search for.
+*/
+Prefilter *makePrefilter(Pattern *pat);
+
+/**
+  Make a prefilter that searches for the given literal, worked out by
+  makePrefilter() before.
+
+  @param literal string every match contains.
+  @return A dynamically allocated prefilter, or NULL if the literal is
+          empty.
+*/
+Prefilter *makeLiteralPrefilter(char const *literal);
+
+/**
+  Get the literal a prefilter searches for.
+
+  @param pf prefilter to look at.
+  @return the literal string.
+*/
+char const *prefilterLiteral(Prefilter const *pf);
+
+/**
+  Check if the given string contains the prefilter's literal, which it
+  must for the pattern to match anywhere in it.
+
+  @param pf prefilter to check with.
+  @param str input string.
+  @param len length of str.
+  @return true if the literal occurs in str.
+*/
+bool prefilterAccepts(Prefilter const *pf, char const *str, int len);
+
+/**
+  Free the memory for the given prefilter.
+
+  @param pf prefilter to free.
+*/
+void freePrefilter(Prefilter *pf);
+
+#endif
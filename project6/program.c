@@ -0,0 +1,174 @@
+/**
+  Implementation of the program component, the flat NFA representation
+  a Pattern tree compiles into.
+
+  @file program.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#include "program.h"
+#include <stdlib.h>
+#include <string.h>
+
+// initial capacity of the instruction array
+#define INIT_CAP_PROGRAM 16
+
+#define MULTIPLY_FACTOR 2
+
+/**
+  Append a new instruction to the program.
+
+  @param prog program being built.
+  @param op kind of the new instruction.
+  @return index of the new instruction.
+*/
+int emitInstruction(Program *prog, Opcode op)
+{
+  if (prog->count >= prog->capacity){
+    prog->capacity *= MULTIPLY_FACTOR;
+    prog->code = (Instruction *) realloc(prog->code,
+                                         prog->capacity * sizeof(Instruction));
+  }
+  Instruction *inst = prog->code + prog->count;
+  memset(inst, 0, sizeof(Instruction));
+  inst->op = op;
+  return prog->count++;
+}
+
+/**
+  Compile the given pattern into a new program ending in OP_MATCH.
+
+  @param pat pattern to compile.
+  @return A dynamically allocated program for the pattern.
+*/
+Program *compileProgram(Pattern *pat)
+{
+  Program *prog = (Program *) malloc(sizeof(Program));
+  prog->capacity = INIT_CAP_PROGRAM;
+  prog->count = 0;
+  prog->code = (Instruction *) malloc(prog->capacity * sizeof(Instruction));
+
+  pat->compile(pat, prog);
+  emitInstruction(prog, OP_MATCH);
+  return prog;
+}
+
+/**
+  Check if a consuming instruction (OP_CHAR, OP_ANY, OP_CLASS) accepts
+  the given byte.
+
+  @param inst instruction to check.
+  @param ch byte from the input.
+  @return true if inst consumes ch.
+*/
+bool instructionAccepts(Instruction const *inst, unsigned char ch)
+{
+  switch (inst->op){
+    case OP_CHAR:
+      return inst->c == ch;
+    case OP_ANY:
+      return true;
+    case OP_CLASS:
+      return inByteSet(inst->set, ch);
+    default:
+      return false;
+  }
+}
+
+/**
+  Check if an instruction consumes a byte of input.
+
+  @param inst instruction to check.
+  @return true if inst consumes a byte.
+*/
+bool instructionConsumes(Instruction const *inst)
+{
+  return inst->op == OP_CHAR || inst->op == OP_ANY || inst->op == OP_CLASS;
+}
+
+/**
+  Check if every match of the program starts at the start of the line.
+
+  @param prog program to check.
+  @return true if the program is anchored at the start.
+*/
+bool anchoredAtStart(Program const *prog)
+{
+  // Follow the epsilon instructions from the start, except ^.
+  bool seen[prog->count];
+  int stack[prog->count];
+  int top = 0;
+  memset(seen, 0, sizeof(seen));
+  seen[0] = true;
+  stack[top++] = 0;
+  while (top > 0){
+    Instruction const *inst = prog->code + stack[--top];
+    int targets[2];
+    int count = 0;
+    if (inst->op == OP_SPLIT){
+      targets[count++] = inst->x;
+      targets[count++] = inst->y;
+    } else if (inst->op == OP_JMP){
+      targets[count++] = inst->x;
+    } else if (inst->op != OP_BOL){
+      // A consuming instruction, a $ or OP_MATCH reached without a ^.
+      return false;
+    }
+    for (int i = 0; i < count; i++){
+      if (!seen[targets[i]]){
+        seen[targets[i]] = true;
+        stack[top++] = targets[i];
+      }
+    }
+  }
+  return true;
+}
+
+/**
+  Check if every match of the program ends at the end of the line.
+
+  @param prog program to check.
+  @return true if the program is anchored at the end.
+*/
+bool anchoredAtEnd(Program const *prog)
+{
+  // Find the instructions that reach OP_MATCH through epsilon
+  // instructions other than $.  Branches can go backward, so repeat
+  // until nothing changes.
+  bool reaches[prog->count];
+  memset(reaches, 0, sizeof(reaches));
+  reaches[prog->count - 1] = true;
+  for (bool changed = true; changed; ){
+    changed = false;
+    for (int pc = 0; pc < prog->count; pc++){
+      Instruction const *inst = prog->code + pc;
+      bool r = reaches[pc] ||
+        (inst->op == OP_SPLIT && (reaches[inst->x] || reaches[inst->y])) ||
+        (inst->op == OP_JMP && reaches[inst->x]) ||
+        (inst->op == OP_BOL && reaches[pc + 1]);
+      if (r && !reaches[pc]){
+        reaches[pc] = changed = true;
+      }
+    }
+  }
+  if (reaches[0]){
+    return false;
+  }
+  for (int pc = 1; pc < prog->count; pc++){
+    if (reaches[pc] && instructionConsumes(prog->code + pc - 1)){
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+  Free the memory for the given program.
+
+  @param prog program to free.
+*/
+void freeProgram(Program *prog)
+{
+  free(prog->code);
+  free(prog);
+}
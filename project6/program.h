@@ -0,0 +1,121 @@
+/**
+  This is the header file for the program component, a flat, Thompson-style
+  NFA that a Pattern tree compiles itself into.
+
+  @file program.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef PROGRAM_H
+#define PROGRAM_H
+
+#include <stdbool.h>
+#include "pattern.h"
+#include "byteset.h"
+
+/** Kinds of instructions in a compiled program. */
+typedef enum {
+  /** Consume one byte equal to c. */
+  OP_CHAR,
+  /** Consume any one byte. */
+  OP_ANY,
+  /** Consume one byte that is in set. */
+  OP_CLASS,
+  /** Continue at both x and y. */
+  OP_SPLIT,
+  /** Continue at x. */
+  OP_JMP,
+  /** Continue at the next instruction only at the start of the line. */
+  OP_BOL,
+  /** Continue at the next instruction only at the end of the line. */
+  OP_EOL,
+  /** The pattern has matched. */
+  OP_MATCH
+} Opcode;
+
+/** A single instruction of a compiled program. */
+typedef struct {
+  /** What this instruction does. */
+  Opcode op;
+  /** Byte matched by OP_CHAR. */
+  unsigned char c;
+  /** Bytes matched by an OP_CLASS, owned by the pattern that emitted it. */
+  ByteSet const *set;
+  /** Branch targets for OP_SPLIT and OP_JMP. */
+  int x, y;
+} Instruction;
+
+/** A compiled program, a growable array of instructions. */
+typedef struct ProgramStruct {
+  /** Instructions of the program, execution starts at code[ 0 ]. */
+  Instruction *code;
+  /** Number of instructions in code. */
+  int count;
+  /** Capacity of code. */
+  int capacity;
+} Program;
+
+/**
+  Append a new instruction to the program.
+
+  @param prog program being built.
+  @param op kind of the new instruction.
+  @return index of the new instruction.
+*/
+int emitInstruction(Program *prog, Opcode op);
+
+/**
+  Compile the given pattern into a new program ending in OP_MATCH.
+
+  @param pat pattern to compile.
+  @return A dynamically allocated program for the pattern.
+*/
+Program *compileProgram(Pattern *pat);
+
+/**
+  Check if a consuming instruction (OP_CHAR, OP_ANY, OP_CLASS) accepts
+  the given byte.
+
+  @param inst instruction to check.
+  @param ch byte from the input.
+  @return true if inst consumes ch.
+*/
+bool instructionAccepts(Instruction const *inst, unsigned char ch);
+
+/**
+  Check if an instruction consumes a byte of input, if it's OP_CHAR,
+  OP_ANY or OP_CLASS.
+
+  @param inst instruction to check.
+  @return true if inst consumes a byte.
+*/
+bool instructionConsumes(Instruction const *inst);
+
+/**
+  Check if every match of the program starts at the start of the line,
+  so every path to a consuming instruction, a $ or OP_MATCH goes
+  through a ^ first.
+
+  @param prog program to check.
+  @return true if the program is anchored at the start.
+*/
+bool anchoredAtStart(Program const *prog);
+
+/**
+  Check if every match of the program ends at the end of the line, so
+  every path to OP_MATCH from the start or from a consuming instruction
+  goes through a $.
+
+  @param prog program to check.
+  @return true if the program is anchored at the end.
+*/
+bool anchoredAtEnd(Program const *prog);
+
+/**
+  Free the memory for the given program.
+
+  @param prog program to free.
+*/
+void freeProgram(Program *prog);
+
+#endif
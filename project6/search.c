@@ -0,0 +1,695 @@
+/**
+  Implementation of the search component, matching lines of input with
+  the chosen engine and printing them out with the matches highlighted
+  in red.  With several patterns, a line is only given to the engines
+  for the patterns that can match it, and the matches of all of them
+  are highlighted.
+
+  @file search.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#include "search.h"
+#include "parse.h"
+#include "dfa.h"
+#include "pike.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Escape sequence that starts printing in red.
+#define START_RED "\x1b[31m"
+
+// Escape sequence that goes back to the default color.
+#define END_RED "\x1b[0m"
+
+// Printed between groups of context lines that aren't next to each other.
+#define GROUP_SEPARATOR "--\n"
+
+/** A line held for printing as context, where it is in the input. */
+typedef struct {
+  /** Offset of the line in the whole input. */
+  size_t offset;
+  /** Length of the line. */
+  int len;
+} LineSlice;
+
+/** Representation of a scanner. */
+struct ScannerStruct {
+  /** Search being matched. */
+  Search const *search;
+  /**
+    This scanner's own DFA for each pattern, since its cache changes
+    while matching.  Each is made the first time it's needed.
+  */
+  DFA **dfas;
+  /** This scanner's own Pike VM for each pattern, made the same way. */
+  Pike **pikes;
+  /** Record of the literals found in a line, or NULL with no automaton. */
+  AhoHits *hits;
+  /** Patterns a line is checked against. */
+  int *candidates;
+  /** Scratch memory for matching and printing a line, reset after every line. */
+  Arena *arena;
+  /**
+    Ring of the last lines not printed, up to the search's before
+    context, oldest first from ringStart.  They're held in the input's
+    buffer until they're printed or fall out of the ring.
+  */
+  LineSlice *ring;
+  int ringStart, ringCount;
+};
+
+/**
+   Helper function to find the runs of characters of the line inside
+   some non-empty match.  A match [ begin, end ) lies inside the longest
+   match from begin, so only the last bit of each row matters, and a
+   running maximum of those ends covers every matched character.
+
+   @param *table The pointer to the match table.
+   @param *spans array of len spans, filled in with the runs.
+   @return the number of spans.
+*/
+static int findTableSpans(MatchTable const *table, Span *spans)
+{
+  int words = table->words;
+  int reach = 0;
+  int count = 0;
+  for (int begin = 0; begin < table->len; begin++){
+    uint64_t const *row = tableRow(table, begin);
+    for (int i = words - 1; i >= 0 && (i + 1) * TABLE_WORD_BITS > reach; i--){
+      if (row[i]){
+        int end = i * TABLE_WORD_BITS + TABLE_WORD_BITS - 1 - __builtin_clzll(row[i]);
+        if (end > reach){
+          if (begin < reach){
+            // The run already going on gets longer.
+            spans[count - 1].end = end;
+          } else if (end > begin){
+            spans[count].start = begin;
+            spans[count++].end = end;
+          }
+          reach = end;
+        }
+        break;
+      }
+    }
+  }
+  return count;
+}
+
+/**
+   Helper function to print the line comprising matched text.  Spans
+   that touch are merged into one run of red, and the whole line is
+   put together in memory and written out at once.
+
+   @param *out The stream to print to.
+   @param *label The name to print before the line, or NULL.
+   @param *str The pointer to the line of text.
+   @param len The length of the line of text.
+   @param *spans The matched parts of the line, in order.
+   @param count The number of spans.
+   @param *arena The arena the line is put together in.
+*/
+static void reportMatchedLine(FILE *out, char const *label, char const *str,
+                              int len, Span const *spans, int count,
+                              Arena *arena)
+{
+  size_t labelLen = label ? strlen(label) : 0;
+  size_t size = labelLen + 1 + len + count * (sizeof(START_RED) + sizeof(END_RED)) + 1;
+  char *buf = (char *) arenaAlloc(arena, size);
+  char *p = buf;
+  if (label){
+    memcpy(p, label, labelLen);
+    p += labelLen;
+    *p++ = ':';
+  }
+  int pos = 0;
+  int i = 0;
+  while (i < count){
+    int start = spans[i].start;
+    int end = spans[i].end;
+    for (i++; i < count && spans[i].start <= end; i++){
+      if (spans[i].end > end){
+        end = spans[i].end;
+      }
+    }
+    memcpy(p, str + pos, start - pos);
+    p += start - pos;
+    // Print the matching substring in red, then the default sequence.
+    memcpy(p, START_RED, sizeof(START_RED) - 1);
+    p += sizeof(START_RED) - 1;
+    memcpy(p, str + start, end - start);
+    p += end - start;
+    memcpy(p, END_RED, sizeof(END_RED) - 1);
+    p += sizeof(END_RED) - 1;
+    pos = end;
+  }
+  memcpy(p, str + pos, len - pos);
+  p += len - pos;
+  *p++ = '\n';
+  fwrite(buf, 1, p - buf, out);
+}
+
+/**
+   Helper function to match a line with the reference table engine.
+
+   @param *pat The pointer to the pattern.
+   @param *line The pointer to the line of text.
+   @param len The length of the line of text.
+   @param *spans array of len spans, filled in with the runs of matched
+                 characters, or NULL if they aren't needed.
+   @param *count set to the number of spans, unless spans is NULL.
+   @param *arena The arena the match tables are allocated from.
+   @return true if the line has a matched pattern string.
+*/
+static bool matchLineWithTable(Pattern *pat, char const *line, int len,
+                               Span *spans, int *count, Arena *arena)
+{
+  // Zero-filled bit table to use as our match table.
+  MatchTable *table = makeTable(len, arena);
+  // Find matches for this pattern.
+  pat->match(pat, line, len, table, arena);
+  bool found = anyBit(table->bits, (len + 1) * table->words);
+  if (spans){
+    *count = findTableSpans(table, spans);
+  }
+  return found;
+}
+
+/**
+  Parse the pattern strings and build everything needed to search for
+  them.
+
+  @param pstrs pattern strings, they must outlive the search.
+  @param count number of patterns, at least 1.
+  @param engine engine used to match lines.
+  @return A dynamically allocated search.
+*/
+Search *makeSearch(char *const *pstrs, int count, Engine engine)
+{
+  Search *search = (Search *) malloc(sizeof(Search));
+  search->pats = (SearchPattern *) malloc(count * sizeof(SearchPattern));
+  search->count = count;
+  for (int i = 0; i < count; i++){
+    SearchPattern *sp = search->pats + i;
+    sp->pstr = pstrs[i];
+    sp->pat = parsePattern(pstrs[i]);
+    // The table engine is the reference, so it matches the tree as
+    // parsed, which also makes it a check on the optimizer.
+    if (engine != TABLE_ENGINE){
+      sp->pat = optimizePattern(sp->pat, &sp->parsedNodes, &sp->nodes);
+    } else {
+      sp->parsedNodes = sp->nodes = sp->pat->nodes(sp->pat);
+    }
+    sp->prog = compileProgram(sp->pat);
+    // The table engine is the reference, so it sees every line.
+    sp->pf = engine != TABLE_ENGINE ? makePrefilter(sp->pat) : NULL;
+  }
+
+  search->ac = NULL;
+  search->unfiltered = NULL;
+  search->unfilteredCount = 0;
+  search->image = NULL;
+  if (count > 1 && engine != TABLE_ENGINE){
+    // One pass over the line finds the literals of every pattern.
+    char const *literals[count];
+    search->unfiltered = (int *) malloc(count * sizeof(int));
+    for (int i = 0; i < count; i++){
+      Prefilter *pf = search->pats[i].pf;
+      literals[i] = pf ? prefilterLiteral(pf) : NULL;
+      if (!pf){
+        search->unfiltered[search->unfilteredCount++] = i;
+      }
+    }
+    search->ac = makeAhoCorasick(literals, count);
+  }
+  search->engine = engine;
+  search->mode = PRINT_LINES;
+  search->maxCount = -1;
+  search->before = search->after = 0;
+  search->binary = BINARY_MATCHES;
+  return search;
+}
+
+/**
+  Free the memory for the given search.
+
+  @param search search to free.
+*/
+void freeSearch(Search *search)
+{
+  if (search->ac){
+    freeAhoCorasick(search->ac);
+  }
+  free(search->unfiltered);
+  for (int i = 0; i < search->count; i++){
+    SearchPattern *sp = search->pats + i;
+    if (sp->pf){
+      freePrefilter(sp->pf);
+    }
+    freeProgram(sp->prog);
+    if (sp->pat){
+      sp->pat->destroy(sp->pat);
+    }
+  }
+  free(search->pats);
+  if (search->image){
+    closeInput(search->image);
+  }
+  free(search);
+}
+
+/**
+  Make a scanner, with its own matching state, for the given search.
+
+  @param search search to match lines against, it must outlive the scanner.
+  @return A dynamically allocated scanner.
+*/
+Scanner *makeScanner(Search const *search)
+{
+  Scanner *sc = (Scanner *) malloc(sizeof(Scanner));
+  sc->search = search;
+  sc->dfas = (DFA **) calloc(search->count, sizeof(DFA *));
+  sc->pikes = (Pike **) calloc(search->count, sizeof(Pike *));
+  sc->hits = search->ac ? makeAhoHits(search->ac) : NULL;
+  sc->candidates = (int *) malloc(search->count * sizeof(int));
+  sc->arena = makeArena();
+  sc->ring = (LineSlice *) malloc((search->before > 0 ? search->before : 1) *
+                                  sizeof(LineSlice));
+  sc->ringStart = sc->ringCount = 0;
+  return sc;
+}
+
+/**
+  Get the most matching lines worth looking for in one input.
+
+  @param search search to look at.
+  @return the number of lines, or -1 for no limit.
+*/
+long matchLimit(Search const *search)
+{
+  if (search->mode == PRINT_NAMES || search->mode == PRINT_NOTHING){
+    return search->maxCount == 0 ? 0 : 1;
+  }
+  return search->maxCount;
+}
+
+/**
+   Helper function to get the scanner's DFA for a pattern, making it
+   the first time.
+
+   @param *sc The pointer to the scanner.
+   @param i The index of the pattern.
+   @return the DFA.
+*/
+static DFA *patternDFA(Scanner *sc, int i)
+{
+  if (!sc->dfas[i]){
+    sc->dfas[i] = makeDFA(sc->search->pats[i].prog);
+  }
+  return sc->dfas[i];
+}
+
+/**
+   Helper function to get the scanner's Pike VM for a pattern, making it
+   the first time.
+
+   @param *sc The pointer to the scanner.
+   @param i The index of the pattern.
+   @return the Pike VM.
+*/
+static Pike *patternPike(Scanner *sc, int i)
+{
+  if (!sc->pikes[i]){
+    sc->pikes[i] = makePike(sc->search->pats[i].prog);
+  }
+  return sc->pikes[i];
+}
+
+/**
+   Helper function to find the patterns that can match a line, the ones
+   whose required literal is in it and the ones without one.
+
+   @param *sc The pointer to the scanner.
+   @param *line The pointer to the line of text.
+   @param len The length of the line of text.
+   @return the number of patterns, listed in the scanner's candidates.
+*/
+static int findCandidates(Scanner *sc, char const *line, int len)
+{
+  Search const *search = sc->search;
+  int n = 0;
+  if (search->ac){
+    int const *found;
+    int hits = findAhoWords(sc->hits, line, len, &found);
+    memcpy(sc->candidates, found, hits * sizeof(int));
+    memcpy(sc->candidates + hits, search->unfiltered,
+           search->unfilteredCount * sizeof(int));
+    return hits + search->unfilteredCount;
+  }
+  for (int i = 0; i < search->count; i++){
+    Prefilter const *pf = search->pats[i].pf;
+    // No match can be in a line without the required literal.
+    if (!pf || prefilterAccepts(pf, line, len)){
+      sc->candidates[n++] = i;
+    }
+  }
+  return n;
+}
+
+/**
+   Helper function to check if a line matches a pattern, without finding
+   where.  Each engine stops as soon as it knows.
+
+   @param *sc The pointer to the scanner.
+   @param i The index of the pattern.
+   @param *line The pointer to the line of text.
+   @param len The length of the line of text.
+   @return true if the line has a matched pattern string.
+*/
+static bool matchLine(Scanner *sc, int i, char const *line, int len)
+{
+  Search const *search = sc->search;
+  if (search->engine == TABLE_ENGINE){
+    return matchLineWithTable(search->pats[i].pat, line, len, NULL, NULL,
+                              sc->arena);
+  } else if (search->engine == PIKE_ENGINE){
+    return matchPike(patternPike(sc, i), line, len);
+  }
+  return matchDFA(patternDFA(sc, i), line, len);
+}
+
+/**
+   Helper function to find where a pattern matches in a line.
+
+   @param *sc The pointer to the scanner.
+   @param i The index of the pattern.
+   @param *line The pointer to the line of text.
+   @param len The length of the line of text.
+   @param *spans array of len spans, filled in with the matches.
+   @param *count set to the number of spans.
+   @return true if the line has a matched pattern string.
+*/
+static bool findLineSpans(Scanner *sc, int i, char const *line, int len,
+                          Span *spans, int *count)
+{
+  Search const *search = sc->search;
+  *count = 0;
+  if (search->engine == TABLE_ENGINE){
+    return matchLineWithTable(search->pats[i].pat, line, len, spans, count,
+                              sc->arena);
+  } else if (search->engine == PIKE_ENGINE){
+    return findPikeSpans(patternPike(sc, i), line, len, spans, count,
+                         sc->arena);
+  }
+  DFA *dfa = patternDFA(sc, i);
+  if (!matchDFA(dfa, line, len)){
+    return false;
+  }
+  *count = findMatchedSpans(dfa, line, len, spans, sc->arena);
+  return true;
+}
+
+/**
+   Helper function to merge two lists of spans into one that covers the
+   same characters, with no spans that overlap or touch.
+
+   @param *a The first list.
+   @param na The length of the first list.
+   @param *b The second list.
+   @param nb The length of the second list.
+   @param *out The merged list, as long as both of them.
+   @return the number of spans in the merged list.
+*/
+static int mergeSpans(Span const *a, int na, Span const *b, int nb, Span *out)
+{
+  int n = 0;
+  int i = 0;
+  int j = 0;
+  while (i < na || j < nb){
+    Span next = j == nb || (i < na && a[i].start <= b[j].start) ? a[i++] : b[j++];
+    if (n > 0 && next.start <= out[n - 1].end){
+      if (next.end > out[n - 1].end){
+        out[n - 1].end = next.end;
+      }
+    } else {
+      out[n++] = next;
+    }
+  }
+  return n;
+}
+
+/**
+   Helper function to print a line of context, with no highlighting.
+
+   @param *out The stream to print to.
+   @param *label The name to print before the line, or NULL.
+   @param *str The pointer to the line of text.
+   @param len The length of the line of text.
+*/
+static void reportContextLine(FILE *out, char const *label, char const *str,
+                              int len)
+{
+  if (label){
+    fprintf(out, "%s-", label);
+  }
+  fwrite(str, 1, len, out);
+  putc('\n', out);
+}
+
+/**
+   Helper function to add a line that isn't printed to the ring of lines
+   before the next match, dropping the oldest one if it's full.
+
+   @param *sc The pointer to the scanner.
+   @param *in The pointer to the input the line came from.
+   @param *line The pointer to the line of text.
+   @param len The length of the line of text.
+*/
+static void keepLine(Scanner *sc, Input *in, char const *line, int len)
+{
+  int size = sc->search->before;
+  if (size == 0){
+    return;
+  }
+  int i = (sc->ringStart + sc->ringCount) % size;
+  if (sc->ringCount == size){
+    sc->ringStart = (sc->ringStart + 1) % size;
+  } else {
+    sc->ringCount++;
+  }
+  sc->ring[i].offset = lineOffset(in, line);
+  sc->ring[i].len = len;
+  // Only the lines still in the ring need to stay in the buffer.
+  holdInput(in, sc->ring[sc->ringStart].offset);
+}
+
+/**
+   Helper function to print the lines in the ring before a matching
+   line, after a separator if they don't follow the last line printed.
+
+   @param *sc The pointer to the scanner.
+   @param *in The pointer to the input the lines came from.
+   @param *label The name to print before each line, or NULL.
+   @param *out The stream to print to.
+   @param lineNo The number of the matching line.
+   @param lastPrinted The number of the last line printed, or 0 for none.
+*/
+static void reportBefore(Scanner *sc, Input *in, char const *label, FILE *out,
+                         long lineNo, long lastPrinted)
+{
+  if (lastPrinted > 0 && lineNo - sc->ringCount > lastPrinted + 1){
+    fputs(GROUP_SEPARATOR, out);
+  }
+  for (int i = 0; i < sc->ringCount; i++){
+    LineSlice const *slice = sc->ring + (sc->ringStart + i) % sc->search->before;
+    reportContextLine(out, label, lineAt(in, slice->offset), slice->len);
+  }
+  sc->ringStart = sc->ringCount = 0;
+  releaseInput(in);
+}
+
+/**
+   Helper function to check if a line matches any of the patterns, with
+   nothing highlighted, so any match will do.
+
+   @param *sc The pointer to the scanner.
+   @param *line The pointer to the line of text.
+   @param len The length of the line of text.
+   @return true if the line has a matched pattern string.
+*/
+static bool anyMatch(Scanner *sc, char const *line, int len)
+{
+  int candidates = findCandidates(sc, line, len);
+  bool found = false;
+  for (int c = 0; c < candidates && !found; c++){
+    found = matchLine(sc, sc->candidates[c], line, len);
+  }
+  resetArena(sc->arena);
+  return found;
+}
+
+/**
+  Match lines of the given input until there are none left or the match
+  limit is reached, printing them in PRINT_LINES mode.
+
+  @param sc scanner to match with.
+  @param in input to read lines from.
+  @param label name printed with a colon before each line, or NULL.
+  @param out stream the matching lines are printed to.
+  @return the number of matching lines.
+*/
+long scanInput(Scanner *sc, Input *in, char const *label, FILE *out)
+{
+  Search const *search = sc->search;
+  long limit = matchLimit(search);
+  long count = 0;
+  // Numbers of the current line and the last one printed, for context.
+  long lineNo = 0;
+  long lastPrinted = 0;
+  // Lines of context still to print after the last match.
+  int afterLeft = 0;
+  char const *line;
+  int len;
+  sc->ringStart = sc->ringCount = 0;
+  while (count != limit && nextLine(in, &line, &len)){
+      lineNo++;
+      if (search->mode != PRINT_LINES){
+        count += anyMatch(sc, line, len);
+        continue;
+      }
+      int candidates = findCandidates(sc, line, len);
+      bool found = false;
+      // No more spans than characters, since they're non-empty, and the
+      // union of the matches of every pattern is kept the same way.
+      Span *spans = (Span *) arenaAlloc(sc->arena, len * sizeof(Span));
+      Span *next = (Span *) arenaAlloc(sc->arena, len * sizeof(Span));
+      Span *merged = (Span *) arenaAlloc(sc->arena, len * sizeof(Span));
+      int spanCount = 0;
+      for (int c = 0; c < candidates; c++){
+        int nextCount;
+        if (findLineSpans(sc, sc->candidates[c], line, len, next, &nextCount)){
+          if (!found){
+            Span *tmp = spans;
+            spans = next;
+            next = tmp;
+            spanCount = nextCount;
+            found = true;
+          } else {
+            spanCount = mergeSpans(spans, spanCount, next, nextCount, merged);
+            Span *tmp = spans;
+            spans = merged;
+            merged = tmp;
+          }
+        }
+      }
+      if (found){
+        if (search->before > 0 || search->after > 0){
+          reportBefore(sc, in, label, out, lineNo, lastPrinted);
+        }
+        // Print them out.
+        reportMatchedLine(out, label, line, len, spans, spanCount, sc->arena);
+        count++;
+        lastPrinted = lineNo;
+        afterLeft = search->after;
+      } else if (afterLeft > 0){
+        reportContextLine(out, label, line, len);
+        lastPrinted = lineNo;
+        afterLeft--;
+      } else {
+        keepLine(sc, in, line, len);
+      }
+      resetArena(sc->arena);
+  }
+  // Like grep, the context after the last match is printed even past the
+  // limit, whether those lines match or not.
+  while (afterLeft > 0 && nextLine(in, &line, &len)){
+    reportContextLine(out, label, line, len);
+    afterLeft--;
+  }
+  releaseInput(in);
+  return count;
+}
+
+/**
+  Match lines of a binary input in PRINT_LINES mode until one matches.
+
+  @param sc scanner to match with.
+  @param in input to read lines from.
+  @param name name of the input, printed in the message.
+  @param out stream the message is printed to.
+  @return 1 if a line matched, 0 if none did.
+*/
+long scanBinaryInput(Scanner *sc, Input *in, char const *name, FILE *out)
+{
+  if (matchLimit(sc->search) == 0){
+    return 0;
+  }
+  char const *line;
+  int len;
+  while (nextLine(in, &line, &len)){
+    if (anyMatch(sc, line, len)){
+      fprintf(out, "Binary file %s matches\n", name);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/**
+  Print what the search's mode prints once for a whole input.
+
+  @param search search the input was matched against.
+  @param out stream to print to.
+  @param name name of the input.
+  @param label true if the count is printed after the name and a colon.
+  @param count number of matching lines in the input.
+*/
+void reportInput(Search const *search, FILE *out, char const *name, bool label,
+                 long count)
+{
+  if (search->mode == PRINT_COUNT){
+    if (label){
+      fprintf(out, "%s:", name);
+    }
+    fprintf(out, "%ld\n", count);
+  } else if (search->mode == PRINT_NAMES && count > 0){
+    fprintf(out, "%s\n", name);
+  }
+}
+
+/**
+  Add the counters for the scanner's scratch memory to a running total.
+
+  @param sc scanner to report on.
+  @param total totals to add to.
+*/
+void scannerStats(Scanner const *sc, ArenaStats *total)
+{
+  addArenaStats(total, sc->arena);
+}
+
+/**
+  Free the memory for the given scanner.
+
+  @param sc scanner to free.
+*/
+void freeScanner(Scanner *sc)
+{
+  for (int i = 0; i < sc->search->count; i++){
+    if (sc->dfas[i]){
+      freeDFA(sc->dfas[i]);
+    }
+    if (sc->pikes[i]){
+      freePike(sc->pikes[i]);
+    }
+  }
+  if (sc->hits){
+    freeAhoHits(sc->hits);
+  }
+  free(sc->dfas);
+  free(sc->pikes);
+  free(sc->candidates);
+  free(sc->ring);
+  freeArena(sc->arena);
+  free(sc);
+}
@@ -0,0 +1,206 @@
+/**
+  This is the header file for the search component.  It holds everything
+  built from the patterns once (the Search), and the per-thread state for
+  matching lines of input against them and printing them (the Scanner).
+
+  @file search.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "pattern.h"
+#include "program.h"
+#include "prefilter.h"
+#include "aho.h"
+#include "input.h"
+#include "arena.h"
+
+/** Engines that can be used to match lines. */
+typedef enum {
+  /** Compiled NFA run as a lazy DFA, linear in the line length. */
+  DFA_ENGINE,
+  /**
+    The original match tables.  An optional part at the start of a
+    pattern matches empty only at the start of the line, so a*42 misses
+    "total 42", a line the compiled engines match.
+  */
+  TABLE_ENGINE,
+  /** Compiled NFA run as a Pike VM, highlighting leftmost-longest matches. */
+  PIKE_ENGINE
+} Engine;
+
+/** What's printed for the lines that match. */
+typedef enum {
+  /** Every matching line, with the matches highlighted. */
+  PRINT_LINES,
+  /** The number of matching lines in each input. */
+  PRINT_COUNT,
+  /** The name of each input with a matching line. */
+  PRINT_NAMES,
+  /** Nothing, the exit status tells if anything matched. */
+  PRINT_NOTHING
+} OutputMode;
+
+/** What's done with inputs that look binary, with a NUL near the start. */
+typedef enum {
+  /** Matching lines aren't printed, just a message that the input matches. */
+  BINARY_MATCHES,
+  /** The input is skipped, as if nothing in it matched. */
+  BINARY_SKIP,
+  /** The input is searched like any other. */
+  BINARY_TEXT
+} BinaryMode;
+
+/** One of the patterns being searched for, in all the forms the engines need. */
+typedef struct {
+  /** Pattern string from the command line. */
+  char const *pstr;
+  /** Parsed pattern, or NULL if the search was loaded from a file. */
+  Pattern *pat;
+  /** Pattern compiled for the DFA and Pike engines. */
+  Program *prog;
+  /** Literal prefilter, or NULL if lines aren't filtered. */
+  Prefilter *pf;
+  /** Nodes in the pattern as parsed and as optimized, 0 if it was loaded. */
+  int parsedNodes, nodes;
+} SearchPattern;
+
+/**
+  The patterns being searched for, a line matches if any of them does.
+  It's only read while searching, so threads can share it.
+*/
+typedef struct {
+  /** Patterns to match. */
+  SearchPattern *pats;
+  /** Number of patterns. */
+  int count;
+  /**
+    Automaton for the literals of every pattern, or NULL if each pattern
+    is filtered by its own prefilter.  When there is one, a line is only
+    checked against the patterns whose literal is in it and the
+    patterns with no literal.
+  */
+  AhoCorasick *ac;
+  /** Patterns with no literal. */
+  int *unfiltered;
+  /** Number of unfiltered patterns. */
+  int unfilteredCount;
+  /** Compiled pattern file the search was loaded from, or NULL. */
+  Input *image;
+  /** Engine used to match lines. */
+  Engine engine;
+  /** What's printed for the lines that match. */
+  OutputMode mode;
+  /** Most matching lines to look for in each input, or -1 for no limit. */
+  long maxCount;
+  /** Lines of context printed before and after each matching line, in
+      PRINT_LINES mode. */
+  int before, after;
+  /** What's done with inputs that look binary. */
+  BinaryMode binary;
+} Search;
+
+/** A short name to use for the per-thread scanner. */
+typedef struct ScannerStruct Scanner;
+
+/**
+  Parse the pattern strings and build everything needed to search for
+  them.  This exits with an error message if a pattern is invalid.  The
+  search prints every matching line, with no limit on how many and no
+  context, and binary inputs just get a message if they match.
+
+  @param pstrs pattern strings, they must outlive the search.
+  @param count number of patterns, at least 1.
+  @param engine engine used to match lines.
+  @return A dynamically allocated search.
+*/
+Search *makeSearch(char *const *pstrs, int count, Engine engine);
+
+/**
+  Free the memory for the given search.
+
+  @param search search to free.
+*/
+void freeSearch(Search *search);
+
+/**
+  Make a scanner, with its own matching state, for the given search.
+
+  @param search search to match lines against, it must outlive the scanner.
+  @return A dynamically allocated scanner.
+*/
+Scanner *makeScanner(Search const *search);
+
+/**
+  Get the most matching lines worth looking for in one input.  Listing
+  names or printing nothing only needs the first one.
+
+  @param search search to look at.
+  @return the number of lines, or -1 for no limit.
+*/
+long matchLimit(Search const *search);
+
+/**
+  Match lines of the given input until there are none left or the match
+  limit is reached.  In PRINT_LINES mode, the matching lines are printed
+  with the matches of every pattern highlighted, in the other modes
+  nothing is printed and the engines stop at the first match in each
+  line.  Context lines are printed like grep's, with a - after the label
+  instead of a colon, and -- between groups of lines that aren't next
+  to each other.  Lines before a match are held in the input's buffer
+  until it's known if they're printed, so only the last few are kept.
+
+  @param sc scanner to match with.
+  @param in input to read lines from.
+  @param label name printed with a colon before each line, or NULL.
+  @param out stream the matching lines are printed to.
+  @return the number of matching lines.
+*/
+long scanInput(Scanner *sc, Input *in, char const *label, FILE *out);
+
+/**
+  Match lines of a binary input in PRINT_LINES mode until one matches.
+  Instead of the line, a message that the input matches is printed.
+
+  @param sc scanner to match with.
+  @param in input to read lines from.
+  @param name name of the input, printed in the message.
+  @param out stream the message is printed to.
+  @return 1 if a line matched, 0 if none did.
+*/
+long scanBinaryInput(Scanner *sc, Input *in, char const *name, FILE *out);
+
+/**
+  Print what the search's mode prints once for a whole input, the count
+  of matching lines or the name if anything matched.  Nothing is printed
+  in the other modes.
+
+  @param search search the input was matched against.
+  @param out stream to print to.
+  @param name name of the input.
+  @param label true if the count is printed after the name and a colon.
+  @param count number of matching lines in the input.
+*/
+void reportInput(Search const *search, FILE *out, char const *name, bool label,
+                 long count);
+
+/**
+  Add the counters for the scanner's scratch memory to a running total.
+
+  @param sc scanner to report on.
+  @param total totals to add to.
+*/
+void scannerStats(Scanner const *sc, ArenaStats *total);
+
+/**
+  Free the memory for the given scanner.
+
+  @param sc scanner to free.
+*/
+void freeScanner(Scanner *sc);
+
+#endif
@@ -0,0 +1,25 @@
+/**
+  This is the header file for spans, the pieces of a line that the
+  engines report as matched, so they can be highlighted.
+
+  @file span.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef SPAN_H
+#define SPAN_H
+
+/**
+  The characters start .. end - 1 of a line.  Engines report matches as
+  an array of non-empty spans in increasing order that don't overlap,
+  though one may end right where the next one starts.  A line of len
+  characters never has more than len of them.
+*/
+typedef struct {
+  /** Index of the first character. */
+  int start;
+  /** Index just past the last character. */
+  int end;
+} Span;
+
+#endif
@@ -0,0 +1,126 @@
+/**
+  Implementation of the table component.  Rows are ORed together with
+  AVX2 when the processor has it, 256 bits at a time, and a word at a
+  time otherwise.
+
+  @file table.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#include "table.h"
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL
+#endif
+
+// Number of words in an AVX2 register.
+#define AVX2_WORDS 4
+
+/**
+  Make a table for a string of the given length, with every bit clear.
+
+  @param len length of the string.
+  @param arena arena the table is allocated from.
+  @return A table, good until the arena is reset or released.
+*/
+MatchTable *makeTable(int len, Arena *arena)
+{
+  MatchTable *table = (MatchTable *) arenaAlloc(arena, sizeof(MatchTable));
+  table->len = len;
+  table->words = (len + 1 + TABLE_WORD_BITS - 1) / TABLE_WORD_BITS;
+  size_t size = (size_t) (len + 1) * table->words * sizeof(uint64_t);
+  table->bits = (uint64_t *) arenaAlloc(arena, size);
+  memset(table->bits, 0, size);
+  return table;
+}
+
+#ifdef HAVE_AVX2_KERNEL
+// OR rows 256 bits at a time.
+__attribute__((target("avx2")))
+static void orRowAVX2(uint64_t *dest, uint64_t const *src, int words)
+{
+  int i = 0;
+  for (; i + AVX2_WORDS <= words; i += AVX2_WORDS){
+    __m256i a = _mm256_loadu_si256((__m256i const *) (dest + i));
+    __m256i b = _mm256_loadu_si256((__m256i const *) (src + i));
+    _mm256_storeu_si256((__m256i *) (dest + i), _mm256_or_si256(a, b));
+  }
+  for (; i < words; i++){
+    dest[i] |= src[i];
+  }
+}
+#endif
+
+/**
+  OR the words of one row into another.
+
+  @param dest row to change.
+  @param src row to OR into dest.
+  @param words number of words in a row.
+*/
+void orRow(uint64_t *dest, uint64_t const *src, int words)
+{
+#ifdef HAVE_AVX2_KERNEL
+  // Short rows aren't worth the call.
+  static int avx2 = -1;
+  if (words >= AVX2_WORDS){
+    if (avx2 < 0){
+      avx2 = __builtin_cpu_supports("avx2");
+    }
+    if (avx2){
+      orRowAVX2(dest, src, words);
+      return;
+    }
+  }
+#endif
+  for (int i = 0; i < words; i++){
+    dest[i] |= src[i];
+  }
+}
+
+/**
+  Clear the bits of a row outside of [ lo, hi ].
+
+  @param row row to change.
+  @param words number of words in a row.
+  @param lo first bit to keep.
+  @param hi last bit to keep.
+*/
+void maskRow(uint64_t *row, int words, int lo, int hi)
+{
+  for (int i = 0; i < words; i++){
+    int first = i * TABLE_WORD_BITS;
+    int last = first + TABLE_WORD_BITS - 1;
+    if (lo > last || hi < first || lo > hi){
+      row[i] = 0;
+      continue;
+    }
+    uint64_t mask = ~(uint64_t) 0;
+    if (lo > first){
+      mask <<= lo - first;
+    }
+    if (hi < last){
+      mask &= ~(uint64_t) 0 >> (last - hi);
+    }
+    row[i] &= mask;
+  }
+}
+
+/**
+  Check if any bit of a row is set.
+
+  @param row row to check.
+  @param words number of words in a row.
+  @return true if some bit is set.
+*/
+bool anyBit(uint64_t const *row, int words)
+{
+  for (int i = 0; i < words; i++){
+    if (row[i]){
+      return true;
+    }
+  }
+  return false;
+}
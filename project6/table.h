@@ -0,0 +1,109 @@
+/**
+  This is the header file for the table component, the packed bit
+  tables patterns fill in with the places they match a string.
+
+  @file table.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef TABLE_H
+#define TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "arena.h"
+
+/** Number of bits in a word of a table row. */
+#define TABLE_WORD_BITS 64
+
+/**
+  A ( len + 1 ) x ( len + 1 ) table of bits for a string of length len.
+  Bit end of row begin is set if str[ begin ] .. str[ end - 1 ] matches.
+  Each row is an array of words, so a whole row can be combined with
+  another a word at a time.
+*/
+typedef struct {
+  /** Length of the string the table is for. */
+  int len;
+  /** Number of words in each row. */
+  int words;
+  /** The rows, one after another. */
+  uint64_t *bits;
+} MatchTable;
+
+/**
+  Make a table for a string of the given length, with every bit clear.
+
+  @param len length of the string.
+  @param arena arena the table is allocated from.
+  @return A table, good until the arena is reset or released.
+*/
+MatchTable *makeTable(int len, Arena *arena);
+
+/**
+  Get a row of the table.
+
+  @param table table to look in.
+  @param begin index of the row.
+  @return pointer to the words of the row.
+*/
+static inline uint64_t *tableRow(MatchTable const *table, int begin)
+{
+  return table->bits + (size_t) begin * table->words;
+}
+
+/**
+  Check a bit of the table.
+
+  @param table table to look in.
+  @param begin start of the substring.
+  @param end end of the substring.
+  @return true if the bit for [ begin, end ) is set.
+*/
+static inline bool getTableBit(MatchTable const *table, int begin, int end)
+{
+  return (tableRow(table, begin)[end / TABLE_WORD_BITS] >> (end % TABLE_WORD_BITS)) & 1;
+}
+
+/**
+  Set a bit of the table.
+
+  @param table table to change.
+  @param begin start of the substring.
+  @param end end of the substring.
+*/
+static inline void setTableBit(MatchTable *table, int begin, int end)
+{
+  tableRow(table, begin)[end / TABLE_WORD_BITS] |= (uint64_t) 1 << (end % TABLE_WORD_BITS);
+}
+
+/**
+  OR the words of one row into another.
+
+  @param dest row to change.
+  @param src row to OR into dest.
+  @param words number of words in a row.
+*/
+void orRow(uint64_t *dest, uint64_t const *src, int words);
+
+/**
+  Clear the bits of a row outside of [ lo, hi ].
+
+  @param row row to change.
+  @param words number of words in a row.
+  @param lo first bit to keep.
+  @param hi last bit to keep.
+*/
+void maskRow(uint64_t *row, int words, int lo, int hi);
+
+/**
+  Check if any bit of a row is set.
+
+  @param row row to check.
+  @param words number of words in a row.
+  @return true if some bit is set.
+*/
+bool anyBit(uint64_t const *row, int words);
+
+#endif
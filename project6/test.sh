@@ -64,8 +64,8 @@ checkResults() {
 runTest() {
   rm -f output.txt stderr.txt
 
-  echo "Test $1: ./ugrep '$2' input-$1.txt > output.txt 2> stderr.txt"
-  ./ugrep "$2" input-$1.txt > output.txt 2> stderr.txt
+  echo "Test $1: ./ugrep ${ENGINE:+--engine=$ENGINE} '$2' input-$1.txt > output.txt 2> stderr.txt"
+  ./ugrep ${ENGINE:+--engine=$ENGINE} "$2" input-$1.txt > output.txt 2> stderr.txt
   STATUS=$?
 
   checkResults "$1" "$3"
@@ -79,7 +79,7 @@ runTest 04 'abc' 0
 runTest 05 'a.c' 0
 
 echo "Test 06: ./ugrep 'a..c' < input-06.txt > output.txt 2> stderr.txt"
-./ugrep 'a..c' < input-06.txt > output.txt 2> stderr.txt
+./ugrep ${ENGINE:+--engine=$ENGINE} 'a..c' < input-06.txt > output.txt 2> stderr.txt
 STATUS=$?
 checkResults 06 0
 
@@ -93,7 +93,7 @@ runTest 13 'ab?c' 0
 runTest 14 'a(bc)*d' 0
 
 echo "Test 15: ./ugrep '^Your (license|application|program) has been (revoked|accepted|tested)!$' input-15.txt > output.txt 2> stderr.txt"
-./ugrep '^Your (license|application|program) has been (revoked|accepted|tested)!$' input-15.txt > output.txt 2> stderr.txt
+./ugrep ${ENGINE:+--engine=$ENGINE} '^Your (license|application|program) has been (revoked|accepted|tested)!$' input-15.txt > output.txt 2> stderr.txt
 STATUS=$?
 checkResults 15 0
 
@@ -103,17 +103,136 @@ runTest 17 '*' 1
 runTest 18 'abc[123' 1
 
 echo "Test 19: ./ugrep 'abc' not-a-file.txt > output.txt 2> stderr.txt"
-./ugrep 'abc' not-a-file.txt > output.txt 2> stderr.txt
+./ugrep ${ENGINE:+--engine=$ENGINE} 'abc' not-a-file.txt > output.txt 2> stderr.txt
 STATUS=$?
 checkResults 19 1
 
 # Bad command-line arguments
-echo "Test 20: ./ugrep too many arguments > output.txt 2> stderr.txt"
-./ugrep too many arguments > output.txt 2> stderr.txt
+echo "Test 20: ./ugrep > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} > output.txt 2> stderr.txt
 STATUS=$?
 checkResults 20 1
 
-runTest 21 'this|that' 1
+runTest 21 'this|that' 0
+
+# The Pike VM highlights leftmost-longest matches, not every match.
+echo "Test 22: ./ugrep --engine=pike 'ab|bcd' input-22.txt > output.txt 2> stderr.txt"
+./ugrep --engine=pike 'ab|bcd' input-22.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 22 0
+
+# Only the first two matching lines are printed.
+echo "Test 23: ./ugrep -m 2 'ab' input-23.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} -m 2 'ab' input-23.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 23 0
+
+# Matching lines are counted for each file instead of printed.
+echo "Test 24: ./ugrep -c 'ab' input-23.txt input-24.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} -c 'ab' input-23.txt input-24.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 24 0
+
+# A line matches if any of the patterns does, and every match is highlighted.
+echo "Test 25: ./ugrep -e 'E10[0-9]+' -e 'and E2' -e 'E2001' input-25.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} -e 'E10[0-9]+' -e 'and E2' -e 'E2001' input-25.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 25 0
+
+# Patterns can come from a file, one on each line.
+echo "Test 26: ./ugrep -f patterns-26.txt input-26.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} -f patterns-26.txt input-26.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 26 0
+
+# Patterns compiled on one run can be loaded on the next, with the same results.
+echo "Test 27: ./ugrep --load-compiled=compiled-27.tmp -f patterns-26.txt input-26.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} --save-compiled=compiled-27.tmp -f patterns-26.txt input-26.txt > /dev/null 2> stderr.txt
+./ugrep ${ENGINE:+--engine=$ENGINE} --load-compiled=compiled-27.tmp -f patterns-26.txt input-26.txt > output.txt 2> stderr.txt
+STATUS=$?
+rm -f compiled-27.tmp
+checkResults 27 0
+
+# Alternatives sharing a prefix and nested repetitions match as written.
+echo "Test 28: ./ugrep 'foobar|foobaz|fo(o|x)d|(o*)*ba' input-28.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} 'foobar|foobaz|fo(o|x)d|(o*)*ba' input-28.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 28 0
+
+# Patterns anchored at the start or end of the line only match there.
+echo "Test 29: ./ugrep -e '^xy' -e 'ab+$' input-29.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} -e '^xy' -e 'ab+$' input-29.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 29 0
+
+# Long lines with many matches are highlighted all the way through.
+echo "Test 46: ./ugrep '\"user\":\"(alice|bob)\",\"status\":5' input-46.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} '"user":"(alice|bob)","status":5' input-46.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 46 0
+
+# Lines around each match are printed as context, with -- between groups.
+echo "Test 47: ./ugrep -B 1 -A 2 'ab' input-47.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} -B 1 -A 2 'ab' input-47.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 47 0
+
+# A file with a NUL near the start is binary, and only reported as matching.
+echo "Test 48: ./ugrep 'a.c' input-48.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} 'a.c' input-48.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 48 0
+
+# Read as text, lines are matched by length, and . matches a NUL.
+echo "Test 49: ./ugrep --binary-files=text 'a.c' input-48.txt > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} --binary-files=text 'a.c' input-48.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 49 0
+
+# Directories are walked all the way down with -r, choosing files by glob.
+echo "Test 50: ./ugrep -r --include='*.txt' --exclude-dir=skip 'ab' input-50 > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} -r --include='*.txt' --exclude-dir=skip 'ab' input-50 > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 50 0
+
+# A directory that can't be opened is reported, and the walk fails.  With
+# only one descriptor to spare, the walker can't open a subdirectory.
+echo "Test 51: (ulimit -n 4; ./ugrep -r 'ab' input-51) > output.txt 2> stderr.txt"
+(ulimit -n 4; ./ugrep ${ENGINE:+--engine=$ENGINE} -r 'ab' input-51) > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 51 1
+
+# Files under /proc report a size of 0, but their content is still read.
+echo "Test 52: ./ugrep -c '^Name:.ugrep$' /proc/self/status > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} -c '^Name:.ugrep$' /proc/self/status > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 52 0
+
+# A directory named with a trailing slash is walked with no doubled
+# slashes, going back to it between its subdirectories.
+echo "Test 53: ./ugrep -r 'ab' input-50/ > output.txt 2> stderr.txt"
+./ugrep ${ENGINE:+--engine=$ENGINE} -r 'ab' input-50/ > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 53 0
+
+# An optional part at the start of a pattern can match empty anywhere,
+# so the compiled engines find 42 in "total 42".
+echo "Test 54: ./ugrep -e 'a*42' -e '-?[0-9]+' input-54.txt > output.txt 2> stderr.txt"
+./ugrep -e 'a*42' -e '-?[0-9]+' input-54.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 54 0
+
+echo "Test 55: ./ugrep --engine=pike -e 'a*42' -e '-?[0-9]+' input-54.txt > output.txt 2> stderr.txt"
+./ugrep --engine=pike -e 'a*42' -e '-?[0-9]+' input-54.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 55 0
+
+# The table engine keeps the old behavior, matching the optional part
+# empty only at the start of the line, so it misses "total 42".
+echo "Test 56: ./ugrep --engine=table -e 'a*42' -e '-?[0-9]+' input-54.txt > output.txt 2> stderr.txt"
+./ugrep --engine=table -e 'a*42' -e '-?[0-9]+' input-54.txt > output.txt 2> stderr.txt
+STATUS=$?
+checkResults 56 0
 
 if [ $FAIL -ne 0 ]; then
   echo "FAILING TESTS!"
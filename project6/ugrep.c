@@ -9,164 +9,291 @@
   @author Vivekanand Ganapathy Nagarajan vganapa
   */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include "pattern.h"
-#include "parse.h"
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "search.h"
+#include "parallel.h"
+#include "cache.h"
+#include "walk.h"
+
+// Among the non-option arguments, which one is the pattern, if it's not
+// given with -e or -f.
+#define PAT_ARG 0
+
+// Among the non-option arguments, where the input files start after the
+// pattern.
+#define FILE_ARG 1
+
+// min non-option command line arguments, without -e or -f
+#define MIN_ARG 1
+
+// Option for choosing the matching engine.
+#define ENGINE_OPTION "--engine="
+
+// Option for printing how the pattern will be matched.
+#define DEBUG_PLAN_OPTION "--debug-plan"
+
+// Option for printing the scratch memory counters after searching.
+#define STATS_OPTION "--stats"
+
+// Option for the number of worker threads, followed by the number.
+#define THREADS_OPTION "-j"
+
+// Option for printing the number of matching lines in each input.
+#define COUNT_OPTION "-c"
+
+// Option for printing the name of each input with a matching line.
+#define NAMES_OPTION "-l"
+
+// Option for printing nothing, only setting the exit status.
+#define QUIET_OPTION "-q"
+
+// Option for the most matching lines to look for, followed by the number.
+#define MAX_COUNT_OPTION "-m"
+
+// Options for the lines of context printed after, before, and both
+// before and after each matching line, followed by the number.
+#define AFTER_OPTION "-A"
+#define BEFORE_OPTION "-B"
+#define CONTEXT_OPTION "-C"
+
+// Option for a pattern to search for, followed by the pattern.
+#define PATTERN_OPTION "-e"
+
+// Option for a file of patterns to search for, one on each line.
+#define PATTERN_FILE_OPTION "-f"
+
+// Option for saving the compiled patterns, followed by the file name.
+#define SAVE_COMPILED_OPTION "--save-compiled="
+
+// Option for loading compiled patterns, followed by the file name.
+#define LOAD_COMPILED_OPTION "--load-compiled="
+
+// Option for what's done with binary files, followed by binary,
+// without-match or text.
+#define BINARY_FILES_OPTION "--binary-files="
+
+// Option for searching every file under the input directories.
+#define RECURSIVE_OPTION "-r"
 
-// On the command line, which argument is the pattern.
-#define PAT_ARG 1
+// Options for globs choosing the files searched under directories,
+// followed by the glob.
+#define INCLUDE_OPTION "--include="
+#define EXCLUDE_OPTION "--exclude="
+#define EXCLUDE_DIR_OPTION "--exclude-dir="
 
-// On the command line, which argument is the input file.
-#define FILE_ARG 2
+// Input searched by -r when none is given.
+#define RECURSIVE_DEFAULT "."
 
-// min command line arguments
-#define MIN_ARG 2
+// Name printed by -l for standard input.
+#define STDIN_NAME "(standard input)"
 
-// max command line arguments
-#define MAX_ARG 3
+// Marks the end of the options.
+#define END_OF_OPTIONS "--"
+
+/** Settings from the command-line options. */
+typedef struct {
+  /** Engine used to match lines. */
+  Engine engine;
+  /** True if the matching plan is printed to stderr. */
+  bool debugPlan;
+  /** True if the scratch memory counters are printed to stderr. */
+  bool stats;
+  /** Number of worker threads for searching files. */
+  int threads;
+  /** What's printed for the lines that match. */
+  OutputMode mode;
+  /** Most matching lines to look for in each input, or -1 for no limit. */
+  long maxCount;
+  /** Lines of context printed before and after each matching line, or
+      -1 to use context. */
+  int before, after;
+  /** Lines of context on either side, unless -A or -B gives them. */
+  int context;
+  /** What's done with inputs that look binary. */
+  BinaryMode binary;
+  /** True if directories are searched all the way down. */
+  bool recursive;
+  /** File to save the compiled patterns to, or NULL. */
+  char const *saveName;
+  /** File to load compiled patterns from, or NULL. */
+  char const *loadName;
+} Options;
 
 #define SINGLE_QUOTE 39
 
-#define MAX_CHAR_PER_LINE 100
+#define MULTIPLY_FACTOR 2
+
+// initial capacity of the lists of patterns and input files
+#define INIT_CAP_LIST 16
+
+/** A growable list of strings, for patterns or file names. */
+typedef struct {
+  /** Dynamically allocated strings. */
+  char **names;
+  /** Number of strings. */
+  int count;
+  /** Capacity of names. */
+  int capacity;
+} StringList;
 
 /**
-   Helper function to match the line.
-
-   @param *pstr The pointer to the pattern string.
-   @param *str The pointer to the line of text.
-   @param len The length of the line of text.
-   @param (*table) The pointer to a row in the 2d array.
-   @param k=-1 checks for line match else checks for char in line match .
-   @return true if the line has a matched pattern string.
+   Print the usage message and exit unsuccessfully.
 */
-bool matchedLine(char const *pstr, char const *str, int len,
-                    bool (*table)[len + 1], int k)
+static void usage()
 {
-  for (int begin = 0; begin <= len; begin++){
-    for (int end = begin; end <= len; end++){
-      if (table[begin][end] && k == -1) {
-        // Report the matching line.
-        return true;
-      }
-      if (table[begin][end] && k >= begin && k < end) {
-        // Report the matching char in line.
-        //printf(" begin: %d  end: %d \n", begin, end);
-        return true;
-      }
-    }
+  fprintf(stderr, "usage: ugrep [-c | -l | -q] [-m num] [-A num] [-B num] [-C num] [--binary-files=type] [-r] [--include=glob] [--exclude=glob] [--exclude-dir=glob] [-j threads] [-e pattern | -f file ...] <pattern> [input-file.txt ...]\n");
+  exit(EXIT_FAILURE);
+}
+
+/**
+   Helper function to parse the number after an option, exiting with the
+   usage message if it's not a number of lines.
+
+   @param *str The string after the option.
+   @return the number.
+*/
+static int parseLines(char const *str)
+{
+  char *end;
+  long lines = strtol(str, &end, 10);
+  if (*end || end == str || lines < 0 || lines > INT_MAX){
+    usage();
   }
-  return false;
+  return lines;
 }
 
 /**
-   Helper function to print the line comprising matched text.
+   Helper function to print how the pattern will be matched.
 
-   @param *pstr The pointer to the pattern string.
-   @param *str The pointer to the line of text.
-   @param len The length of the line of text.
-   @param (*table) The pointer to a row in the 2d array.
+   @param *search The pointer to the search for the pattern.
 */
-void reportMatchedLine( char const *pstr, char const *str, int len,
-                    bool (*table)[ len + 1 ] )
+static void reportPlan(Search const *search)
 {
-    int red = false;
-    for (int k = 0; k<len; k++){
-      // check for matching char in line
-      if (matchedLine(pstr, str, len, table, k)){
-        if (!red){
-          red = true;
-          // Print the matching substring in red
-          fprintf(stdout, "\x1b[31m");
-        }
-      }else{
-        if (red){
-          red = false;
-          // Print the default sequence
-          fprintf(stdout, "\x1b[0m");
-        }
-      }
-      // print the character
-      printf( "%c", str[ k ] );
-    }
-    if (red){
-        fprintf(stdout, "\x1b[0m");
+  char const *names[] = { "dfa", "table", "pike" };
+  fprintf(stderr, "engine: %s\n", names[search->engine]);
+  if (search->image){
+    fprintf(stderr, "compiled: loaded\n");
+  }
+  if (search->count > 1){
+    fprintf(stderr, "patterns: %d\n", search->count);
+  }
+  if (!search->image){
+    int parsed = 0, nodes = 0;
+    for (int i = 0; i < search->count; i++){
+      parsed += search->pats[i].parsedNodes;
+      nodes += search->pats[i].nodes;
     }
-    printf( "\n" );
+    fprintf(stderr, "nodes: %d parsed, %d optimized\n", parsed, nodes);
+  }
+  if (search->ac){
+    fprintf(stderr, "literals: %d patterns, %d automaton states\n",
+            search->count - search->unfilteredCount, ahoStates(search->ac));
+    fprintf(stderr, "unfiltered: %d patterns\n", search->unfilteredCount);
+  } else if (search->count > 1){
+    fprintf(stderr, "literals: none\n");
+  } else if (search->pats[0].pf){
+    fprintf(stderr, "literal: \"%s\"\n", prefilterLiteral(search->pats[0].pf));
+  } else {
+    fprintf(stderr, "literal: none\n");
+  }
 }
 
 /**
-   Helper function to read char from file/stdin.
+   Helper function to print the counters for the scratch memory used
+   while matching lines.
 
-   @param *fp The pointer to the given file
-   @return char from file if *fp passed else read char from stdin.
+   @param *stats The pointer to the totals for every scanner.
 */
-static int readChar(FILE *fp)
+static void reportStats(ArenaStats const *stats)
 {
-  if (fp){
-    return fgetc(fp);
+  fprintf(stderr, "arena allocations: %ld\n", stats->allocations);
+  fprintf(stderr, "arena bytes: %lld\n", stats->bytes);
+  fprintf(stderr, "arena peak bytes: %zu\n", stats->peak);
+  fprintf(stderr, "arena heap blocks: %ld\n", stats->heapBlocks);
+  fprintf(stderr, "arena resets: %ld\n", stats->resets);
+}
+
+/**
+   Helper function to add a copy of a string to the list.
+
+   @param *list The pointer to the list.
+   @param *name The string to add.
+*/
+static void addString(StringList *list, char const *name)
+{
+  if (list->count >= list->capacity){
+    list->capacity *= MULTIPLY_FACTOR;
+    list->names = (char **) realloc(list->names, list->capacity * sizeof(char *));
   }
-  return fgetc(stdin);
+  list->names[list->count] = (char *) malloc(strlen(name) + 1);
+  strcpy(list->names[list->count++], name);
 }
 
 /**
-   Helper function to read line.
+   Helper function to check if a command-line input is a directory.
 
-   @param *fp The pointer to the given file.
-   @param *line The pointer to the given line.
-   @return true if EOF not reached/false otherwise.
+   @param *name The name from the command line.
+   @return true if name is a directory.
 */
-static bool readLine(FILE *fp, char *line)
+static bool isDirectory(char const *name)
 {
-  int index = 0;
-  int ch = readChar(fp);
-  while (ch != '\n' && ch != EOF){
-    if (index >= MAX_CHAR_PER_LINE){
-      fprintf(stderr, "Input line too long\n");
-      exit(EXIT_FAILURE);
-    }
-    line[index++] = ch;
-    ch = readChar(fp);
+  struct stat st;
+  return stat(name, &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+/**
+   Helper function to add the patterns in a file to the list, one for
+   each line.  Blank lines are skipped.  This exits with an error
+   message if the file can't be opened.
+
+   @param *list The pointer to the list.
+   @param *name The name of the file.
+*/
+static void addPatternFile(StringList *list, char const *name)
+{
+  FILE *fp = fopen(name, "r");
+  if (!fp){
+    fprintf(stderr, "Can't open pattern file: %s\n", name);
+    exit(EXIT_FAILURE);
   }
-  line[index] = '\0';
-  if (ch == EOF){
-    return false;
+  char *line = NULL;
+  size_t capacity = 0;
+  ssize_t len;
+  while ((len = getline(&line, &capacity, fp)) != -1){
+    if (len > 0 && line[len - 1] == '\n'){
+      line[--len] = '\0';
+    }
+    if (len > 0){
+      addString(list, line);
+    }
   }
-  return true;
+  free(line);
+  fclose(fp);
 }
 
 /**
-   Helper function to match the pattern with file.
+   Helper function to free the strings in a list, and the list.
 
-   @param *fp The pointer to the given file.
-   @param *pstr The pointer to the given pattern string.
+   @param *list The pointer to the list.
 */
-static void matchPatternWithFile(FILE *fp, char *pstr)
+static void freeStringList(StringList *list)
 {
-  Pattern *pat = parsePattern(pstr);
-  char line[MAX_CHAR_PER_LINE+1];
-  while (readLine(fp, line)){
-      int len = strlen(line);
-      // Zero-filled array to use as our match table.
-      bool (*table)[len + 1]  = calloc((len + 1) * (len + 1), sizeof(bool));
-      // Find matches for this pattern.
-      pat->match(pat, line, len, table);
-      if (matchedLine(pstr, line, len, table, -1)){
-        // Print them out.
-        reportMatchedLine(pstr, line, len, table);
-      }
-      free(table);
-  }
-  pat->destroy(pat);
-  if (fp){
-    fclose(fp);
+  for (int i = 0; i < list->count; i++){
+    free(list->names[i]);
   }
+  free(list->names);
 }
 
 /**
    Entry point for the program, parses command-line arguments, builds
-   the pattern and then tests it against lines of input.
+   the patterns and then tests them against lines of input.
 
    @param argc Number of command-line arguments.
    @param argv List of command-line arguments.
@@ -174,20 +301,171 @@ static void matchPatternWithFile(FILE *fp, char *pstr)
 */
 int main( int argc, char *argv[] )
 {
-  if (argc < MIN_ARG || argc > MAX_ARG){
-    fprintf(stderr, "usage: ugrep <pattern> [input-file.txt]\n");
+  Options opts = { DFA_ENGINE, false, false, sysconf(_SC_NPROCESSORS_ONLN),
+                   PRINT_LINES, -1, -1, -1, 0, BINARY_MATCHES, false, NULL,
+                   NULL };
+  StringList patterns = { (char **) malloc(INIT_CAP_LIST * sizeof(char *)), 0,
+                          INIT_CAP_LIST };
+  Walker *walker = makeWalker();
+  // Options come first, the pattern and input files after them.
+  int arg = 1;
+  while (arg < argc && argv[arg][0] == '-' && argv[arg][1]){
+    if (strcmp(argv[arg], END_OF_OPTIONS) == 0){
+      arg++;
+      break;
+    } else if (strcmp(argv[arg], ENGINE_OPTION "dfa") == 0){
+      opts.engine = DFA_ENGINE;
+    } else if (strcmp(argv[arg], ENGINE_OPTION "table") == 0){
+      opts.engine = TABLE_ENGINE;
+    } else if (strcmp(argv[arg], ENGINE_OPTION "pike") == 0){
+      opts.engine = PIKE_ENGINE;
+    } else if (strcmp(argv[arg], DEBUG_PLAN_OPTION) == 0){
+      opts.debugPlan = true;
+    } else if (strcmp(argv[arg], STATS_OPTION) == 0){
+      opts.stats = true;
+    } else if (strcmp(argv[arg], THREADS_OPTION) == 0 && arg + 1 < argc){
+      opts.threads = atoi(argv[++arg]);
+      if (opts.threads < 1){
+        usage();
+      }
+    } else if (strcmp(argv[arg], COUNT_OPTION) == 0){
+      opts.mode = PRINT_COUNT;
+    } else if (strcmp(argv[arg], NAMES_OPTION) == 0){
+      opts.mode = PRINT_NAMES;
+    } else if (strcmp(argv[arg], QUIET_OPTION) == 0){
+      opts.mode = PRINT_NOTHING;
+    } else if (strcmp(argv[arg], PATTERN_OPTION) == 0 && arg + 1 < argc){
+      addString(&patterns, argv[++arg]);
+    } else if (strcmp(argv[arg], PATTERN_FILE_OPTION) == 0 && arg + 1 < argc){
+      addPatternFile(&patterns, argv[++arg]);
+    } else if (strncmp(argv[arg], SAVE_COMPILED_OPTION,
+                       strlen(SAVE_COMPILED_OPTION)) == 0){
+      opts.saveName = argv[arg] + strlen(SAVE_COMPILED_OPTION);
+    } else if (strncmp(argv[arg], LOAD_COMPILED_OPTION,
+                       strlen(LOAD_COMPILED_OPTION)) == 0){
+      opts.loadName = argv[arg] + strlen(LOAD_COMPILED_OPTION);
+    } else if (strcmp(argv[arg], MAX_COUNT_OPTION) == 0 && arg + 1 < argc){
+      char *end;
+      opts.maxCount = strtol(argv[++arg], &end, 10);
+      if (*end || end == argv[arg] || opts.maxCount < 0){
+        usage();
+      }
+    } else if (strcmp(argv[arg], BINARY_FILES_OPTION "binary") == 0){
+      opts.binary = BINARY_MATCHES;
+    } else if (strcmp(argv[arg], BINARY_FILES_OPTION "without-match") == 0){
+      opts.binary = BINARY_SKIP;
+    } else if (strcmp(argv[arg], BINARY_FILES_OPTION "text") == 0){
+      opts.binary = BINARY_TEXT;
+    } else if (strcmp(argv[arg], AFTER_OPTION) == 0 && arg + 1 < argc){
+      opts.after = parseLines(argv[++arg]);
+    } else if (strcmp(argv[arg], BEFORE_OPTION) == 0 && arg + 1 < argc){
+      opts.before = parseLines(argv[++arg]);
+    } else if (strcmp(argv[arg], CONTEXT_OPTION) == 0 && arg + 1 < argc){
+      opts.context = parseLines(argv[++arg]);
+    } else if (strcmp(argv[arg], RECURSIVE_OPTION) == 0){
+      opts.recursive = true;
+    } else if (strncmp(argv[arg], INCLUDE_OPTION, strlen(INCLUDE_OPTION)) == 0){
+      addGlob(walker, INCLUDE_GLOB, argv[arg] + strlen(INCLUDE_OPTION));
+    } else if (strncmp(argv[arg], EXCLUDE_OPTION, strlen(EXCLUDE_OPTION)) == 0){
+      addGlob(walker, EXCLUDE_GLOB, argv[arg] + strlen(EXCLUDE_OPTION));
+    } else if (strncmp(argv[arg], EXCLUDE_DIR_OPTION,
+                       strlen(EXCLUDE_DIR_OPTION)) == 0){
+      addGlob(walker, EXCLUDE_DIR_GLOB, argv[arg] + strlen(EXCLUDE_DIR_OPTION));
+    } else {
+      usage();
+    }
+    arg++;
+  }
+  if (opts.threads < 1){
+    opts.threads = 1;
+  }
+  // Like grep, -A and -B win over -C, whatever order they're in.
+  if (opts.before < 0){
+    opts.before = opts.context;
+  }
+  if (opts.after < 0){
+    opts.after = opts.context;
+  }
+  char **args = argv + arg;
+  int count = argc - arg;
+  if (patterns.count == 0){
+    // Without -e or -f, the pattern is the first argument.
+    if (count < MIN_ARG){
+      usage();
+    }
+    addString(&patterns, args[PAT_ARG]);
+    args += FILE_ARG;
+    count -= FILE_ARG;
+  }
+  // Like grep -r, with no inputs the working directory is searched.
+  char *recursiveDefault[] = { RECURSIVE_DEFAULT };
+  if (count == 0 && opts.recursive){
+    args = recursiveDefault;
+    count = 1;
+  }
+
+  // A compiled file that's missing or out of date is quietly ignored, and
+  // the patterns are compiled as usual.
+  Search *search = NULL;
+  if (opts.loadName){
+    search = loadCompiled(patterns.names, patterns.count, opts.engine,
+                          opts.loadName);
+  }
+  if (!search){
+    search = makeSearch(patterns.names, patterns.count, opts.engine);
+  }
+  if (opts.saveName && !saveCompiled(search, opts.saveName)){
+    fprintf(stderr, "Can't write compiled file: %s\n", opts.saveName);
     exit(EXIT_FAILURE);
   }
-  FILE *fp = NULL;
-  if (argc == MAX_ARG){
-    fp= fopen(argv[FILE_ARG], "r");
-    if (!fp){
-      fprintf(stderr, "Can't open input file: %s\n", argv[FILE_ARG]);
-      exit(EXIT_FAILURE);
+  search->mode = opts.mode;
+  search->maxCount = opts.maxCount;
+  search->before = opts.before;
+  search->after = opts.after;
+  search->binary = opts.binary;
+  if (opts.debugPlan){
+    reportPlan(search);
+  }
+
+  ArenaStats stats = { 0 };
+  bool opened = true;
+  long matches;
+  if (count == 0){
+    // Standard input can't be split up, so it's read on this thread.
+    Input *in = openInput(NULL);
+    Scanner *sc = makeScanner(search);
+    if (search->binary == BINARY_TEXT || !looksBinary(in)){
+      matches = scanInput(sc, in, NULL, stdout);
+    } else if (search->binary == BINARY_SKIP){
+      matches = 0;
+    } else if (search->mode == PRINT_LINES){
+      matches = scanBinaryInput(sc, in, STDIN_NAME, stdout);
+    } else {
+      matches = scanInput(sc, in, NULL, stdout);
+    }
+    reportInput(search, stdout, STDIN_NAME, false, matches);
+    scannerStats(sc, &stats);
+    freeScanner(sc);
+    closeInput(in);
+  } else {
+    bool labels = count > 1;
+    for (int i = 0; i < count && !labels; i++){
+      labels = isDirectory(args[i]);
     }
+    startWalk(walker, args, count, opts.recursive);
+    opened = searchFiles(search, walker, opts.threads, labels, &stats,
+                         &matches);
+  }
+  freeWalker(walker);
+  freeSearch(search);
+  freeStringList(&patterns);
+  if (opts.stats){
+    reportStats(&stats);
   }
-  char *pstr = argv[PAT_ARG];
-  matchPatternWithFile(fp, pstr);
 
-  return EXIT_SUCCESS;
+  if (opts.mode == PRINT_NOTHING){
+    // Like grep -q, any match is a success, even if a file was missing.
+    return matches > 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+  return opened ? EXIT_SUCCESS : EXIT_FAILURE;
 }
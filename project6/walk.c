@@ -0,0 +1,488 @@
+/**
+  Implementation of the walk component.  Directories are opened with
+  openat() relative to their parent, and read in large batches with the
+  getdents64 system call, whose entries carry the file type, so the
+  files in a tree are found without a stat() for each one.  Each
+  directory is read whole and sorted, then walked depth first, keeping
+  one frame for each directory on the path down.  Only the directory
+  being walked and the one named as an input are kept open, so a deep
+  tree doesn't use up descriptors: going down closes the parent, and
+  it's opened again by its path if it's needed on the way back up.  The
+  input stays open since its path may have lost its slashes, as / does.  Frames keep their buffers when
+  they're popped, so walking a tree of many small directories doesn't
+  keep going back to the heap.
+
+  @file walk.c
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#define _GNU_SOURCE
+
+#include "walk.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+// Size of the buffer directory entries are read into.
+#define DENTS_SIZE (64 * 1024)
+
+// Initial capacity of the growable arrays.
+#define INIT_CAPACITY 16
+
+// Growth factor for the growable arrays.
+#define MULTIPLY_FACTOR 2
+
+/** Layout of the records getdents64 fills the buffer with. */
+typedef struct {
+  /** Inode number. */
+  uint64_t ino;
+  /** Offset of the next record in the directory. */
+  int64_t off;
+  /** Size of this record. */
+  unsigned short reclen;
+  /** File type, one of the DT_ constants. */
+  unsigned char type;
+  /** Name, null terminated. */
+  char name[];
+} Dirent64;
+
+/** An entry of a directory that's been read. */
+typedef struct {
+  /** Where the name starts in the frame's names, while they're read. */
+  size_t offset;
+  /** Name of the entry, once they're all read. */
+  char const *name;
+  /** File type, one of the DT_ constants. */
+  unsigned char type;
+} Entry;
+
+/** A directory being walked. */
+typedef struct {
+  /** Open descriptor for the directory, or -1 once it's closed. */
+  int fd;
+  /** Length of the directory's path at the start of the walker's path. */
+  size_t pathLen;
+  /** Names of the entries, one after another. */
+  char *names;
+  /** Size and capacity of names. */
+  size_t namesSize, namesCapacity;
+  /** Entries of the directory, in sorted order. */
+  Entry *entries;
+  /** Number of entries, the next one to look at, and the capacity. */
+  int count, next, capacity;
+} Frame;
+
+/** A glob given to the walker. */
+typedef struct {
+  /** What the glob does. */
+  GlobKind kind;
+  /** The pattern. */
+  char const *glob;
+} Glob;
+
+/** Representation for a walker. */
+struct WalkerStruct {
+  /** Input names, and the next one to hand out. */
+  char *const *names;
+  int count, nextName;
+  /** True to walk down into subdirectories. */
+  bool recursive;
+  /** Globs choosing the files. */
+  Glob *globs;
+  int globCount, globCapacity;
+  /** True if there's an INCLUDE_GLOB. */
+  bool including;
+  /** Directories on the path down, the last one is being walked. */
+  Frame *frames;
+  int depth, frameCapacity;
+  /** Path of the file or directory being looked at. */
+  char *path;
+  size_t pathCapacity;
+  /** Buffer getdents64 reads entries into. */
+  char *dents;
+  /** True if a directory couldn't be opened or read. */
+  bool failed;
+};
+
+/**
+  Make a walker with no inputs or globs yet.
+
+  @return A dynamically allocated walker.
+*/
+Walker *makeWalker()
+{
+  Walker *this = (Walker *) malloc(sizeof(Walker));
+  this->names = NULL;
+  this->count = this->nextName = 0;
+  this->recursive = false;
+  this->globCapacity = INIT_CAPACITY;
+  this->globs = (Glob *) malloc(this->globCapacity * sizeof(Glob));
+  this->globCount = 0;
+  this->including = false;
+  this->frameCapacity = INIT_CAPACITY;
+  this->frames = (Frame *) calloc(this->frameCapacity, sizeof(Frame));
+  this->depth = 0;
+  this->pathCapacity = INIT_CAPACITY;
+  this->path = (char *) malloc(this->pathCapacity);
+  this->dents = (char *) malloc(DENTS_SIZE);
+  this->failed = false;
+  return this;
+}
+
+/**
+  Add a glob pattern to choose the files that are searched.
+
+  @param walker walker to add to.
+  @param kind what the glob does.
+  @param glob the pattern, it must outlive the walker.
+*/
+void addGlob(Walker *walker, GlobKind kind, char const *glob)
+{
+  if (walker->globCount >= walker->globCapacity){
+    walker->globCapacity *= MULTIPLY_FACTOR;
+    walker->globs = (Glob *) realloc(walker->globs,
+                                     walker->globCapacity * sizeof(Glob));
+  }
+  walker->globs[walker->globCount].kind = kind;
+  walker->globs[walker->globCount++].glob = glob;
+  if (kind == INCLUDE_GLOB){
+    walker->including = true;
+  }
+}
+
+/**
+  Give the walker the input names to hand out files for.
+
+  @param walker walker to start.
+  @param names input names, they must outlive the walker.
+  @param count number of names.
+  @param recursive true to walk down into subdirectories.
+*/
+void startWalk(Walker *walker, char *const *names, int count, bool recursive)
+{
+  walker->names = names;
+  walker->count = count;
+  walker->nextName = 0;
+  walker->recursive = recursive;
+}
+
+/**
+  Check if a name matches any glob of the given kind.
+
+  @param walker walker with the globs.
+  @param kind kind of glob to check.
+  @param name base name to match.
+  @return true if one matches.
+*/
+static bool matchesGlob(Walker const *walker, GlobKind kind, char const *name)
+{
+  for (int i = 0; i < walker->globCount; i++){
+    if (walker->globs[i].kind == kind &&
+        fnmatch(walker->globs[i].glob, name, 0) == 0){
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+  Check if a file should be searched, given its base name.
+
+  @param walker walker with the globs.
+  @param name base name of the file.
+  @return true if it's searched.
+*/
+static bool wantedFile(Walker const *walker, char const *name)
+{
+  if (walker->including && !matchesGlob(walker, INCLUDE_GLOB, name)){
+    return false;
+  }
+  return !matchesGlob(walker, EXCLUDE_GLOB, name);
+}
+
+/**
+  Make sure the walker's path has room for the given length.
+
+  @param walker walker whose path is grown.
+  @param len length needed, not counting the null terminator.
+*/
+static void growPath(Walker *walker, size_t len)
+{
+  if (len + 1 > walker->pathCapacity){
+    while (len + 1 > walker->pathCapacity){
+      walker->pathCapacity *= MULTIPLY_FACTOR;
+    }
+    walker->path = (char *) realloc(walker->path, walker->pathCapacity);
+  }
+}
+
+/**
+  Report a directory that couldn't be opened or read, and remember it
+  so the walk counts as failed.
+
+  @param walker walker that was walking it.
+  @param path path of the directory.
+*/
+static void reportDirectory(Walker *walker, char const *path)
+{
+  // The path of / is left empty, so its entries don't get a doubled slash.
+  fprintf(stderr, "Can't open directory: %s\n", path[0] ? path : "/");
+  walker->failed = true;
+}
+
+// Comparison function for sorting entries by name.
+static int compareEntries(void const *a, void const *b)
+{
+  return strcmp(((Entry const *) a)->name, ((Entry const *) b)->name);
+}
+
+/**
+  Read every entry of a directory into a new frame on top of the stack,
+  sorted by name, and close the parent's descriptor unless the parent
+  is the input directory.  The walker's path
+  must hold the directory's path.
+
+  @param walker walker to push the frame on.
+  @param fd open descriptor for the directory, the frame takes it over.
+  @param pathLen length of the directory's path.
+*/
+static void pushDirectory(Walker *walker, int fd, size_t pathLen)
+{
+  if (walker->depth >= walker->frameCapacity){
+    walker->frameCapacity *= MULTIPLY_FACTOR;
+    walker->frames = (Frame *) realloc(walker->frames,
+                                       walker->frameCapacity * sizeof(Frame));
+    memset(walker->frames + walker->depth, 0,
+           (walker->frameCapacity - walker->depth) * sizeof(Frame));
+  }
+  Frame *frame = walker->frames + walker->depth++;
+  frame->fd = fd;
+  frame->pathLen = pathLen;
+  frame->namesSize = 0;
+  frame->count = frame->next = 0;
+
+  long n;
+  while ((n = syscall(SYS_getdents64, fd, walker->dents, DENTS_SIZE)) > 0){
+    for (long pos = 0; pos < n; ){
+      Dirent64 const *d = (Dirent64 const *) (walker->dents + pos);
+      pos += d->reclen;
+      if (strcmp(d->name, ".") == 0 || strcmp(d->name, "..") == 0){
+        continue;
+      }
+      size_t len = strlen(d->name) + 1;
+      if (frame->namesSize + len > frame->namesCapacity){
+        frame->namesCapacity = frame->namesCapacity ?
+          frame->namesCapacity * MULTIPLY_FACTOR : DENTS_SIZE;
+        while (frame->namesSize + len > frame->namesCapacity){
+          frame->namesCapacity *= MULTIPLY_FACTOR;
+        }
+        frame->names = (char *) realloc(frame->names, frame->namesCapacity);
+      }
+      if (frame->count >= frame->capacity){
+        frame->capacity = frame->capacity ?
+          frame->capacity * MULTIPLY_FACTOR : INIT_CAPACITY;
+        frame->entries = (Entry *) realloc(frame->entries,
+                                           frame->capacity * sizeof(Entry));
+      }
+      memcpy(frame->names + frame->namesSize, d->name, len);
+      frame->entries[frame->count].offset = frame->namesSize;
+      frame->entries[frame->count++].type = d->type;
+      frame->namesSize += len;
+    }
+  }
+  if (n < 0){
+    walker->path[pathLen] = '\0';
+    reportDirectory(walker, walker->path);
+  }
+  // Names can't be pointed to until names is done growing.
+  for (int i = 0; i < frame->count; i++){
+    frame->entries[i].name = frame->names + frame->entries[i].offset;
+  }
+  qsort(frame->entries, frame->count, sizeof(Entry), compareEntries);
+
+  if (walker->depth > 2 && walker->frames[walker->depth - 2].fd >= 0){
+    close(walker->frames[walker->depth - 2].fd);
+    walker->frames[walker->depth - 2].fd = -1;
+  }
+}
+
+/**
+  Close the directory on top of the stack, keeping its buffers for the
+  next one.
+
+  @param walker walker to pop the frame from.
+*/
+static void popDirectory(Walker *walker)
+{
+  Frame *frame = walker->frames + --walker->depth;
+  if (frame->fd >= 0){
+    close(frame->fd);
+  }
+}
+
+/**
+  Get a descriptor for the directory on top of the stack, opening it
+  again by its path if it was closed on the way down.  If it can't be
+  opened, it's reported and the rest of its entries are skipped.
+
+  @param walker walker to look with.
+  @return the descriptor, or -1 if it can't be opened.
+*/
+static int frameDirectory(Walker *walker)
+{
+  Frame *frame = walker->frames + walker->depth - 1;
+  if (frame->fd < 0){
+    walker->path[frame->pathLen] = '\0';
+    frame->fd = open(walker->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (frame->fd < 0){
+      reportDirectory(walker, walker->path);
+      frame->next = frame->count;
+    }
+  }
+  return frame->fd;
+}
+
+/**
+  Look at the next entry of the directory on top of the stack, walking
+  into it if it's a directory to walk.
+
+  @param walker walker to look with.
+  @return the length of the entry's path, in the walker's path, if it's
+          a file to hand out, or 0 if not.
+*/
+static size_t nextEntry(Walker *walker)
+{
+  Frame *frame = walker->frames + walker->depth - 1;
+  Entry const *entry = frame->entries + frame->next++;
+  int type = entry->type;
+  struct stat st;
+  if (type == DT_UNKNOWN){
+    // Some file systems don't give types, so these need a stat() after all.
+    if (frameDirectory(walker) < 0 ||
+        fstatat(frame->fd, entry->name, &st, AT_SYMLINK_NOFOLLOW) != 0){
+      return 0;
+    }
+    type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG :
+      S_ISLNK(st.st_mode) ? DT_LNK : DT_UNKNOWN;
+  }
+  if (type == DT_LNK){
+    // Like grep -r, links aren't followed when walking down.  Otherwise
+    // only links to regular files are, so there can't be cycles.
+    if (walker->recursive || frameDirectory(walker) < 0 ||
+        fstatat(frame->fd, entry->name, &st, 0) != 0 || !S_ISREG(st.st_mode)){
+      return 0;
+    }
+    type = DT_REG;
+  }
+  if (type == DT_DIR ? !walker->recursive ||
+                       matchesGlob(walker, EXCLUDE_DIR_GLOB, entry->name) :
+      type != DT_REG || !wantedFile(walker, entry->name)){
+    return 0;
+  }
+  if (type == DT_DIR && frameDirectory(walker) < 0){
+    return 0;
+  }
+
+  size_t len = frame->pathLen + 1 + strlen(entry->name);
+  growPath(walker, len);
+  walker->path[frame->pathLen] = '/';
+  strcpy(walker->path + frame->pathLen + 1, entry->name);
+  if (type == DT_REG){
+    return len;
+  }
+  int fd = openat(frame->fd, entry->name,
+                  O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  if (fd < 0){
+    reportDirectory(walker, walker->path);
+  } else {
+    pushDirectory(walker, fd, len);
+  }
+  return 0;
+}
+
+/**
+  Get the next file to search.
+
+  @param walker walker to get the file from.
+  @param listed set to true if the file was named as an input.
+  @return the name of the file, good until the next call, or NULL once
+          there are no more.
+*/
+char const *nextFile(Walker *walker, bool *listed)
+{
+  while (true){
+    if (walker->depth > 0){
+      Frame *frame = walker->frames + walker->depth - 1;
+      if (frame->next == frame->count){
+        popDirectory(walker);
+      } else if (nextEntry(walker) > 0){
+        *listed = false;
+        return walker->path;
+      }
+      continue;
+    }
+    if (walker->nextName == walker->count){
+      return NULL;
+    }
+
+    char const *name = walker->names[walker->nextName++];
+    struct stat st;
+    int fd;
+    if (stat(name, &st) != 0 || !S_ISDIR(st.st_mode) ||
+        (fd = open(name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0){
+      char const *base = strrchr(name, '/');
+      if (wantedFile(walker, base ? base + 1 : name)){
+        *listed = true;
+        return name;
+      }
+      continue;
+    }
+    // Paths under dir/ don't get a doubled slash.
+    size_t len = strlen(name);
+    while (len > 0 && name[len - 1] == '/'){
+      len--;
+    }
+    growPath(walker, len);
+    memcpy(walker->path, name, len);
+    pushDirectory(walker, fd, len);
+  }
+}
+
+/**
+  Check if any directory couldn't be opened or read while walking.
+
+  @param walker walker to check.
+  @return true if one was reported.
+*/
+bool walkFailed(Walker const *walker)
+{
+  return walker->failed;
+}
+
+/**
+  Free the memory for the given walker, closing any open directories.
+
+  @param walker walker to free.
+*/
+void freeWalker(Walker *walker)
+{
+  while (walker->depth > 0){
+    popDirectory(walker);
+  }
+  for (int i = 0; i < walker->frameCapacity; i++){
+    free(walker->frames[i].names);
+    free(walker->frames[i].entries);
+  }
+  free(walker->frames);
+  free(walker->globs);
+  free(walker->path);
+  free(walker->dents);
+  free(walker);
+}
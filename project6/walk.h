@@ -0,0 +1,91 @@
+/**
+  This is the header file for the walk component, which turns the input
+  names from the command line into the files to search, walking down
+  into directories and filtering the files it finds by glob patterns.
+  Files are handed out one at a time as they're found, so searching can
+  start long before a large tree has been walked.
+
+  @file walk.h
+  @author Vivekanand Ganapathy Nagarajan vganapa
+*/
+
+#ifndef WALK_H
+#define WALK_H
+
+#include <stdbool.h>
+
+/** Kinds of glob pattern used to choose the files that are searched. */
+typedef enum {
+  /** Only files whose base name matches one of these are searched. */
+  INCLUDE_GLOB,
+  /** Files whose base name matches are skipped. */
+  EXCLUDE_GLOB,
+  /** Directories whose base name matches aren't walked into. */
+  EXCLUDE_DIR_GLOB
+} GlobKind;
+
+/** A short name to use for a walker. */
+typedef struct WalkerStruct Walker;
+
+/**
+  Make a walker with no inputs or globs yet.
+
+  @return A dynamically allocated walker.
+*/
+Walker *makeWalker();
+
+/**
+  Add a glob pattern to choose the files that are searched.  Globs are
+  matched against base names with fnmatch().
+
+  @param walker walker to add to.
+  @param kind what the glob does.
+  @param glob the pattern, it must outlive the walker.
+*/
+void addGlob(Walker *walker, GlobKind kind, char const *glob);
+
+/**
+  Give the walker the input names to hand out files for.  A name that
+  isn't a directory is handed out as it is, even if it doesn't exist,
+  so it can be reported when it's opened.  A directory hands out the
+  regular files directly inside it, or every regular file under it if
+  recursive, in sorted order.  Symbolic links inside a directory are
+  skipped when walking recursively, like grep -r does, and otherwise
+  only followed if they're to regular files.
+
+  @param walker walker to start.
+  @param names input names, they must outlive the walker.
+  @param count number of names.
+  @param recursive true to walk down into subdirectories.
+*/
+void startWalk(Walker *walker, char *const *names, int count, bool recursive);
+
+/**
+  Get the next file to search.
+
+  @param walker walker to get the file from.
+  @param listed set to true if the file was named as an input, rather
+         than found in a directory.
+  @return the name of the file, good until the next call, or NULL once
+          there are no more.
+*/
+char const *nextFile(Walker *walker, bool *listed);
+
+/**
+  Check if any directory couldn't be opened or read while walking.  Such
+  directories are reported on standard error as they're found, and
+  whatever is under them is skipped.
+
+  @param walker walker to check.
+  @return true if one was reported.
+*/
+bool walkFailed(Walker const *walker);
+
+/**
+  Free the memory for the given walker, closing any open directories.
+
+  @param walker walker to free.
+*/
+void freeWalker(Walker *walker);
+
+#endif